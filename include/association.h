@@ -0,0 +1,83 @@
+#ifndef ASSOCIATION_H
+#define ASSOCIATION_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// Weight of the distance between the predicted and the detected face centers
+// (normalized by the face diagonal) relative to the lack of overlap (1 - IoU)
+// in the association cost.
+static const float ASSOCIATION_MOTION_WEIGHT = 0.5f;
+
+// A detection is never associated to a track if the cost is above that: with
+// no overlap at all, the centers must be less than half a diagonal apart.
+static const float ASSOCIATION_MAX_COST = 1.25f;
+
+/** Assigns the detected faces to the existing tracks.
+ *
+ * Candidate pairs are found with a uniform spatial grid (so that only tracks
+ * close to a detection are considered), scored with an overlap + motion cost,
+ * and the assignment minimizing the total cost is computed with the Hungarian
+ * algorithm, independently on each cluster of mutually overlapping candidates.
+ *
+ * All the buffers are kept from one call to the next.
+ */
+class Associator {
+
+public:
+
+    /** Returns, for each detection, the index of the track it belongs to, or
+     * -1 if it is a new face.
+     *
+     * 'tracks' are the (predicted) bounding boxes of the current tracks.
+     */
+    const std::vector<int>& associate(const std::vector<cv::Rect>& tracks,
+                                      const std::vector<cv::Rect>& detections);
+
+    /** Intersection over union of two rectangles.
+     */
+    static float iou(const cv::Rect& a, const cv::Rect& b);
+
+    static float cost(const cv::Rect& track, const cv::Rect& detection);
+
+private:
+
+    struct Candidate {
+        int track, detection;
+        float cost;
+        int cluster;
+    };
+
+    void findCandidates(const std::vector<cv::Rect>& tracks,
+                        const std::vector<cv::Rect>& detections);
+
+    int findRoot(int node);
+
+    /** Solves the assignment problem on 'matrix' (rows x cols, rows <= cols).
+     * Returns in 'colOfRow' the column assigned to each row.
+     */
+    void hungarian(int rows, int cols);
+
+    std::vector<int> assignment;
+
+    // spatial grid, in compressed form: the tracks of cell i are
+    // cellTracks[cellStart[i] .. cellStart[i+1])
+    std::vector<int> cellStart;
+    std::vector<int> cellTracks;
+    std::vector<int> lastSeen;
+
+    std::vector<Candidate> candidates;
+
+    // clusters of candidates (union-find over tracks and detections)
+    std::vector<int> parent;
+    std::vector<int> clusterOf;
+    std::vector<int> trackIds, detectionIds;
+
+    // Hungarian algorithm
+    std::vector<float> matrix;
+    std::vector<float> u, v, minv;
+    std::vector<int> p, way, colOfRow;
+    std::vector<char> used;
+};
+
+#endif // ASSOCIATION_H
@@ -0,0 +1,130 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <opencv2/highgui/highgui.hpp> // VideoCapture
+
+#include "facetracking.h"
+
+// A track of a chunk is stitched to a track of the previous chunk if their
+// faces overlap by at least that much...
+static const float STITCH_MIN_IOU = 0.5f;
+// ...on at least that share of the overlap frames where the new track is
+// reported
+static const float STITCH_MIN_AGREEMENT = 0.5f;
+
+struct BatchParameters {
+
+    // nb of frames each chunk outputs
+    unsigned int chunkFrames = 30 * FRAMES_BETWEEN_DETECTION;
+
+    // nb of frames each chunk (but the first) also tracks before its own
+    // ones, on which it agrees with the previous chunk. They let the new
+    // tracks get confirmed, and give the stitching frames to compare.
+    unsigned int overlapFrames = FRAMES_BETWEEN_DETECTION;
+
+    // nb of chunks tracked concurrently. 0: one per core.
+    unsigned int threads = 0;
+
+    TrackingParameters tracking;
+};
+
+/** What a chunk of the video was tracked into: the faces of each frame, with
+ * the ids and names of the FaceTracking instance of the chunk.
+ */
+struct ChunkResult {
+    // the first frame tracked: the first overlap frame
+    unsigned long first = 0;
+    // the frames the chunk outputs: [begin, end)
+    unsigned long begin = 0;
+    unsigned long end = 0;
+    // faces[i]: the faces of frame first + i
+    std::vector<std::vector<Face>> faces;
+};
+
+/** Offline tracking of a recorded video, split in chunks tracked concurrently.
+ *
+ * Each chunk is tracked by its own FaceTracking, from its own position in the
+ * file: the detector runs on the first frame of each chunk, as on the first
+ * frame of a live session. Consecutive chunks overlap: on the overlap frames,
+ * the faces of both chunks are associated (see Associator), and a track of the
+ * new chunk continues the track of the previous chunk it agrees with on most
+ * of these frames. The other tracks get new ids.
+ *
+ * The names are stitched the same way: the provisional names are derived from
+ * the (global) ids, and a track recognized as another human of its chunk
+ * gets the global name of that human. The recognizers of the chunks do not
+ * share what they learnt though: someone who leaves, and comes back a few
+ * chunks later, is a new human.
+ *
+ * The result has the structure of the online tracking: the faces of each
+ * frame, as returned by FaceTracking::track().
+ */
+class BatchTracking {
+
+public:
+    BatchTracking(const BatchParameters& params = BatchParameters());
+    virtual ~BatchTracking() {}
+
+    /** Tracks the faces of a whole video file: faces[i] are the faces of
+     * frame i, for all the frames read. Returns false if the video can not be
+     * read.
+     *
+     * The number of frames must be known from the container (see
+     * frameCount()), and the video seekable (see seek()). Otherwise, the
+     * video is tracked as one chunk. The number of frames is only used to
+     * split the video: the last chunk reads up to the end of the video.
+     */
+    bool track(const std::string& video, std::vector<std::vector<Face>>& faces);
+
+    /** Stitches the tracks of consecutive chunks into 'faces' (one entry per
+     * frame, up to the last frame read). Returns the nb of tracks that
+     * continue across a chunk boundary.
+     */
+    size_t stitch(const std::vector<ChunkResult>& chunks,
+                  std::vector<std::vector<Face>>& faces);
+
+protected:
+    /** The nb of frames of a video that was just opened, as reported by the
+     * container (0 if unknown). Many backends only estimate it from the
+     * duration and the frame rate.
+     */
+    virtual unsigned long frameCount(cv::VideoCapture& capture) const;
+
+    /** Moves a video that was just opened to the frame nb 'frame'. Returns
+     * the frame it actually landed on (the next one read()), which many
+     * codecs snap to the previous keyframe, or -1 if the position is unknown.
+     */
+    virtual long seek(cv::VideoCapture& capture, unsigned long frame) const;
+
+private:
+    /** Tracks the frames [chunk.first, chunk.end) of the video. Returns false
+     * if they could not all be read. If chunk.end is unbounded, reads up to
+     * the end of the video, and sets chunk.end accordingly.
+     *
+     * When the seek lands before chunk.first, the frames in between are
+     * decoded and skipped. When the position is unknown, the chunk is read
+     * from the start of the video.
+     */
+    bool trackChunk(const std::string& video, ChunkResult& chunk) const;
+
+    /** Maps the ids of the tracks of 'chunk' to global ids: the tracks matching
+     * a track of the previous chunk on the overlap frames take its id, the
+     * others get new ones.
+     */
+    void matchTracks(const ChunkResult& previous, const std::map<unsigned int, unsigned int>& previousIds,
+                     const ChunkResult& chunk, std::map<unsigned int, unsigned int>& ids);
+
+    BatchParameters params;
+
+    unsigned int nextId;
+
+    Associator associator;
+    // scratch buffers for the association
+    std::vector<cv::Rect> previousBoxes, boxes;
+};
+
+#endif // BATCH_H
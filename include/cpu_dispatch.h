@@ -0,0 +1,17 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <string>
+
+/** Code paths of the SIMD kernels (SimdCascade, the recognition kernels),
+ * from the slowest to the fastest.
+ */
+enum InstructionSet {SCALAR, SSE2, AVX2};
+
+std::string instructionSetName(InstructionSet set);
+
+/** The fastest code path supported by this CPU.
+ */
+InstructionSet bestInstructionSet();
+
+#endif // CPU_DISPATCH_H
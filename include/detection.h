@@ -2,57 +2,168 @@
 #define DETECTION_H
 
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp> //boundingRect
-#include <opencv2/objdetect/objdetect.hpp>
 
-// Amount of features to track on a face
-static const unsigned char NB_FEATURES = 10;
+#include "detector_backend.h"
+#include "face_tracker.h"
+
+// By default, the frames are downscaled to this width (in pixels) for the
+// face detection. The faces must be at least MIN_FACE_SIZE pixels large at the
+// scale they are detected.
+static const int DETECTION_WIDTH = 200;
+static const int MIN_FACE_SIZE = 30;
+
+/** Range of face sizes the detector looks for, as widths in pixels of the
+ * full resolution frame. 0 means no bound.
+ *
+ * The smallest face sets how much the frame is downscaled (see
+ * FaceDetector::scaledWidth()), the largest one where the detector stops
+ * going up the scales.
+ */
+struct ScaleWindow {
+    explicit ScaleWindow(int minFace = 0, int maxFace = 0) : minFace(minFace), maxFace(maxFace) {}
+
+    /** The faces from 'size / margin' to 'size * margin' pixels.
+     */
+    static ScaleWindow around(int size, float margin) {
+        return ScaleWindow(cvFloor(size / margin), cvCeil(size * margin));
+    }
+
+    /** The faces within both windows.
+     */
+    ScaleWindow operator&(const ScaleWindow& other) const {
+        return ScaleWindow(std::max(minFace, other.minFace),
+                           maxFace == 0 ? other.maxFace
+                                        : (other.maxFace == 0 ? maxFace : std::min(maxFace, other.maxFace)));
+    }
+
+    bool empty() const {return maxFace > 0 && maxFace < minFace;}
+
+    int minFace;
+    int maxFace;
+};
+
+/** A region of the frame to scan, and the face sizes to look for there.
+ */
+struct DetectionRegion {
+    DetectionRegion(const cv::Rect& area, const ScaleWindow& window) : area(area), window(window) {}
 
-// Below this threshold of features, we need to re-initialize the tracker
-static const unsigned char FEATURES_THRESHOLD = 5;
+    cv::Rect area;
+    ScaleWindow window;
+};
+
+// The eye tracks are considered degraded (and the eyes must be re-detected)
+// when the distance between the eyes changes by more than this ratio...
+static const float EYE_DISTANCE_TOLERANCE = 0.2f;
+// ...or when the optical flow matching error (mean absolute difference of
+// the pixels around the eye) goes above this.
+static const float EYE_MAX_TRACKING_ERROR = 25.f;
 
 class FaceDetector {
 
 public:
 
 
-    FaceDetector();
-
-    std::vector<std::tuple<cv::Rect, cv::Point, cv::Point>> detect(const cv::Mat& image, int scaledWidth = 200);
+    /** Creates a detector using the given backend (see DetectorBackend) and
+     * cascade engine.
+     */
+    FaceDetector(DetectorType type = HAAR, CascadeEngine engine = OPENCV_CASCADES);
+
+    /** Finds the faces (and their eyes) in the image, downscaled to
+     * 'scaledWidth' pixels.
+     */
+    std::vector<std::tuple<cv::Rect, cv::Point, cv::Point>> detect(const cv::Mat& image, int scaledWidth = DETECTION_WIDTH);
+
+    /** Finds the faces whose size is within 'window'. The image is only
+     * downscaled as much as the smallest face allows, and only the scales up
+     * to the largest face are scanned.
+     */
+    std::vector<std::tuple<cv::Rect, cv::Point, cv::Point>> detect(const cv::Mat& image,
+                                                                   const ScaleWindow& window);
+
+    /** Only scans the given regions of the image (see MotionGate), each for
+     * the faces within its own window. A region is downscaled as much as the
+     * whole image would be for that window, so the faces are scanned at the
+     * same scales. The contrast is not the same though: each region is
+     * histogram equalized on its own, and a face may be found in a region and
+     * not in the whole image (or the other way around).
+     */
+    std::vector<std::tuple<cv::Rect, cv::Point, cv::Point>> detect(const cv::Mat& image,
+                                                                   const std::vector<DetectionRegion>& regions);
+
+    /** Width the image is downscaled to, for the faces within 'window':
+     * the smallest face then spans MIN_FACE_SIZE pixels. DETECTION_WIDTH if
+     * the window has no lower bound.
+     */
+    static int scaledWidth(int imageWidth, const ScaleWindow& window);
+
+    /** Smallest face (in image pixels) the detector finds in an image of
+     * that width, with that window.
+     */
+    static cv::Size minFaceSize(int imageWidth, const ScaleWindow& window = ScaleWindow());
 
     bool detectBothEyes(const cv::Mat &face, 
                         cv::Point &leftEye, cv::Point &rightEye,
                         bool relaxed = false) const;
 
+    DetectorType type() const {return backend->type();}
+
 private:
-    cv::CascadeClassifier frontalface;
-    // why detectMultiScale is not const?? OpenCV bug?
-    mutable cv::CascadeClassifier eyes;
+    /** Finds the faces in a region of the image, downscaled by 'scale', up
+     * to 'maxFace' pixels (0: no bound). The faces overlapping the ones
+     * already in 'faces' are skipped.
+     */
+    void scan(const cv::Mat& image, cv::Rect region, float scale, int maxFace,
+              std::vector<std::tuple<cv::Rect, cv::Point, cv::Point>>& faces);
+
+    // why detectMultiScale is not const?? OpenCV bug? The backend is not
+    // const either.
+    std::unique_ptr<DetectorBackend> backend;
 
 };
 
-class FaceTracker {
+/** Tracks the centers of both eyes with optical flow, from an initial
+ * detection. Much cheaper than running the eye cascade on every frame.
+ */
+class EyeTracker {
 
 public:
-    FaceTracker(const cv::Mat& image, const std::vector<cv::Point2f>& features);
-    std::vector<cv::Point2f> track(const cv::Mat& image);
-    void resetFeatures(const cv::Mat& image, const cv::Rect& face);
+    EyeTracker() : tracking(false), seedDistance(0.f), eyesFrame(0) {}
 
-    static std::vector<cv::Point2f> features(const cv::Mat& image, const cv::Rect& face);
+    /** Starts tracking from the eye positions detected in the current frame
+     * of 'flow'.
+     */
+    void reset(const OpticalFlow& flow, const cv::Point2f& leftEye, const cv::Point2f& rightEye);
 
-    cv::Point2f centroid() const {return _centroid;}
-    cv::Rect boundingBox() const {return cv::boundingRect(prevFeatures);}
-private:
+    /** Stops tracking, until the next reset().
+     */
+    void clear() {tracking = false;}
 
-    std::vector<cv::Point2f> pruneFeatures(const std::vector<cv::Point2f>& features);
+    /** Moves the eyes to the current frame of 'flow'. Returns false (and
+     * stops tracking) if either eye is lost, or if the eye positions are not
+     * consistent anymore with the initial detection, or with the face
+     * bounding box.
+     */
+    bool track(const OpticalFlow& flow, const cv::Rect& face);
 
-    cv::Mat prevImg;
-    std::vector<cv::Point2f> prevFeatures;
-
-    cv::Point2f _centroid;
-    double _variance;
+    bool isTracking() const {return tracking;}
+    cv::Point2f leftEye() const {return eyes[0];}
+    cv::Point2f rightEye() const {return eyes[1];}
 
+private:
+    bool tracking;
+    float seedDistance;
+    // the frame the eyes are located in
+    unsigned long eyesFrame;
+
+    cv::Point2f eyes[2];
+    // results of the optical flow
+    cv::Point2f nextEyes[2];
+    unsigned char status[2];
+    float err[2];
 };
 
 #endif // DETECTION_H
@@ -0,0 +1,104 @@
+#ifndef DETECTOR_BACKEND_H
+#define DETECTOR_BACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/objdetect/objdetect.hpp>
+
+#include "simd_cascade.h"
+
+/** The available face detectors:
+ *  - HAAR: OpenCV's Haar cascade. The most accurate.
+ *  - LBP: OpenCV's LBP cascade. Works on integer features: several times
+ *    faster, at the price of a few more missed faces.
+ */
+enum DetectorType {HAAR, LBP};
+
+/** How the cascades are evaluated:
+ *  - OPENCV_CASCADES: OpenCV's CascadeClassifier.
+ *  - SIMD_CASCADES: our vectorized evaluator (see SimdCascade). OpenCV is
+ *    still used for the models it does not support.
+ */
+enum CascadeEngine {OPENCV_CASCADES, SIMD_CASCADES};
+
+/** Returns the detector type matching 'name' ("haar" or "lbp"). Returns false
+ * if the name is unknown.
+ */
+bool detectorFromName(const std::string& name, DetectorType& type);
+
+std::string detectorName(DetectorType type);
+
+/** Low-level face and eye detection, used by FaceDetector.
+ *
+ * Images are expected to be grayscale. Backends are not thread-safe: each
+ * thread must use its own instance.
+ */
+class DetectorBackend {
+
+public:
+    virtual ~DetectorBackend() {}
+
+    /** Creates a backend of the given type. Returns nullptr if its models
+     * could not be loaded.
+     */
+    static std::unique_ptr<DetectorBackend> create(DetectorType type,
+                                                   CascadeEngine engine = OPENCV_CASCADES);
+
+    virtual DetectorType type() const = 0;
+
+    /** Finds the faces of at least 'minSize' pixels in the (equalized) image,
+     * and at most 'maxSize' (if not empty).
+     */
+    virtual void detectFaces(const cv::Mat& image,
+                             std::vector<cv::Rect>& faces,
+                             cv::Size minSize,
+                             cv::Size maxSize = cv::Size()) = 0;
+
+    /** Finds the biggest eye in a region of a face.
+     */
+    virtual void detectEye(const cv::Mat& region,
+                           std::vector<cv::Rect>& eyes,
+                           cv::Size minSize) = 0;
+};
+
+/** Backend based on OpenCV's cascade classifiers.
+ *
+ * OpenCV does not provide a LBP eye cascade: both types use the Haar eye
+ * cascade, which only runs on small regions of the detected faces anyway.
+ */
+class CascadeBackend : public DetectorBackend {
+
+public:
+    CascadeBackend(DetectorType type,
+                   const std::string& faceModel,
+                   const std::string& eyeModel,
+                   CascadeEngine engine = OPENCV_CASCADES);
+
+    bool empty() const {
+        return (frontalface.empty() && simdFace.empty())
+               || (eyes.empty() && simdEyes.empty());
+    }
+
+    DetectorType type() const {return _type;}
+
+    void detectFaces(const cv::Mat& image,
+                     std::vector<cv::Rect>& faces,
+                     cv::Size minSize,
+                     cv::Size maxSize = cv::Size());
+
+    void detectEye(const cv::Mat& region,
+                   std::vector<cv::Rect>& eyes,
+                   cv::Size minSize);
+
+private:
+    DetectorType _type;
+    // only one of each pair is loaded
+    cv::CascadeClassifier frontalface;
+    cv::CascadeClassifier eyes;
+    SimdCascade simdFace;
+    SimdCascade simdEyes;
+};
+
+#endif // DETECTOR_BACKEND_H
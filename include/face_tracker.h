@@ -0,0 +1,297 @@
+#ifndef FACE_TRACKER_H
+#define FACE_TRACKER_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp> //boundingRect
+
+#include "optical_flow.h"
+#include "tracing.h"
+
+// Amount of features to track on a face
+static const unsigned char NB_FEATURES = 10;
+
+// Below this threshold of features, we need to re-initialize the tracker
+static const unsigned char FEATURES_THRESHOLD = 5;
+
+// Capacity of a FaceTracker whose number of features is only known at runtime
+static const size_t DYNAMIC_FEATURES = 0;
+
+// The scale of the face is estimated from the distances between the pairs of
+// features at least that far apart (in pixels)...
+static const float MIN_PAIR_DISTANCE = 4.f;
+// ...and can not change by more than that factor from one frame to the next
+static const float MAX_SCALE_CHANGE = 1.2f;
+
+/** The parts of the face tracker that do not depend on the number of
+ * features.
+ */
+class FaceTrackerBase {
+
+protected:
+    FaceTrackerBase() : featuresFrame(0) {}
+
+    /** Finds at most 'capacity' good features to track in the face, and
+     * stores them in 'features'. Returns how many were found.
+     */
+    static size_t detectFeatures(const cv::Mat& image, const cv::Rect& face,
+                                 cv::Point2f* features, size_t capacity);
+
+    // the frame (see OpticalFlow::frame) the features are located in
+    unsigned long featuresFrame;
+};
+
+/** Tracks the features of a face with optical flow.
+ *
+ * With a capacity N known at compile time, the features are stored inline,
+ * and the per-frame bookkeeping (centroid, compaction, pruning) loops over all
+ * N slots, masking out the unused ones: the loops are fully unrolled and
+ * vectorized, without branches. FaceTracker<DYNAMIC_FEATURES> takes its
+ * capacity at runtime instead, and stores the features on the heap.
+ */
+template<size_t N = NB_FEATURES>
+class FaceTracker : public FaceTrackerBase {
+
+public:
+    explicit FaceTracker(size_t capacity = N ? N : NB_FEATURES) :
+        storage(capacity),
+        count(0),
+        _variance(0.f),
+        _scale(1.f) {}
+
+    /** Tracks the features in the current frame of 'flow', and updates the
+     * scale of the face. Returns the nb of features still tracked.
+     */
+    size_t track(const OpticalFlow& flow);
+
+    /** Finds new features to track in the face, in the current frame of
+     * 'flow'.
+     */
+    void resetFeatures(const OpticalFlow& flow, const cv::Rect& face);
+
+    size_t size() const {return count;}
+    size_t capacity() const {return storage.capacity();}
+
+    const cv::Point2f* begin() const {return storage.points();}
+    const cv::Point2f* end() const {return storage.points() + count;}
+
+    cv::Point2f centroid() const {return _centroid;}
+
+    /** Size of the face, relative to its size when the features were reset:
+     * > 1 when the face comes closer.
+     */
+    float scale() const {return _scale;}
+    cv::Rect boundingBox() const {
+        if (count == 0) return cv::Rect();
+        return cv::boundingRect(cv::Mat((int) count, 1, CV_32FC2, (void*) begin()));
+    }
+
+    /** Bookkeeping kernels, on the first 'count' of 'points'. Public for the
+     * benchmarks.
+     */
+    static cv::Point2f mean(const cv::Point2f* points, size_t count);
+
+    /** Mean squared distance of the points to their centroid.
+     */
+    static float variance(const cv::Point2f* points, size_t count, cv::Point2f centroid);
+
+    /** Change of scale of the point cloud from 'previous' to 'next': the
+     * median of the ratios of the distances between the pairs of 'found'
+     * points, robust to a few badly tracked ones. 'ratios' is a scratch
+     * buffer for count * (count - 1) / 2 values. Returns 1 if there is no
+     * pair to compare.
+     */
+    static float scaleChange(const cv::Point2f* previous, const cv::Point2f* next,
+                             const unsigned char* found, size_t count, float* ratios);
+
+    /** Only keeps the 'found' points, and moves them to 'points'. Returns how
+     * many were kept.
+     */
+    static size_t compact(const cv::Point2f* next, const unsigned char* found,
+                          cv::Point2f* points, size_t count);
+
+    /** Only keeps the points whose squared distance to 'centroid' is below
+     * 'limit'. Returns how many were kept.
+     */
+    static size_t prune(cv::Point2f* points, size_t count,
+                        cv::Point2f centroid, float limit);
+
+private:
+
+    // Inline storage...
+    template<size_t Capacity, typename Dummy = void>
+    struct Storage {
+        explicit Storage(size_t) : _points(), _next(), _status(), _ratios() {}
+        size_t capacity() const {return Capacity;}
+        cv::Point2f* points() {return _points;}
+        const cv::Point2f* points() const {return _points;}
+        cv::Point2f* next() {return _next;}
+        unsigned char* status() {return _status;}
+        float* ratios() {return _ratios;}
+
+        cv::Point2f _points[Capacity];
+        cv::Point2f _next[Capacity];
+        unsigned char _status[Capacity];
+        // one per pair of features (see scaleChange())
+        float _ratios[Capacity * (Capacity - 1) / 2 + 1];
+    };
+
+    // ...or on the heap, for the runtime-sized variant
+    template<typename Dummy>
+    struct Storage<DYNAMIC_FEATURES, Dummy> {
+        explicit Storage(size_t capacity) :
+            _points(capacity), _next(capacity), _status(capacity),
+            _ratios(capacity * (capacity - 1) / 2 + 1) {}
+        size_t capacity() const {return _points.size();}
+        cv::Point2f* points() {return _points.data();}
+        const cv::Point2f* points() const {return _points.data();}
+        cv::Point2f* next() {return _next.data();}
+        unsigned char* status() {return _status.data();}
+        float* ratios() {return _ratios.data();}
+
+        std::vector<cv::Point2f> _points;
+        std::vector<cv::Point2f> _next;
+        std::vector<unsigned char> _status;
+        std::vector<float> _ratios;
+    };
+
+    // the kernels loop over all the slots when their number is known at
+    // compile time, over the used ones only otherwise
+    static size_t slots(size_t count) {return N ? N : count;}
+
+    Storage<N> storage;
+    size_t count;
+
+    cv::Point2f _centroid;
+    // variance of the features when the tracker was (re)set
+    float _variance;
+    // scale of the face since then
+    float _scale;
+};
+
+template<size_t N>
+cv::Point2f FaceTracker<N>::mean(const cv::Point2f* points, size_t count)
+{
+    float x = 0.f, y = 0.f;
+    for (size_t i = 0; i < slots(count); i++) {
+        bool used = i < count;
+        x += used ? points[i].x : 0.f;
+        y += used ? points[i].y : 0.f;
+    }
+    return cv::Point2f(x, y) * (1.f / count);
+}
+
+template<size_t N>
+float FaceTracker<N>::variance(const cv::Point2f* points, size_t count, cv::Point2f centroid)
+{
+    float sum = 0.f;
+    for (size_t i = 0; i < slots(count); i++) {
+        float dx = points[i].x - centroid.x;
+        float dy = points[i].y - centroid.y;
+        sum += i < count ? dx * dx + dy * dy : 0.f;
+    }
+    return sum / count;
+}
+
+template<size_t N>
+float FaceTracker<N>::scaleChange(const cv::Point2f* previous, const cv::Point2f* next,
+                                  const unsigned char* found, size_t count, float* ratios)
+{
+    size_t nbRatios = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (found[i] != 1) continue;
+        for (size_t j = i + 1; j < count; j++) {
+            if (found[j] != 1) continue;
+
+            cv::Point2f before = previous[i] - previous[j];
+            float distance = before.dot(before);
+            if (distance < MIN_PAIR_DISTANCE * MIN_PAIR_DISTANCE) continue;
+
+            cv::Point2f after = next[i] - next[j];
+            ratios[nbRatios++] = std::sqrt(after.dot(after) / distance);
+        }
+    }
+    if (nbRatios == 0) return 1.f;
+
+    std::nth_element(ratios, ratios + nbRatios / 2, ratios + nbRatios);
+    return std::min(std::max(ratios[nbRatios / 2], 1.f / MAX_SCALE_CHANGE), MAX_SCALE_CHANGE);
+}
+
+template<size_t N>
+size_t FaceTracker<N>::compact(const cv::Point2f* next, const unsigned char* found,
+                               cv::Point2f* points, size_t count)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < slots(count); i++) {
+        points[kept] = next[i];
+        kept += (i < count) & (found[i] == 1);
+    }
+    return kept;
+}
+
+template<size_t N>
+size_t FaceTracker<N>::prune(cv::Point2f* points, size_t count,
+                             cv::Point2f centroid, float limit)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < slots(count); i++) {
+        float dx = points[i].x - centroid.x;
+        float dy = points[i].y - centroid.y;
+        // kept <= i: overwrites points already visited only
+        points[kept] = points[i];
+        kept += (i < count) & (dx * dx + dy * dy < limit);
+    }
+    return kept;
+}
+
+template<size_t N>
+size_t FaceTracker<N>::track(const OpticalFlow& flow)
+{
+    TRACE_SPAN("FaceTracker::track");
+
+    // the features were found in this very frame: nothing to track
+    if (featuresFrame == flow.frame()) return count;
+
+    // the previous frame is not the one the features are located in
+    if (featuresFrame + 1 != flow.frame() || !flow.hasPrevious()) count = 0;
+
+    flow.track(storage.points(), storage.next(), storage.status(), nullptr, count);
+    featuresFrame = flow.frame();
+
+    // compared to the previous positions, before compact() overwrites them
+    _scale *= scaleChange(storage.points(), storage.next(), storage.status(), count,
+                          storage.ratios());
+
+    size_t found = compact(storage.next(), storage.status(), storage.points(), count);
+
+    // do not recompute the variance: a few lost features would bias it.
+    // Keep the value computed when the face tracker was reset, scaled with
+    // the face.
+    if (found > 0) _centroid = mean(storage.points(), found);
+
+    // only keep features 'close enough' to the centroid of the cloud
+    count = prune(storage.points(), found, _centroid, 3 * _variance * _scale * _scale);
+    return count;
+}
+
+template<size_t N>
+void FaceTracker<N>::resetFeatures(const OpticalFlow& flow, const cv::Rect& face)
+{
+    count = detectFeatures(flow.image(), face, storage.points(), capacity());
+    featuresFrame = flow.frame();
+    _scale = 1.f;
+
+    if (count == 0) {
+        // nothing to track: the next update will fail anyway
+        _centroid = cv::Point2f(face.x + face.width / 2.f, face.y + face.height / 2.f);
+        _variance = 0.f;
+        return;
+    }
+
+    _centroid = mean(storage.points(), count);
+    _variance = variance(storage.points(), count, _centroid);
+}
+
+#endif // FACE_TRACKER_H
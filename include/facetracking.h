@@ -3,25 +3,196 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
 #include <opencv2/core/core.hpp>
 
 #include "detection.h"
-#include "recognition.h"
+#include "association.h"
+#include "recognition_worker.h"
 #include "human.h"
+#include "motion_gate.h"
+#include "pool.h"
+#include "latest_publisher.h"
 
 static const unsigned int FRAMES_BETWEEN_DETECTION = 50;
 
+// a tracked face is only relocalized on the matching detection if their
+// overlap is below that (or if the tracking is about to fail)
+static const float RELOCALIZATION_IOU = 0.6f;
+
+// around a track, the detector only looks for faces from 1/1.5 to 1.5 times
+// the size of the tracked one
+static const float TRACK_SCALE_MARGIN = 1.5f;
+
+struct TrackingParameters {
+
+    // nb of frames a new face must be tracked before being reported
+    unsigned int confirmationFrames = 3;
+
+    // nb of frames a lost track is kept around, waiting to be re-acquired by
+    // the detector, before it expires
+    unsigned int expiryFrames = 5 * FRAMES_BETWEEN_DETECTION;
+
+    // nb of tracks allocated upfront. More are allocated if needed.
+    size_t trackPoolSize = 16;
+
+    // face detector backend: HAAR is more accurate, LBP much faster
+    DetectorType detector = HAAR;
+
+    // cascade evaluator: OpenCV's, or our (faster) vectorized one
+    CascadeEngine cascadeEngine = OPENCV_CASCADES;
+
+    // for static cameras: only run the face detector where the image changed
+    // since the previous detection, and around the tracks (see MotionGate)
+    bool motionGating = false;
+
+    // sizes (widths in pixels) of the faces worth detecting, known from the
+    // camera geometry: eg, no need to look for faces closer than 50cm, or
+    // too far away to be recognized. The detector scans fewer scales, and the
+    // frames are downscaled as much as the smallest face allows. No bound by
+    // default.
+    ScaleWindow faceSizes;
+
+    // max nb of local searches for the faces of failing tracks, per frame
+    // (see Human::needsRescue()). 0 disables them: lost tracks then wait for
+    // the next full detection.
+    unsigned int rescueBudget = 2;
+
+    // max nb of training samples submitted to the recognizer, per frame, all
+    // humans together. Only the crops that differ from the samples already
+    // collected are submitted (see SampleSelector).
+    unsigned int trainingBudget = 1;
+};
+
+/** The name of a new track, until the recognizer tells who this is.
+ */
+inline std::string provisionalName(unsigned int id) {return "human" + std::to_string(id);}
+
+/** The state of the tracker after a frame.
+ */
+struct TrackingSnapshot {
+    // nb of frames tracked so far
+    unsigned long frame;
+    // when the frame was given to FaceTracking::track()
+    std::chrono::steady_clock::time_point timestamp;
+    bool detectorRan;
+    // the live tracks, LOST ones included
+    std::vector<TrackSnapshot> tracks;
+};
+
 class FaceTracking {
 
 public:
-    FaceTracking();
-    std::vector<Face> track(const cv::Mat inputImage, cv::Mat debugImage = cv::Mat());
+    FaceTracking(const TrackingParameters& params = TrackingParameters());
+
+    /** Detects and tracks the faces in a new (grayscale) frame. The returned
+     * faces are valid until the next call.
+     *
+     * Once the frame size is known and the tracks are allocated, frames
+     * where no detector runs (see detectorRan()) do not allocate memory.
+     */
+    const std::vector<Face>& track(const cv::Mat inputImage);
+
+    /** Copies the state of the tracks after the last frame (their features,
+     * eyes, mode...), for instance for an OverlayRenderer. Reuses the buffers
+     * of 'snapshot': cheap, and does not allocate once they are large enough.
+     */
+    void snapshot(TrackingSnapshot& snapshot) const;
+
+    typedef LatestPublisher<TrackingSnapshot>::Handle SnapshotHandle;
+
+    /** The snapshot of the last frame, from any thread, without ever blocking
+     * (nor slowing down) the tracking thread: see LatestPublisher. The
+     * snapshot is immutable, and stays valid as long as the handle lives.
+     * Empty if no frame was tracked yet.
+     */
+    SnapshotHandle latestSnapshot() const {return publication.latest();}
+
+    /** Returns true if the last call to track() ran a detector: the face
+     * detector, or the eye detector on faces whose eye tracks were lost.
+     */
+    bool detectorRan() const {return _detectorRan;}
+
+    /** Nb of live (ie, not expired) tracks.
+     */
+    size_t activeTracks() const {return humans.size();}
+
+    /** Depth of the recognition queue, and how many requests were dropped so
+     * far.
+     */
+    RecognitionStats recognitionStats() const {return recognition.stats();}
+
+    /** The regions the motion gated detection scans, in 'regions': wherever
+     * 'gate' saw something change (any face within 'faceSizes' may be
+     * there), and around each of the 'tracks', whether it moved or not (for
+     * faces about as large as the tracked one). Consumes the changes of
+     * 'gate' (see MotionGate::regions()).
+     */
+    static void gatedRegions(MotionGate& gate, const std::vector<cv::Rect>& tracks,
+                             int imageWidth, const ScaleWindow& faceSizes,
+                             std::vector<DetectionRegion>& regions);
+
 private:
+    /** Apply to the tracks the identities found by the recognition worker
+     * since the previous frame.
+     */
+    void applyRecognitionResults();
+
+    /** Re-detect the eyes of a human whose eye tracks were lost. Much cheaper
+     * than a full detection: only the eye cascade runs, where the face is
+     * expected in this frame.
+     */
+    void detectEyes(Human& human, const cv::Mat& inputImage);
+
+    /** Look for the face of a failing track around its expected position,
+     * and relocalize the track there if found. Much cheaper than a full
+     * detection: only a small window is scanned, for faces of about the
+     * tracked size.
+     */
+    void rescue(Human& human, const cv::Mat& inputImage);
+
+    /** Submit this human's face to the recognition worker, either to find out
+     * who they are, or as a training sample (if it is a useful one, and the
+     * training budget of the frame is not spent yet).
+     */
+    void requestRecognition(Human& human, const cv::Mat& inputImage);
+
+    /** Return the expired tracks to the pool.
+     */
+    void evictExpiredTracks();
+
+    TrackingParameters params;
+
     int frameCount;
+    unsigned int nextId;
+    // training samples submitted during this frame
+    unsigned int trainingSamples;
+    bool _detectorRan;
+
+    // the image pyramids of the last two frames
+    OpticalFlow opticalFlow;
 
     FaceDetector facedetector;
-    Recognizer faceRecognizer;
-    std::vector<Human> humans;
+    MotionGate motionGate;
+    Associator associator;
+    // scratch buffers for the association
+    std::vector<cv::Rect> trackBoxes, detectedBoxes;
+    // scratch buffer of the motion gated detection
+    std::vector<DetectionRegion> detectionRegions;
+    RecognitionWorker recognition;
+    std::vector<RecognitionResult> recognitionResults;
+
+    Pool<Human> trackPool;
+    // live tracks only: expired ones are returned to the pool
+    std::vector<Human*> humans;
+
+    // the faces reported by the last call to track()
+    std::vector<Face> faces;
+
+    // when track() was called last
+    std::chrono::steady_clock::time_point frameTime;
+    // the snapshots of the last frames, for the other threads
+    LatestPublisher<TrackingSnapshot> publication;
 };
 
 #endif // FACETRACKING_H
@@ -0,0 +1,129 @@
+#ifndef GALLERY_H
+#define GALLERY_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_dispatch.h"
+
+/** Nearest-neighbour index over the projections of the known faces in the
+ * eigenfaces space.
+ *
+ * This is a vantage-point tree: exact nearest neighbour search under the
+ * Euclidean distance, in sub-linear time for the low intrinsic dimensionality
+ * of PCA projections.
+ *
+ * Points added after the last rebuild are kept in a buffer which is scanned
+ * linearly. refresh() merges it into the tree once it grows beyond ~sqrt(N).
+ *
+ * The points (and the queries) are quantized to int8, with one scale per
+ * vector (see quantize()): 1/8 of the memory of doubles, and the distances
+ * come down to an exact int8 dot product. The search is exact between the
+ * quantized vectors: distances are off by about 1% of the norm of the
+ * vectors.
+ */
+class GalleryIndex {
+
+public:
+    GalleryIndex(size_t dimension = 0);
+
+    /** Remove all the points, and set the dimension of the future ones.
+     */
+    void clear(size_t dimension);
+
+    /** Add one vector (of size dimension()) to the gallery.
+     */
+    void add(const float* vector, int label);
+
+    /** Re-organise the tree to include all the points added so far.
+     */
+    void rebuild();
+
+    /** Rebuild the tree only if enough points were added since the last
+     * rebuild. Rebuilding every ~sqrt(N) insertions amortizes to
+     * O(sqrt(N).log(N)) per insertion, while keeping the linear part of the
+     * search small.
+     */
+    void refresh();
+
+    /** Find the closest point to 'query'. Returns false if the gallery is
+     * empty.
+     *
+     * 'maxChecks' bounds the number of distance computations performed while
+     * walking the tree: 0 means exact search. Small values trade recall for
+     * speed.
+     *
+     * Does not allocate: the query is quantized into a buffer of the index.
+     */
+    bool nearest(const float* query, int& label, double& distance,
+                 size_t maxChecks = 0);
+
+    size_t size() const {return labels.size();}
+    size_t dimension() const {return dim;}
+
+    /** Selects the code path of the distances. If the CPU does not support
+     * it, the best one it supports is used instead. Defaults to the best one.
+     */
+    void setInstructionSet(InstructionSet set);
+
+private:
+
+    struct Node {
+        // leaf: points order[begin, end)
+        size_t begin, end;
+
+        // inner node: children hold the points closer (resp. further) than
+        // 'radius' from the vantage point
+        size_t vantage;
+        double radius;
+        int inside, outside;
+    };
+
+    struct Candidate {
+        int label;
+        double distance;
+    };
+
+    /** A quantized vector: scale . codes.
+     */
+    struct Vector {
+        const int8_t* codes;
+        float scale;
+        // squared norm of the codes
+        int32_t norm;
+    };
+
+    Vector point(size_t index) const {
+        return Vector{&codes[index * dim], scales[index], norms[index]};
+    }
+
+    double distance(const Vector& a, const Vector& b) const;
+
+    int build(size_t begin, size_t end);
+    void search(int node, const Vector& query,
+                Candidate& best, size_t& checks, size_t maxChecks) const;
+
+    size_t dim;
+    InstructionSet simd;
+
+    // row-major, one row per point
+    std::vector<int8_t> codes;
+    std::vector<float> scales;
+    std::vector<int32_t> norms;
+    std::vector<int> labels;
+
+    std::vector<Node> nodes;
+    // indices of points, arranged along the tree
+    std::vector<size_t> order;
+    // points [0, indexed) are in the tree, the others are scanned linearly
+    size_t indexed;
+
+    // scratch space used by build()
+    std::vector<std::pair<double, size_t>> distances;
+    // the quantized query of nearest()
+    std::vector<int8_t> queryCodes;
+    unsigned int seed;
+};
+
+#endif // GALLERY_H
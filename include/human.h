@@ -6,24 +6,71 @@
 #include <opencv2/core/core.hpp>
 
 #include "detection.h"
-#include "recognition.h"
+#include "sample_selector.h"
 
-enum Mode {LOST, TRACKING};
+/** Lifecycle of a track:
+ *  - TENTATIVE: freshly detected face, not yet reported until it has been
+ *    tracked for a few frames.
+ *  - TRACKING: the face is tracked.
+ *  - LOST: tracking failed. The track is kept around for a while, so that the
+ *    next detections can re-acquire it.
+ *  - EXPIRED: lost for too long (or never confirmed). The track is evicted,
+ *    and only the recognizer remembers this human.
+ */
+enum Mode {TENTATIVE, TRACKING, LOST, EXPIRED};
+
+/** Where we stand regarding who this human is:
+ *  - PROVISIONAL: freshly detected face, with a placeholder name. Not yet
+ *    submitted to the recognizer.
+ *  - IDENTIFYING: waiting for the recognizer to tell us if we know this face.
+ *  - CONFIRMED: the name is definitive (either recognized, or a new human).
+ */
+enum Identity {PROVISIONAL, IDENTIFYING, CONFIRMED};
+
+// When the eye tracks are lost, the eyes are re-detected every so many frames
+// until they are found again
+static const unsigned int EYE_DETECTION_INTERVAL = 5;
+
+// A degrading track (or one lost for less than RESCUE_FRAMES frames) looks
+// for its face around where it is expected, every RESCUE_INTERVAL frames,
+// instead of waiting for the next full detection...
+static const unsigned int RESCUE_INTERVAL = 3;
+static const unsigned int RESCUE_FRAMES = 30;
+// ...in a window enlarged by that ratio of the face size on each side
+static const float RESCUE_MARGIN = 0.5f;
 
 class Face;
+struct TrackSnapshot;
 
 class Human {
 
     friend class Face;
 
 public:
+    /** Creates an unused (EXPIRED) track. Call reset() to start tracking.
+     */
+    Human();
+
     /** Initialize a new human, based on the bounding box of its face in the
      * current frame.
+     *
+     * The name is provisional until the recognizer had a chance to check if
+     * this is someone we already know.
      */
-    Human(const std::string& name, 
-          const cv::Mat inputImage, 
-          const cv::Rect boundingbox,
-          Recognizer& faceRecognizer);
+    Human(unsigned int id,
+          const std::string& name, 
+          const OpticalFlow& flow,
+          const cv::Rect boundingbox);
+
+    /** (Re-)initialize this track for a newly detected human. The track starts
+     * TENTATIVE.
+     *
+     * Buffers are reused, so that recycled tracks do not allocate.
+     */
+    void reset(unsigned int id,
+               const std::string& name,
+               const OpticalFlow& flow,
+               const cv::Rect& boundingbox);
 
     /** Returns true if the given rectangle match my current bounding box.
      *
@@ -31,14 +78,32 @@ public:
      */
     bool isMyself(const cv::Rect face) const;
 
-    /** Returns the current analysis mode for this human: tracking, learning,...
+    /** Where the face is expected to be in the next frame, based on its
+     * recent motion. Used to associate the detections to the tracks.
+     */
+    cv::Rect predictedBoundingBox() const;
+
+    /** Returns true if enough features are still tracked for the bounding
+     * box to be trusted (ie, no need to relocalize the face).
+     */
+    bool trackingIsHealthy() const;
+
+    /** Returns the current lifecycle stage of this track.
      */
     Mode mode() const {return _mode;}
 
+    /** Move to another stage of the lifecycle.
+     */
+    void setMode(Mode mode);
+
+    /** Nb of frames since the track entered its current stage.
+     */
+    unsigned int framesInMode() const {return _framesInMode;}
+
     /** Set the face bounding box, and initialize accordingly the offset between the
      * centroid of the tracked features and the boundingbox.
      */
-    void relocalizeFace(const cv::Mat& image, const cv::Rect face);
+    void relocalizeFace(const OpticalFlow& flow, const cv::Rect face);
 
     /** Estimate the 3D pose of the human based on the location of the eyes in the
      * image.
@@ -46,21 +111,110 @@ public:
     void estimatePose(const cv::Size& image_size,
                       const cv::Point2f& leftEye, const cv::Point2f& rightEye);
 
+    /** The eyes were detected in the current frame: update the pose, and
+     * track the eyes from there on.
+     */
+    void eyesDetected(const OpticalFlow& flow,
+                      const cv::Point2f& leftEye, const cv::Point2f& rightEye);
+
+    /** If the eyes are located in the current frame (detected, or tracked
+     * since), and within the face, returns true and their positions relative
+     * to the bounding box in 'eyes' (left, then right).
+     */
+    bool eyesInFace(cv::Point2f eyes[2]) const;
+
+    /** Returns true if the eye tracks were lost, and it is time to run the
+     * eye detector again.
+     */
+    bool needsEyeDetection() const;
+
+    /** Returns true if the tracking is failing (or failed recently), and it is
+     * time to look for the face around its expected position (see
+     * searchWindow()).
+     */
+    bool needsRescue() const;
+
+    /** Where to look for the face when the tracking fails: around its last
+     * known and predicted positions.
+     */
+    cv::Rect searchWindow() const;
+
+    /** A local search for the face was just made (successful or not).
+     */
+    void rescueAttempted() {framesSinceRescue = 0;}
+
     /** Update this face.
      *
      * This may mean:
-     *  - track the face (ie, find the key points of the face in the current frame)
+     *  - track the face (ie, find the key points of the face in the current
+     *    frame), and scale the bounding box as the face comes closer or
+     *    moves away
+     *  - track the eyes, and update the pose accordingly
+     *  - switch to LOST if not enough features are tracked anymore (or
+     *    directly to EXPIRED if the track was still TENTATIVE)
+     *
+     * Does not allocate memory.
+     */
+    void update(const OpticalFlow& flow);
+
+    /** Copies what the overlay renderer draws of this track. Reuses the
+     * buffers of 'track'.
+     */
+    void snapshot(TrackSnapshot& track) const;
+
+    /** The recognizer has been asked who this human is.
+     */
+    void identificationRequested() {_identity = IDENTIFYING;}
+
+    /** The recognizer knows this face: take over the name, and do not collect
+     * training samples anymore.
+     */
+    void recognizedAs(const std::string& name);
+
+    /** The recognizer does not know this face: the provisional name becomes
+     * definitive, and we start collecting training samples.
+     */
+    void unrecognized() {_identity = CONFIRMED;}
+
+    /** Enough training samples were collected for this human.
+     */
+    void trainingDone() {recognizerTrained = true;}
+
+    /** Returns true if the recognizer still needs pictures of this human.
+     */
+    bool needsTrainingSamples() const {
+        return _identity == CONFIRMED && !recognizerTrained && _mode == TRACKING;
+    }
+
+    /** Returns true if the face, as seen in this frame (nb 'frame'), would
+     * make a useful training sample: different enough from the ones already
+     * submitted (see SampleSelector).
      */
-    void update(const cv::Mat inputImage);
+    bool isUsefulTrainingSample(const cv::Mat& inputImage, unsigned long frame) {
+        return trainingSamples.isUseful(inputImage(boundingbox), _pose, frame);
+    }
 
-    void showFace(cv::Mat& ouputImage);
+    /** The face of this frame was submitted as a training sample.
+     */
+    void trainingSampleSubmitted() {trainingSamples.submitted();}
 
+    /** The recognizer acquired (or could not use) the training sample
+     * submitted at frame nb 'frame'.
+     */
+    void trainingSampleLearned(unsigned long frame) {trainingSamples.learned(frame);}
+    void trainingSampleRejected(unsigned long frame) {trainingSamples.rejected(frame);}
+
+    unsigned int id() const {return _id;}
     std::string name() const {return _name;}
+    Identity identity() const {return _identity;}
+    cv::Rect boundingBox() const {return boundingbox;}
     cv::Matx44d pose() const {return _pose;}
 
 private:
 
+    unsigned int _id;
     std::string _name;
+    Identity _identity;
 
     // the estimate of the 6D transformation of the human head from the
     // camera perspective
@@ -68,29 +222,78 @@ private:
     cv::Rect boundingbox;
 
     Mode _mode;
+    unsigned int _framesInMode;
+
+    FaceTracker<> tracker;
+    //offset between the centroid of the tracked features and the actual face
+    //boundingbox, and size of the face, when the features were reset. Both
+    //follow the scale of the face (see FaceTracker::scale()).
+    cv::Point2f trackerOffset;
+    cv::Size2f faceSize;
+    // smoothed displacement of the face, in pixels per frame
+    cv::Point2f velocity;
+
+    EyeTracker eyeTracker;
+    unsigned int framesWithoutEyes;
+
+    unsigned int framesSinceRescue;
 
-    FaceTracker tracker;
-    //offset between the centroid of the tracked features and the actual face boundingbox.
-    cv::Point trackerOffset;
-    std::vector<cv::Point2f> features;
-    Recognizer& faceRecognizer;
     bool recognizerTrained;
+    SampleSelector trainingSamples;
     
 };
 
+/** The state of a track at a given frame: see FaceTracking::snapshot() and
+ * FaceTracking::latestSnapshot().
+ */
+struct TrackSnapshot {
+    unsigned int id;
+    std::string name;
+    Mode mode;
+    Identity identity;
+    cv::Rect boundingbox;
+    cv::Matx44d pose;
+
+    // the features tracked on the face, and their centroid
+    cv::Point2f centroid;
+    cv::Point2f features[NB_FEATURES];
+    size_t nbFeatures;
+
+    bool eyesTracked;
+    cv::Point2f leftEye, rightEye;
+};
+
 /** Public interface to the detected faces
  */
 class Face {
 
 public:
-    Face(const Human& human):human(human) {}
-    std::string name() const {return human._name;}
-    cv::Rect boundingbox() const {return human.boundingbox;}
-    //cv::Point center() const {return human.boundingbox.tl() + (human.boundingbox.tl() - human.boundingbox.br())/2;}
-    cv::Matx44d pose() const {return human._pose;}
+    Face(const Human& human) :
+        _id(human._id),
+        _name(human._name),
+        _boundingbox(human.boundingbox),
+        _pose(human._pose) {}
+    Face(unsigned int id, const std::string& name,
+         const cv::Rect& boundingbox, const cv::Matx44d& pose) :
+        _id(id),
+        _name(name),
+        _boundingbox(boundingbox),
+        _pose(pose) {}
+    /** Id of the track: stays the same as long as the face is tracked.
+     */
+    unsigned int id() const {return _id;}
+    const std::string& name() const {return _name;}
+    cv::Rect boundingbox() const {return _boundingbox;}
+    //cv::Point center() const {return _boundingbox.tl() + (_boundingbox.tl() - _boundingbox.br())/2;}
+    cv::Matx44d pose() const {return _pose;}
 
 private:
-    const Human human;
+    // only what is public: copying the whole Human (trackers included) for
+    // each face, each frame, would be expensive
+    unsigned int _id;
+    std::string _name;
+    cv::Rect _boundingbox;
+    cv::Matx44d _pose;
 };
 
 #endif // HUMAN_H
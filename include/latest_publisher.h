@@ -0,0 +1,139 @@
+#ifndef LATEST_PUBLISHER_H
+#define LATEST_PUBLISHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+/** Publishes the successive versions of a value, from a single writer thread
+ * to any number of reader threads.
+ *
+ * Readers get the latest version wait-free (a single atomic increment), and
+ * keep it as long as they hold the Handle: a published version is never
+ * modified. The writer never waits for the readers either: it fills a free
+ * slot, and publishes it with an atomic exchange. If the readers hold all the
+ * other slots, the writer skips that version (see dropped()).
+ *
+ * The reference counts are split: 'current' packs the index of the current
+ * slot with the nb of readers that acquired it, and each slot counts the
+ * readers that released it. When the writer publishes another slot, it moves
+ * the count of acquisitions to the retired slot, which is free again once all
+ * its readers released it. Readers never touch a slot that is not current, so
+ * the writer can recycle the slots (and their buffers) without a lock.
+ */
+template<typename T, size_t N = 8>
+class LatestPublisher {
+
+    static_assert(N >= 2 && N < 255, "LatestPublisher needs 2 to 254 slots");
+
+    struct Slot {
+        Slot() : refs(0) {}
+        T value;
+        // releases are counted down, acquisitions added when the slot retires
+        std::atomic<int64_t> refs;
+    };
+
+public:
+
+    /** A published version, valid as long as the handle (or a copy) lives.
+     */
+    class Handle {
+
+    public:
+        Handle() : slot(nullptr) {}
+        Handle(const Handle& other) : slot(other.slot) {
+            if (slot) slot->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        Handle(Handle&& other) : slot(other.slot) {other.slot = nullptr;}
+        Handle& operator=(Handle other) {std::swap(slot, other.slot); return *this;}
+        ~Handle() {
+            if (slot) slot->refs.fetch_sub(1, std::memory_order_release);
+        }
+
+        /** False if nothing was published yet.
+         */
+        explicit operator bool() const {return slot != nullptr;}
+
+        const T& operator*() const {return slot->value;}
+        const T* operator->() const {return &slot->value;}
+
+    private:
+        friend class LatestPublisher;
+        explicit Handle(Slot* slot) : slot(slot) {}
+
+        Slot* slot;
+    };
+
+    LatestPublisher() : current(NONE << INDEX_SHIFT), writing(NONE), _dropped(0) {}
+
+    /** Calls f on the value of each slot, eg to reserve its buffers. Only
+     * before the first publication.
+     */
+    template<typename F>
+    void prepare(F f) {
+        for (auto& slot : slots) f(slot.value);
+    }
+
+    /** Writer: returns the value to fill for the next version, or nullptr if
+     * the readers hold all the slots. The value is the one of an older
+     * version: its buffers can be reused.
+     */
+    T* beginWrite() {
+        size_t currentIndex = current.load(std::memory_order_relaxed) >> INDEX_SHIFT;
+        for (size_t i = 0; i < N; i++) {
+            if (i != currentIndex && slots[i].refs.load(std::memory_order_acquire) == 0) {
+                writing = i;
+                return &slots[i].value;
+            }
+        }
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    /** Writer: publishes the value returned by the last beginWrite().
+     */
+    void publish() {
+        if (writing == NONE) return;
+
+        uint64_t old = current.exchange(writing << INDEX_SHIFT, std::memory_order_acq_rel);
+        size_t oldIndex = old >> INDEX_SHIFT;
+        if (oldIndex != NONE) {
+            slots[oldIndex].refs.fetch_add(old & COUNT_MASK, std::memory_order_acq_rel);
+        }
+        writing = NONE;
+    }
+
+    /** Reader: the latest version. Wait-free, from any thread.
+     */
+    Handle latest() const {
+        uint64_t word = current.fetch_add(1, std::memory_order_acquire);
+        size_t index = word >> INDEX_SHIFT;
+        // nothing published yet: the acquisition is simply dropped with the
+        // word, at the first publication
+        if (index == NONE) return Handle();
+        return Handle(&slots[index]);
+    }
+
+    /** Nb of versions the writer skipped, because no slot was free.
+     */
+    size_t dropped() const {return _dropped.load(std::memory_order_relaxed);}
+
+private:
+    LatestPublisher(const LatestPublisher&) = delete;
+    LatestPublisher& operator=(const LatestPublisher&) = delete;
+
+    static const int INDEX_SHIFT = 56;
+    static const uint64_t COUNT_MASK = (uint64_t(1) << INDEX_SHIFT) - 1;
+    static const uint64_t NONE = 255;
+
+    // mutable: the readers update the reference counts
+    mutable Slot slots[N];
+    // index of the current slot << INDEX_SHIFT | nb of acquisitions
+    mutable std::atomic<uint64_t> current;
+    // only used by the writer
+    uint64_t writing;
+    std::atomic<size_t> _dropped;
+};
+
+#endif // LATEST_PUBLISHER_H
@@ -0,0 +1,156 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <streambuf>
+
+/** Logging of the library.
+ *
+ * FT_LOG_DEBUG(...) to FT_LOG_ERROR(...) take a stream expression, like
+ * log4cxx macros (they are prefixed, since <syslog.h> already defines
+ * LOG_DEBUG and LOG_INFO):
+ *
+ *     FT_LOG_INFO("I think this is " << name);
+ *
+ * The message is formatted in place, on the stack, and pushed to a lock-free
+ * ring buffer: the calling thread never blocks, nor allocates. A background
+ * thread forwards the messages to the 'facetracking' log4cxx logger. When the
+ * ring is full, messages are dropped (and counted).
+ *
+ * Each call site is rate limited: past LOG_BURST messages in a second, the
+ * following ones are dropped until the next second, and the next message
+ * says how many were suppressed.
+ *
+ * Messages below FACETRACKING_LOG_LEVEL are compiled out entirely: their
+ * arguments are not even evaluated.
+ */
+
+#define FT_LOG_LEVEL_DEBUG 0
+#define FT_LOG_LEVEL_INFO 1
+#define FT_LOG_LEVEL_WARN 2
+#define FT_LOG_LEVEL_ERROR 3
+#define FT_LOG_LEVEL_OFF 4
+
+#ifndef FACETRACKING_LOG_LEVEL
+#ifdef DEBUG
+#define FACETRACKING_LOG_LEVEL FT_LOG_LEVEL_DEBUG
+#else
+#define FACETRACKING_LOG_LEVEL FT_LOG_LEVEL_INFO
+#endif
+#endif
+
+// max length of a message. Longer ones are truncated.
+static const size_t LOG_MESSAGE_SIZE = 256;
+
+// nb of messages the ring buffer holds (a power of 2)
+static const size_t LOG_RING_SIZE = 1024;
+
+// max nb of messages per call site and per second
+static const unsigned int LOG_BURST = 5;
+
+enum LogLevel {
+    LOG_DEBUG_LEVEL = FT_LOG_LEVEL_DEBUG,
+    LOG_INFO_LEVEL = FT_LOG_LEVEL_INFO,
+    LOG_WARN_LEVEL = FT_LOG_LEVEL_WARN,
+    LOG_ERROR_LEVEL = FT_LOG_LEVEL_ERROR
+};
+
+/** Rate limit of a call site. Lock-free: concurrent callers may let a message
+ * or two more through, which does not matter.
+ */
+class LogRateLimit {
+
+public:
+    LogRateLimit() : window(0), count(0), _suppressed(0) {}
+
+    /** Returns true if a message may be logged now.
+     */
+    bool allow() {
+        long long now = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (window.load(std::memory_order_relaxed) != now) {
+            window.store(now, std::memory_order_relaxed);
+            count.store(0, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1, std::memory_order_relaxed) < LOG_BURST) return true;
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /** Returns how many messages were dropped since the last call.
+     */
+    unsigned int suppressed() {return _suppressed.exchange(0, std::memory_order_relaxed);}
+
+private:
+    std::atomic<long long> window;
+    std::atomic<unsigned int> count;
+    std::atomic<unsigned int> _suppressed;
+};
+
+/** A message being formatted, in a fixed-size buffer. Submitted to the ring
+ * buffer when destroyed.
+ */
+class LogMessage : private std::streambuf {
+
+public:
+    LogMessage(LogLevel level, const char* file, int line, unsigned int suppressed);
+    ~LogMessage();
+
+    std::ostream& stream() {return _stream;}
+
+private:
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    LogLevel level;
+    const char* file;
+    int line;
+    unsigned int suppressed;
+    char text[LOG_MESSAGE_SIZE];
+    std::ostream _stream;
+};
+
+/** Waits until the background thread forwarded all the pending messages to
+ * log4cxx.
+ */
+void flushLogs();
+
+/** Nb of messages dropped so far because the ring buffer was full.
+ */
+size_t droppedLogs();
+
+#define FACETRACKING_LOG(level, message) \
+    do { \
+        static LogRateLimit _logRateLimit; \
+        if (_logRateLimit.allow()) { \
+            LogMessage(level, __FILE__, __LINE__, _logRateLimit.suppressed()).stream() << message; \
+        } \
+    } while (0)
+
+#if FACETRACKING_LOG_LEVEL <= FT_LOG_LEVEL_DEBUG
+#define FT_LOG_DEBUG(message) FACETRACKING_LOG(LOG_DEBUG_LEVEL, message)
+#else
+#define FT_LOG_DEBUG(message) do {} while (0)
+#endif
+
+#if FACETRACKING_LOG_LEVEL <= FT_LOG_LEVEL_INFO
+#define FT_LOG_INFO(message) FACETRACKING_LOG(LOG_INFO_LEVEL, message)
+#else
+#define FT_LOG_INFO(message) do {} while (0)
+#endif
+
+#if FACETRACKING_LOG_LEVEL <= FT_LOG_LEVEL_WARN
+#define FT_LOG_WARN(message) FACETRACKING_LOG(LOG_WARN_LEVEL, message)
+#else
+#define FT_LOG_WARN(message) do {} while (0)
+#endif
+
+#if FACETRACKING_LOG_LEVEL <= FT_LOG_LEVEL_ERROR
+#define FT_LOG_ERROR(message) FACETRACKING_LOG(LOG_ERROR_LEVEL, message)
+#else
+#define FT_LOG_ERROR(message) do {} while (0)
+#endif
+
+#endif // LOGGING_H
@@ -0,0 +1,67 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// The frames are compared at this width (in pixels)...
+static const int MOTION_WIDTH = 80;
+// ...by blocks of that many pixels (of the downscaled frame)
+static const int MOTION_BLOCK = 8;
+// a block changed if the mean absolute difference between the frame and the
+// background is above this (in gray levels)
+static const float MOTION_THRESHOLD = 12.f;
+// how fast the background absorbs the changes (per frame)
+static const double MOTION_LEARNING_RATE = 0.05;
+
+/** Finds where a static camera sees something change, so that the face
+ * detector only scans these regions.
+ *
+ * A running average of the frames at low resolution serves as background.
+ * Each frame, the blocks that differ from the background are accumulated in a
+ * mask, until the next detection consumes it (see regions()).
+ *
+ * The first frame is considered changed everywhere: faces that were already
+ * there are found by the first detection.
+ *
+ * Once the frame size is known, update() does not allocate.
+ */
+class MotionGate {
+
+public:
+    MotionGate() : initialized(false) {}
+
+    /** Compares a new (grayscale) frame to the background, marks the blocks
+     * that changed, and updates the background.
+     */
+    void update(const cv::Mat& frame);
+
+    /** Returns the regions (in frame coordinates) where the image changed
+     * since the last call: the changed blocks, merged into disjoint
+     * rectangles at least 'minSize' large. Then clears the changed blocks.
+     *
+     * The areas around the tracks are left to the caller, which knows the
+     * size of the faces there (see FaceTracking).
+     */
+    const std::vector<cv::Rect>& regions(cv::Size minSize);
+
+    /** Nb of blocks that changed since the last call to regions().
+     */
+    int changedBlocks() const {return cv::countNonZero(changed);}
+
+private:
+    bool initialized;
+    cv::Size frameSize;
+    float scale; // frame pixels per downscaled pixel
+
+    cv::Mat small, background, difference;
+    // one byte per block: non-zero if the block changed
+    cv::Mat changed;
+
+    // scratch buffers of regions()
+    cv::Mat active, labels;
+    std::vector<cv::Point> stack;
+    std::vector<cv::Rect> _regions;
+};
+
+#endif // MOTION_GATE_H
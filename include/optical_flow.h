@@ -0,0 +1,98 @@
+#ifndef OPTICAL_FLOW_H
+#define OPTICAL_FLOW_H
+
+#include <opencv2/core/core.hpp>
+
+// Settings of the pyramidal Lucas-Kanade optical flow, shared by all the
+// trackers: 10x10 windows, 3 pyramid levels, 20 iterations or a 0.01 pixel
+// step at most.
+static const int LK_WINDOW = 10;
+static const int LK_LEVELS = 3;
+static const int LK_MAX_ITERATIONS = 20;
+static const float LK_EPSILON = 0.01f;
+
+/** Image pyramid of a frame, with its Scharr derivatives, ready for the
+ * optical flow: same layout as cv::buildOpticalFlowPyramid (each level has a
+ * LK_WINDOW pixels border).
+ *
+ * The buffers are kept from one build to the next: once the frame size is
+ * known, building a pyramid does not allocate.
+ */
+class ImagePyramid {
+
+public:
+    ImagePyramid() : _levels(0) {}
+
+    /** Builds the pyramid of a grayscale (CV_8U) image.
+     */
+    void build(const cv::Mat& image);
+
+    /** Nb of levels actually built: less than LK_LEVELS + 1 for small images.
+     */
+    int levels() const {return _levels;}
+
+    cv::Size size() const {return _levels ? images[0].size() : cv::Size();}
+
+    /** The image at a given level (a ROI of the bordered buffer).
+     */
+    const cv::Mat& image(int level) const {return images[level];}
+
+    /** The (x, y) Scharr derivatives (CV_16SC2) at a given level.
+     */
+    const cv::Mat& derivatives(int level) const {return derivs[level];}
+
+private:
+    int _levels;
+    cv::Mat imageBuffers[LK_LEVELS + 1], images[LK_LEVELS + 1];
+    cv::Mat derivBuffers[LK_LEVELS + 1], derivs[LK_LEVELS + 1];
+    // scratch rows of the pyramid and derivatives kernels
+    cv::Mat rowBuffer;
+};
+
+/** Pyramidal Lucas-Kanade optical flow between the last two frames.
+ *
+ * The pyramid of each frame is built once, and shared by all the trackers
+ * (faces and eyes), instead of each call to cv::calcOpticalFlowPyrLK building
+ * both pyramids again (and allocating them). The tracking itself is the same
+ * as OpenCV's: same fixed-point interpolation, same stop criteria.
+ */
+class OpticalFlow {
+
+public:
+    OpticalFlow() : current(0), _frame(0) {}
+
+    /** Builds the pyramid of a new (grayscale) frame. The pyramid of the
+     * former one is kept, to track from it.
+     */
+    void push(const cv::Mat& frame);
+
+    /** Nb of frames pushed so far: identifies the current frame.
+     */
+    unsigned long frame() const {return _frame;}
+
+    /** The current frame.
+     */
+    const cv::Mat& image() const {return pyramids[current].image(0);}
+
+    /** Returns true if points can be tracked from the previous frame (there
+     * is one, of the same size).
+     */
+    bool hasPrevious() const {
+        return _frame > 1 && pyramids[0].size() == pyramids[1].size();
+    }
+
+    /** Tracks 'count' points from the previous frame to the current one.
+     * status[i] is 1 if the point was found. If 'err' is not null, err[i] is
+     * the mean absolute difference between the pixels around the point in
+     * both frames (like cv::calcOpticalFlowPyrLK's error).
+     */
+    void track(const cv::Point2f* prevPts, cv::Point2f* nextPts,
+               unsigned char* status, float* err, size_t count) const;
+
+private:
+    ImagePyramid pyramids[2];
+    int current;
+    unsigned long _frame;
+};
+
+#endif // OPTICAL_FLOW_H
@@ -0,0 +1,78 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <opencv2/core/core.hpp>
+
+#include "facetracking.h"
+
+/** Draws the tracks (features, eyes, names, bounding boxes) of a snapshot
+ * onto an image.
+ */
+void drawSnapshot(const TrackingSnapshot& snapshot, cv::Mat& image);
+
+/** Displays the tracking results in a window, from its own thread.
+ *
+ * The tracking thread publishes each frame along with the snapshot of the
+ * tracker. The renderer only ever draws the most recent one, at its own
+ * pace: frames published in the meantime are skipped. Publishing never
+ * blocks: the frames go through a triple buffer (the slot being written by
+ * the tracking thread, the one being drawn by the renderer, and the latest
+ * complete one in between, exchanged atomically).
+ *
+ * All the HighGUI calls (window, imshow, waitKey) are made from the renderer
+ * thread.
+ */
+class OverlayRenderer {
+
+public:
+    OverlayRenderer(const std::string& window = "faces", double maxFps = 30.);
+    ~OverlayRenderer();
+
+    /** Hands a frame and the current state of 'tracking' over to the
+     * renderer. Copies them into a recycled buffer: does not allocate once
+     * the frame size is known.
+     */
+    void publish(const cv::Mat& frame, const FaceTracking& tracking);
+
+    /** Same, with a snapshot taken earlier (eg by another stage of a
+     * Pipeline).
+     */
+    void publish(const cv::Mat& frame, const TrackingSnapshot& snapshot);
+
+    /** The last key pressed in the window, or -1.
+     */
+    int lastKey() const {return _lastKey.load();}
+
+private:
+    OverlayRenderer(const OverlayRenderer&) = delete;
+    OverlayRenderer& operator=(const OverlayRenderer&) = delete;
+
+    void run();
+
+    struct Slot {
+        cv::Mat frame;
+        TrackingSnapshot snapshot;
+    };
+
+    // set on the index of the middle slot when it holds a frame the
+    // renderer has not seen yet
+    static const int FRESH = 4;
+
+    Slot slots[3];
+    // only used by the tracking thread
+    int back;
+    // only used by the renderer
+    int front;
+    std::atomic<int> middle;
+
+    std::string window;
+    int period; // ms
+    std::atomic<bool> running;
+    std::atomic<int> _lastKey;
+    std::thread worker;
+};
+
+#endif // OVERLAY_H
@@ -0,0 +1,349 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <utility> // swap
+
+/** What a queue between two stages does when the producer is faster than the
+ * consumer:
+ *  - BLOCK: the producer waits for room. Nothing is lost, but the upstream
+ *    stages (the capture included) slow down to the pace of the consumer.
+ *  - DROP_OLDEST: the oldest queued item is dropped to make room.
+ *  - KEEP_LATEST: the consumer only ever takes the most recent item: the
+ *    older ones are dropped. Lowest latency, eg for live video.
+ */
+enum QueuePolicy {BLOCK, DROP_OLDEST, KEEP_LATEST};
+
+/** Parses 'block', 'drop-oldest' or 'keep-latest'. Returns false if the name
+ * is unknown.
+ */
+bool queuePolicyFromName(const std::string& name, QueuePolicy& policy);
+
+/** Pins a thread to a CPU core. Returns false if it could not be done (or is
+ * not supported on this platform).
+ */
+bool pinThread(std::thread& thread, int cpu);
+
+struct QueueStats {
+    size_t depth;     // items currently waiting
+    size_t capacity;
+    size_t pushed;
+    size_t dropped;   // items lost, because of the queue policy
+};
+
+/** A bounded queue between two threads (one producer, one consumer).
+ *
+ * The items are preallocated: push() and pop() swap the caller's item with
+ * one of the queue, so that the buffers of the items go round instead of
+ * being copied. In steady state, they do not allocate (provided swapping two
+ * T does not).
+ */
+template<typename T>
+class BoundedQueue {
+
+public:
+    BoundedQueue(size_t capacity = 2, QueuePolicy policy = BLOCK) :
+        slots(std::max(capacity, (size_t) 1)),
+        policy(policy),
+        head(0),
+        size(0),
+        closed(false),
+        pushed(0),
+        dropped(0)
+    {}
+
+    /** Queues 'item', which gets in exchange the buffers of an older item.
+     * Returns false if the queue was closed.
+     */
+    bool push(T& item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (closed) return false;
+            pushed++;
+
+            if (size == slots.size()) {
+                if (policy == BLOCK) {
+                    notFull.wait(lock, [this]() {return closed || size < slots.size();});
+                    if (closed) return false;
+                }
+                else {
+                    // the oldest slot is recycled for this item
+                    head = (head + 1) % slots.size();
+                    size--;
+                    dropped++;
+                }
+            }
+
+            std::swap(item, slots[(head + size) % slots.size()]);
+            size++;
+        }
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /** Waits for an item, and swaps it with 'item'. Returns false once the
+     * queue is closed and empty.
+     */
+    bool pop(T& item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]() {return closed || size > 0;});
+            if (size == 0) return false;
+
+            if (policy == KEEP_LATEST && size > 1) {
+                dropped += size - 1;
+                head = (head + size - 1) % slots.size();
+                size = 1;
+            }
+
+            std::swap(item, slots[head]);
+            head = (head + 1) % slots.size();
+            size--;
+        }
+        notFull.notify_one();
+        return true;
+    }
+
+    /** No more items will be pushed: the consumer gets the remaining ones,
+     * then pop() returns false. A blocked producer is released.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    QueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return QueueStats{size, slots.size(), pushed, dropped};
+    }
+
+private:
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    std::vector<T> slots;
+    QueuePolicy policy;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    // 'size' items from 'head' are queued
+    size_t head;
+    size_t size;
+    bool closed;
+
+    size_t pushed;
+    size_t dropped;
+};
+
+/** The queue in front of a stage, and the core it runs on.
+ */
+struct StageOptions {
+    size_t queueSize = 2;
+    QueuePolicy policy = BLOCK;
+    // the CPU core to pin the thread of the stage to. -1: not pinned.
+    int cpu = -1;
+};
+
+struct StageStats {
+    std::string name;
+    size_t processed;
+    // time spent processing an item, in milliseconds
+    double meanTime;
+    double maxTime;
+    // the queue in front of the stage (all zeros for a source)
+    QueueStats input;
+};
+
+/** Runs a chain of stages (eg capture, preprocessing, tracking, publication)
+ * concurrently, each on its own thread, connected by bounded queues.
+ *
+ * The items of type T flow from one stage to the next, each stage working on
+ * an item while the previous stage prepares the next one: the throughput is
+ * the one of the slowest stage, not the sum of all the stages. What happens
+ * when a stage is slower than the previous one is decided by the policy of
+ * its queue (see QueuePolicy).
+ *
+ * The first stage is either a source (see addSource()), which produces the
+ * items on its own thread, or is fed with push() (eg from a callback).
+ *
+ * The items are recycled (see BoundedQueue): in steady state, the pipeline
+ * itself does not allocate.
+ */
+template<typename T>
+class Pipeline {
+
+public:
+    /** A stage processes an item in place. Returning false drops the item
+     * (for a source: ends the stream).
+     */
+    typedef std::function<bool(T&)> Process;
+
+    Pipeline() : started(false), stopping(false) {}
+    ~Pipeline() {stop(); wait();}
+
+    /** Sets the first stage, which fills the items. Must be added first,
+     * before start().
+     */
+    void addSource(const std::string& name, Process process, int cpu = -1) {
+        StageOptions options;
+        options.cpu = cpu;
+        addStage(name, process, options);
+        stages.back()->input.reset();
+    }
+
+    /** Appends a stage, and the queue feeding it. Before start().
+     */
+    void addStage(const std::string& name, Process process,
+                  const StageOptions& options = StageOptions()) {
+        std::unique_ptr<Stage> stage(new Stage);
+        stage->name = name;
+        stage->process = process;
+        stage->cpu = options.cpu;
+        stage->input.reset(new BoundedQueue<T>(options.queueSize, options.policy));
+        stages.push_back(std::move(stage));
+    }
+
+    /** Starts the threads of the stages.
+     */
+    void start() {
+        if (started) return;
+        started = true;
+
+        for (size_t i = 0; i < stages.size(); i++) {
+            Stage& stage = *stages[i];
+            stage.thread = std::thread(&Pipeline::run, this, i);
+            if (stage.cpu >= 0) pinThread(stage.thread, stage.cpu);
+        }
+    }
+
+    /** Feeds an item to the first stage, if it is not a source. 'item' gets
+     * in exchange the buffers of an older one. Returns false if the item was
+     * refused (the pipeline is stopping).
+     */
+    bool push(T& item) {
+        if (stages.empty() || !stages[0]->input || stopping) return false;
+        return stages[0]->input->push(item);
+    }
+
+    /** Asks the pipeline to stop: the source stops producing (or push()
+     * refuses new items), and the items in flight go through the remaining
+     * stages. Does not wait: can be called from a stage.
+     */
+    void stop() {
+        if (stopping.exchange(true)) return;
+        if (!stages.empty() && stages[0]->input) stages[0]->input->close();
+    }
+
+    /** Waits until all the stages are done: the source ended (or stop() was
+     * called), and all the items went through.
+     */
+    void wait() {
+        for (auto& stage : stages) {
+            if (stage->thread.joinable()) stage->thread.join();
+        }
+    }
+
+    /** Returns true until the source ended, or stop() was called.
+     */
+    bool running() const {return !stopping;}
+
+    /** Nb of items processed, processing times, and queues of each stage.
+     * From any thread.
+     */
+    std::vector<StageStats> stats() const {
+        std::vector<StageStats> all;
+        stats(all);
+        return all;
+    }
+
+    /** Same, reusing the buffers of 'all'.
+     */
+    void stats(std::vector<StageStats>& all) const {
+        all.resize(stages.size());
+        for (size_t i = 0; i < stages.size(); i++) {
+            const Stage& stage = *stages[i];
+            StageStats& stats = all[i];
+
+            stats.name.assign(stage.name);
+            stats.processed = stage.processed.load();
+            int64_t busy = stage.busy.load();
+            stats.meanTime = stats.processed ? busy / 1e6 / stats.processed : 0;
+            stats.maxTime = stage.longest.load() / 1e6;
+            stats.input = stage.input ? stage.input->stats() : QueueStats{0, 0, 0, 0};
+        }
+    }
+
+private:
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    struct Stage {
+        Stage() : cpu(-1), processed(0), busy(0), longest(0) {}
+
+        std::string name;
+        Process process;
+        int cpu;
+        // null for a source
+        std::unique_ptr<BoundedQueue<T>> input;
+        std::thread thread;
+
+        std::atomic<size_t> processed;
+        // nanoseconds
+        std::atomic<int64_t> busy;
+        std::atomic<int64_t> longest;
+    };
+
+    void run(size_t index) {
+        Stage& stage = *stages[index];
+        BoundedQueue<T>* output = index + 1 < stages.size() ? stages[index + 1]->input.get()
+                                                            : nullptr;
+        // swapped with the queues: the buffers go round
+        T item;
+
+        while (true) {
+            if (stage.input) {
+                if (!stage.input->pop(item)) break;
+            }
+            else if (stopping) break;
+
+            auto begin = std::chrono::steady_clock::now();
+            bool keep = stage.process(item);
+            int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - begin).count();
+
+            // the end of the stream
+            if (!keep && !stage.input) {
+                stopping = true;
+                break;
+            }
+
+            stage.processed++;
+            stage.busy += elapsed;
+            if (elapsed > stage.longest) stage.longest = elapsed;
+
+            if (keep && output) output->push(item);
+        }
+
+        // the next stage gets the remaining items, then ends too
+        if (output) output->close();
+    }
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    bool started;
+    std::atomic<bool> stopping;
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,50 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <memory>
+
+/** A pool of recyclable objects.
+ *
+ * Objects are allocated once, and handed out again after they are released:
+ * in steady state, acquiring an object does not allocate. Released objects
+ * are not reset: this is up to the caller.
+ *
+ * The pool owns the objects. It grows when exhausted.
+ */
+template<typename T>
+class Pool {
+
+public:
+    Pool(size_t capacity = 0) {reserve(capacity);}
+
+    /** Make sure at least 'capacity' objects are available without further
+     * allocation.
+     */
+    void reserve(size_t capacity) {
+        available.reserve(capacity);
+        while (storage.size() < capacity) {
+            storage.emplace_back(new T());
+            available.push_back(storage.back().get());
+        }
+    }
+
+    T* acquire() {
+        if (available.empty()) reserve(storage.size() == 0 ? 1 : 2 * storage.size());
+
+        T* object = available.back();
+        available.pop_back();
+        return object;
+    }
+
+    void release(T* object) {available.push_back(object);}
+
+    size_t capacity() const {return storage.size();}
+    size_t inUse() const {return storage.size() - available.size();}
+
+private:
+    std::vector<std::unique_ptr<T>> storage;
+    std::vector<T*> available;
+};
+
+#endif // POOL_H
@@ -0,0 +1,82 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "cpu_dispatch.h"
+
+/** Reduced precision kernels of the recognition: the eigenfaces are stored in
+ * float32, and the gallery in int8 (see GalleryIndex).
+ *
+ * The kernels take the code path to use, which must be supported by the CPU
+ * (see bestInstructionSet()). The SIMD ones give the same results
+ * as the scalar one, up to the order of the float additions (the int8 kernels
+ * are exact).
+ */
+
+/** Sum of a[i].b[i], accumulated in float.
+ */
+float dotProduct(const float* a, const float* b, size_t size, InstructionSet set);
+
+/** Sum of a[i].b[i], exact (accumulated in 32 bits: up to 2^17 terms).
+ */
+int32_t dotProduct(const int8_t* a, const int8_t* b, size_t size, InstructionSet set);
+
+/** Quantizes 'vector' to int8 codes in [-127, 127], such that vector[i] ~
+ * scale . codes[i]. Returns the scale: max |vector[i]| / 127, or 0 for a null
+ * vector.
+ */
+float quantize(const float* vector, size_t size, int8_t* codes);
+
+/** Projection of the preprocessed faces on the eigenfaces, in float32.
+ *
+ * Same as cv::subspaceProject with the basis and mean of the model, at half
+ * the memory traffic: the basis is stored one eigenface per row, so that each
+ * component is a contiguous dot product.
+ */
+class FaceProjector {
+
+public:
+    FaceProjector();
+
+    /** 'eigenvectors': one eigenface per column (as cv::FaceRecognizer's
+     * "eigenvectors"), 'mean': one row (its "mean"). Any depth.
+     */
+    void setBasis(const cv::Mat& eigenvectors, const cv::Mat& mean);
+
+    bool empty() const {return components == 0;}
+
+    /** Nb of eigenfaces, ie size of the projections.
+     */
+    size_t dimension() const {return components;}
+
+    /** Projects a face (CV_8U, with as many pixels as the eigenfaces) on the
+     * eigenfaces. 'projection' must hold dimension() values.
+     */
+    void project(const cv::Mat& face, float* projection);
+
+    /** Selects the code path. If the CPU does not support it, the best one
+     * it supports is used instead. Defaults to the best one.
+     */
+    void setInstructionSet(InstructionSet set);
+
+    InstructionSet instructionSet() const {return simd;}
+
+private:
+    InstructionSet simd;
+
+    size_t components;
+    size_t pixels;
+
+    // row-major, one eigenface per row
+    std::vector<float> basis;
+    std::vector<float> mean;
+
+    // the face being projected, minus the mean
+    std::vector<float> centered;
+};
+
+#endif // QUANTIZATION_H
@@ -8,12 +8,30 @@
 #include <opencv2/contrib/contrib.hpp>
 
 #include "detection.h"
+#include "gallery.h"
+#include "quantization.h"
 
 // max nb of image per user we want to train the models on.
 static const int MAX_TRAINING_IMAGES = 5;
 
 static const int FACE_WIDTH = 200;
 
+// nb of eigenfaces (principal components) used to describe a face. A compact
+// description keeps the gallery search fast.
+static const int NB_EIGENFACES = 50;
+
+// The eigenfaces are recomputed each time the number of training images
+// doubles, until that many images have been used. Beyond, the basis is
+// considered stable: new humans are simply projected on it, and their
+// training images are discarded.
+static const int MAX_EIGENFACES_SAMPLES = 500;
+
+// Max nb of distance computations when searching the gallery for the closest
+// known face. 0 means exact search. With very large galleries, a budget of a
+// few hundreds makes the search much faster, at the cost of some recall (see
+// testing/benchmark_gallery).
+static const size_t GALLERY_MAX_CHECKS = 0;
+
 class Recognizer {
 
 public:
@@ -26,26 +44,86 @@ public:
      */
     bool addPictureOf(const cv::Mat& image, const std::string& label);
 
+    /** Same, with the eyes already located (in 'image' coordinates): they
+     * are not detected again.
+     */
+    bool addPictureOf(const cv::Mat& image,
+                      const cv::Point2f& leftEye, const cv::Point2f& rightEye,
+                      const std::string& label);
+
     /** Returns a pair {label, confidence}
+     *
+     * The confidence is the distance, in the eigenfaces space, to the closest
+     * known face (lower is better): 0 for an exact match. The label is empty
+     * if the face could not be recognized.
+     *
+     * The projection is computed in float32, and compared with the int8
+     * gallery (see GalleryIndex): the distances are within ~1% of the ones of
+     * OpenCV's double precision model.
      */
     std::pair<std::string, double> whois(const cv::Mat& image);
 
+    /** Same, with the eyes already located (in 'image' coordinates): they
+     * are not detected again.
+     */
+    std::pair<std::string, double> whois(const cv::Mat& image,
+                                         const cv::Point2f& leftEye, const cv::Point2f& rightEye);
+
 
     cv::Mat reconstructFace(const cv::Mat preprocessedFace);
+
+    /** Detects the eyes in the face, then aligns and normalizes it (see
+     * below). Returns false if the eyes were not found.
+     */
     bool preprocessFace(const cv::Mat& inputImage, cv::Mat& outputImage);
 
+    /** Aligns the face on the eyes (in 'inputImage' coordinates), and
+     * normalizes its brightness and contrast.
+     */
+    bool preprocessFace(const cv::Mat& inputImage,
+                        const cv::Point2f& leftEye, const cv::Point2f& rightEye,
+                        cv::Mat& outputImage);
+
     std::vector<cv::Mat> eigenfaces();
 
+    /** Nb of face pictures (projected on the eigenfaces) in the gallery.
+     */
+    size_t gallerySize() const {return gallery.size();}
+
+    /** Nb of training images collected so far for a label, not trained on
+     * yet.
+     */
+    size_t trainingImages(const std::string& label) const;
+
 private:
+    /** The implementations of addPictureOf() and whois(): 'eyes' holds the
+     * left and right eyes, or is null if they must be detected.
+     */
+    bool addPicture(const cv::Mat& image, const cv::Point2f* eyes, const std::string& label);
+    std::pair<std::string, double> recognize(const cv::Mat& image, const cv::Point2f* eyes);
+
     void train(int label);
 
+    /** Recompute the eigenfaces from all the training images, and re-index
+     * the gallery accordingly.
+     */
+    void computeEigenfaces();
+
     const FaceDetector& _detector;
 
     cv::Ptr<cv::FaceRecognizer> model;
 
+    // PCA basis, cached from the model (in float32)
+    FaceProjector projector;
+    size_t basisSamples;
+    std::vector<float> projection;
+
+    GalleryIndex gallery;
+
     std::map<int, std::vector<cv::Mat>> trainingSet;
     std::map<int, bool> trained_labels;
     std::map<int, std::string> human_labels;
+    std::map<std::string, int> label_ids;
 };
 
 #endif // RECOGNITION_H
@@ -0,0 +1,156 @@
+#ifndef RECOGNITION_WORKER_H
+#define RECOGNITION_WORKER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <opencv2/core/core.hpp>
+
+#include "detection.h"
+#include "recognition.h"
+
+// max nb of face crops waiting for the recognition worker. When the queue is
+// full, new requests are dropped (and counted as such).
+static const size_t RECOGNITION_QUEUE_SIZE = 8;
+
+/** Outcome of a recognition request, addressed to the track that issued it.
+ */
+struct RecognitionResult {
+
+    enum Kind {
+        IDENTIFIED, // the face belongs to an already known human
+        UNKNOWN,    // never seen this face before (or eyes not found)
+        TRAINED,    // enough samples were collected: the recognizer now knows this human
+        SAMPLE_ACQUIRED, // the training sample was added to the training set
+        SAMPLE_REJECTED  // the training sample could not be used (eyes not found, or
+                         // dropped from the full queue)
+    };
+
+    Kind kind;
+    unsigned int trackId;
+    std::string name;
+    double confidence;
+    // the frame the training sample was cropped from (SAMPLE_*)
+    unsigned long frame;
+};
+
+struct RecognitionStats {
+    size_t depth;       // face crops currently waiting in the queue
+    size_t capacity;
+    size_t submitted;
+    size_t processed;
+    size_t dropped;     // requests refused or evicted because the queue was full
+};
+
+/** Runs face recognition and training-sample acquisition on a background
+ * thread, so that eye detection, warping and PCA projection never stall the
+ * tracking loop.
+ *
+ * Requests are copies of the face crops, queued in a bounded queue. Results
+ * are collected by the tracking thread with results(), and applied to the
+ * tracks by ID.
+ *
+ * The queue is a ring of preallocated requests, whose crop buffers are
+ * recycled: in steady state, submitting a request does not allocate.
+ *
+ * The worker owns its own FaceDetector: OpenCV cascade classifiers can not be
+ * shared between threads.
+ */
+class RecognitionWorker {
+
+public:
+    RecognitionWorker(size_t capacity = RECOGNITION_QUEUE_SIZE);
+    ~RecognitionWorker();
+
+    /** Queue a request to identify the given face.
+     *
+     * If known, 'eyes' holds the left and right eyes, in 'face' coordinates:
+     * the recognizer then does not detect them again.
+     *
+     * Identification requests take precedence over training samples: if the
+     * queue is full, the oldest pending training sample is dropped to make
+     * room. Returns false if the request could not be queued.
+     */
+    bool identify(unsigned int trackId, const cv::Mat& face, const cv::Point2f* eyes = nullptr);
+
+    /** Queue a training sample of the given human (with its eyes, if known),
+     * cropped from the frame nb 'frame'. Returns false (and the sample is
+     * dropped) if the queue is full.
+     *
+     * Once processed, the sample is reported as SAMPLE_ACQUIRED or
+     * SAMPLE_REJECTED (or TRAINED, if the recognizer had enough samples).
+     */
+    bool learn(unsigned int trackId, const cv::Mat& face, const std::string& name,
+               unsigned long frame, const cv::Point2f* eyes = nullptr);
+
+    /** Returns in 'results' (and forget) the results produced since the last
+     * call.
+     *
+     * The buffers of 'results' and of the worker are swapped: keep passing
+     * the same vector, and no allocation happens in steady state. Never
+     * blocks on the recognition itself.
+     */
+    void results(std::vector<RecognitionResult>& results);
+
+    RecognitionStats stats() const;
+
+private:
+
+    struct Job {
+        enum Kind {IDENTIFY, LEARN};
+
+        Kind kind;
+        unsigned int trackId;
+        // the frame the face was cropped from (for the traces, and the
+        // results of the training samples)
+        long frame;
+        // a header on 'buffer', which only ever grows: crops up to the
+        // largest one seen so far are copied without allocating
+        cv::Mat face;
+        cv::Mat buffer;
+        // the eyes in 'face' (if eyesKnown)
+        bool eyesKnown;
+        cv::Point2f eyes[2];
+        std::string name;
+    };
+
+    /** Queue a request. The queue lock must be held, and the queue not
+     * full.
+     */
+    void push(Job::Kind kind, unsigned int trackId, long frame, const cv::Mat& face,
+              const cv::Point2f* eyes, const std::string& name);
+
+    Job& slot(size_t position) {return jobs[(head + position) % capacity];}
+
+    void run();
+
+    /** Process one request. Returns true if 'result' is worth reporting to the
+     * tracking thread.
+     */
+    bool process(const Job& job, RecognitionResult& result);
+
+    // only ever used from the worker thread
+    FaceDetector detector;
+    Recognizer recognizer;
+
+    size_t capacity;
+
+    mutable std::mutex jobsMutex;
+    std::condition_variable pending;
+    // ring of 'capacity' jobs: 'queued' of them from 'head' are pending
+    std::vector<Job> jobs;
+    size_t head;
+    size_t queued;
+    std::vector<RecognitionResult> done;
+    bool stopping;
+
+    size_t submitted;
+    size_t processed;
+    size_t dropped;
+
+    std::thread worker;
+};
+
+#endif // RECOGNITION_WORKER_H
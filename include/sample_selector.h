@@ -0,0 +1,118 @@
+#ifndef SAMPLE_SELECTOR_H
+#define SAMPLE_SELECTOR_H
+
+#include <opencv2/core/core.hpp>
+
+// A training sample is only worth acquiring if it differs from each of the
+// previous ones by at least one of:
+//  - the scale: ratio of the face widths
+static const float SAMPLE_MIN_SCALE_CHANGE = 1.15f;
+//  - the head position, from the pose (in meters)
+static const double SAMPLE_MIN_MOTION = 0.05;
+//  - the appearance: mean absolute difference between the (normalized)
+//    signatures, in standard deviations of the gray levels
+static const float SAMPLE_MIN_APPEARANCE_CHANGE = 0.25f;
+
+// Samples are acquired at least SAMPLE_MIN_INTERVAL frames apart...
+static const unsigned int SAMPLE_MIN_INTERVAL = 5;
+// ...and after SAMPLE_MAX_INTERVAL frames without one, any sample will do (a
+// face that hardly moves still gets trained on, eventually)
+static const unsigned int SAMPLE_MAX_INTERVAL = 60;
+
+// the appearance signature is the face downscaled to that many pixels squared
+static const int SIGNATURE_SIZE = 8;
+// nb of acquired samples remembered. The oldest ones are forgotten first.
+static const int MAX_SELECTED_SAMPLES = 8;
+// nb of samples submitted, and not yet acquired or rejected by the
+// recognizer, at most: past that, the recognizer is lagging behind anyway
+static const int MAX_PENDING_SAMPLES = 4;
+
+/** Decides which crops of a face are worth a training sample.
+ *
+ * The recognizer preprocesses each training sample (eye detection, warping,
+ * filtering): submitting the first consecutive frames of a new face would pay
+ * that price for nearly identical samples. Instead, a crop is only selected
+ * if it is different enough from the ones already acquired, by scale, head
+ * position, or appearance (a tiny, contrast-normalized thumbnail), and not
+ * too soon after the previous one.
+ *
+ * A submitted sample is pending until the recognizer reports whether it could
+ * use it: only then is it remembered (learned()), or forgotten (rejected(), eg
+ * the eyes were not found). Pending samples are compared with the new crops
+ * too, so that the same face is not submitted again meanwhile.
+ *
+ * Does not allocate memory.
+ */
+class SampleSelector {
+
+public:
+    SampleSelector() {clear();}
+
+    /** Forget the samples acquired so far.
+     */
+    void clear();
+
+    /** Returns true if 'face' (the crop of the face in the frame nb 'frame')
+     * would make a useful training sample. The cheap criteria are checked
+     * first: the signature is only computed when needed.
+     *
+     * Call submitted() if the sample is actually submitted.
+     */
+    bool isUseful(const cv::Mat& face, const cv::Matx44d& pose, unsigned long frame);
+
+    /** The sample last found useful was submitted: it is pending.
+     */
+    void submitted();
+
+    /** The recognizer acquired the sample of frame nb 'frame': remember it.
+     */
+    void learned(unsigned long frame);
+
+    /** The recognizer could not use the sample of frame nb 'frame': forget
+     * it.
+     */
+    void rejected(unsigned long frame);
+
+    /** Nb of samples learned since clear().
+     */
+    unsigned int accepted() const {return nbAccepted;}
+
+    /** Nb of samples submitted, and neither learned nor rejected yet.
+     */
+    unsigned int pending() const {return nbPending;}
+
+private:
+
+    struct Sample {
+        unsigned long frame;
+        int width;
+        cv::Matx44d pose;
+        float signature[SIGNATURE_SIZE * SIGNATURE_SIZE];
+    };
+
+    /** Computes the signature of the face into candidate.signature.
+     */
+    void computeSignature(const cv::Mat& face);
+
+    bool isSimilar(const Sample& a, const Sample& b) const;
+
+    /** Removes the pending sample of frame nb 'frame' (if any) into
+     * 'sample'. Returns false if there is none.
+     */
+    bool takePending(unsigned long frame, Sample& sample);
+
+    Sample samples[MAX_SELECTED_SAMPLES];
+    unsigned int nbAccepted;
+
+    Sample pendingSamples[MAX_PENDING_SAMPLES];
+    unsigned int nbPending;
+
+    // frame of the last submitted sample, if any
+    bool anySubmitted;
+    unsigned long lastFrame;
+
+    // the sample last passed to isUseful()
+    Sample candidate;
+};
+
+#endif // SAMPLE_SELECTOR_H
@@ -0,0 +1,47 @@
+#ifndef SHM_PUBLISHER_H
+#define SHM_PUBLISHER_H
+
+#include <string>
+#include <vector>
+
+#include "human.h"
+#include "shm_ring.h"
+
+/** Publishes the faces of each frame in a shared memory ring (see
+ * shm_ring.h), for other processes of the machine to read with a
+ * ShmRingReader.
+ *
+ * Optional: the tracker does not need it. There must be a single publisher
+ * per ring. The shared memory object is retired (see shm_ring.h) and removed
+ * when the publisher is destroyed.
+ */
+class ShmPublisher {
+
+public:
+    /** Creates (or takes over) the shared memory object of that name. Check
+     * isOpen(). A ring left behind by a former publisher is retired: its
+     * readers move to the new one.
+     */
+    ShmPublisher(const std::string& name = SHM_RING_NAME);
+    ~ShmPublisher();
+
+    bool isOpen() const {return ring != nullptr;}
+
+    /** Publishes the faces of a new frame (at most SHM_MAX_FACES of them).
+     * Never blocks, nor allocates: slow readers miss frames instead.
+     */
+    void publish(const std::vector<Face>& faces);
+
+    /** Nb of frames published so far.
+     */
+    uint64_t published() const {return ring ? ring->published.load() : 0;}
+
+private:
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+    std::string name;
+    ShmRing* ring;
+};
+
+#endif // SHM_PUBLISHER_H
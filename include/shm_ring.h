@@ -0,0 +1,161 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/** Tracking results in POSIX shared memory, for local processes that do not
+ * link the tracker (see ShmPublisher for the writing side).
+ *
+ * The shared memory holds a ring of frames, written by a single publisher and
+ * read by any number of readers, without locks. Each slot is a sequence lock:
+ * its sequence number is odd while the publisher writes the slot, and tells
+ * which frame the slot holds otherwise. Readers copy the frame, and check that
+ * the sequence did not change meanwhile: if it did, the publisher lapped them
+ * (an overrun), and the copy is discarded.
+ *
+ * A publisher that restarts creates a new shared memory object, under the
+ * same name: the readers still mapping the former one would never see a new
+ * frame. So the former ring is first marked as retired (by the publisher
+ * that stops, or by the one that replaces it after a crash), and readers
+ * then map the new ring.
+ *
+ * This header does not depend on OpenCV: readers only need the
+ * facetracking_reader library.
+ */
+
+static const uint32_t SHM_RING_MAGIC = 0x46545231; // "FTR1"
+static const uint32_t SHM_RING_VERSION = 2;
+
+// default name of the shared memory object
+static const char SHM_RING_NAME[] = "/facetracking";
+
+// nb of frames the ring holds
+static const uint32_t SHM_RING_SLOTS = 64;
+// max nb of faces per frame. The extra ones are not published.
+static const uint32_t SHM_MAX_FACES = 16;
+// max length of a name (0 included). Longer ones are truncated.
+static const uint32_t SHM_NAME_SIZE = 32;
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "The shared memory ring needs lock-free 64 bits atomics"
+#endif
+
+struct ShmFace {
+    uint32_t id;
+    char name[SHM_NAME_SIZE];
+    int32_t x, y, width, height;
+    // the head pose (4x4 transformation, row-major)
+    double pose[16];
+};
+
+struct ShmFrame {
+    // the frame number (as counted by the publisher, from 1)
+    uint64_t frame;
+    // when the frame was published: CLOCK_MONOTONIC, in nanoseconds (the
+    // same clock for all the processes of the machine)
+    int64_t timestamp;
+    uint32_t nbFaces;
+    ShmFace faces[SHM_MAX_FACES];
+};
+
+struct ShmSlot {
+    // 2n + 1 while frame n is written, 2n + 2 once it is complete
+    std::atomic<uint64_t> sequence;
+    ShmFrame frame;
+};
+
+struct ShmRing {
+    // written last by the publisher, once the ring is initialized
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t maxFaces;
+    // the last frame published (0: none yet)
+    std::atomic<uint64_t> published;
+    // non-zero once the publisher stopped, or was replaced: no frame will be
+    // published here anymore
+    std::atomic<uint32_t> retired;
+    ShmSlot slot[SHM_RING_SLOTS];
+};
+
+/** Current time on the clock of ShmFrame::timestamp.
+ */
+int64_t shmTimestamp();
+
+/** Reads the frames published in a shared memory ring.
+ *
+ * Readers do not write to the shared memory: they can not slow the publisher
+ * down, and a reader that falls behind by more than SHM_RING_SLOTS frames
+ * loses the oldest ones (see missed()).
+ *
+ * When the publisher restarts, the reader reads the frames left in the
+ * former ring, then maps the new one (see restarts()): the frame numbers
+ * start over from 1.
+ */
+class ShmRingReader {
+
+public:
+    enum Status {
+        FRAME,    // a frame was read
+        NO_FRAME, // nothing new since the last read
+        OVERRUN   // frames were missed: the most recent one was read instead
+    };
+
+    /** Maps the ring published under that name. Check isOpen(): the
+     * publisher may not be running yet.
+     */
+    ShmRingReader(const std::string& name = SHM_RING_NAME);
+    ~ShmRingReader();
+
+    bool isOpen() const {return ring != nullptr;}
+
+    /** Reads the frame following the last one read (starting from the
+     * frames published after the reader was opened, and from the first frame
+     * of a restarted publisher). Does not block.
+     */
+    Status next(ShmFrame& frame);
+
+    /** Reads the most recent frame. Returns false if none was published yet.
+     */
+    bool latest(ShmFrame& frame);
+
+    /** Nb of frames skipped so far because of overruns.
+     */
+    uint64_t missed() const {return _missed;}
+
+    /** Nb of times the reader followed a restarted publisher to its new
+     * ring.
+     */
+    uint64_t restarts() const {return _restarts;}
+
+private:
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    /** Maps the ring, if it is initialized, compatible and not retired.
+     * Returns false otherwise.
+     */
+    bool open();
+    void close();
+
+    /** If the ring was retired, and all its frames were read, maps the new
+     * one. Returns false if no ring is mapped (yet).
+     */
+    bool followRestart();
+
+    /** Copies frame n. Returns false if the slot does not hold it (anymore).
+     */
+    bool read(uint64_t n, ShmFrame& frame) const;
+
+    std::string name;
+    const ShmRing* ring;
+    // the ring was retired: map the new one as soon as it is there
+    bool restarting;
+    uint64_t lastRead;
+    uint64_t _missed;
+    uint64_t _restarts;
+};
+
+#endif // SHM_RING_H
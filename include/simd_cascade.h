@@ -0,0 +1,158 @@
+#ifndef SIMD_CASCADE_H
+#define SIMD_CASCADE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "cpu_dispatch.h"
+
+/** Drop-in replacement for cv::CascadeClassifier, for stump-based Haar and LBP
+ * cascades (like the ones we ship), in OpenCV's old or new XML format.
+ *
+ * OpenCV evaluates the candidate windows one at a time. Here, each stage is
+ * evaluated on many windows at once (8 with AVX2, 4 with SSE2), and only the
+ * windows that pass a stage are kept (compacted) for the next one: the
+ * vectors stay full in the late, very selective stages.
+ *
+ * Detections are bit-exact with the evaluator OpenCV 2.4 uses for new-format
+ * cascades: same image pyramid, same window steps, same floating point
+ * operations, in the same order. For old-format cascades, OpenCV uses a
+ * different (legacy) code path: use CascadeClassifier::convert to compare.
+ */
+class SimdCascade {
+
+public:
+    SimdCascade();
+    explicit SimdCascade(const std::string& filename);
+
+    /** Loads a cascade. Returns false if the file can not be read, or if the
+     * cascade is not supported (tilted Haar features, trees deeper than
+     * stumps): cv::CascadeClassifier must be used for those.
+     */
+    bool load(const std::string& filename);
+
+    bool empty() const {return stages.empty();}
+
+    cv::Size windowSize() const {return origWinSize;}
+
+    /** Same as cv::CascadeClassifier::detectMultiScale.
+     *
+     * The only flag supported is CASCADE_FIND_BIGGEST_OBJECT, which keeps the
+     * biggest object after grouping.
+     */
+    void detectMultiScale(const cv::Mat& image,
+                          std::vector<cv::Rect>& objects,
+                          double scaleFactor = 1.1,
+                          int minNeighbors = 3,
+                          int flags = 0,
+                          cv::Size minSize = cv::Size(),
+                          cv::Size maxSize = cv::Size());
+
+    /** Selects the code path. If the CPU does not support it, the best one
+     * it supports is used instead. Defaults to the best one.
+     */
+    void setInstructionSet(InstructionSet set);
+
+    InstructionSet instructionSet() const {return simd;}
+
+private:
+
+    enum FeatureType {HAAR_FEATURES, LBP_FEATURES};
+
+    struct Stage {
+        int first, ntrees;
+        float threshold;
+    };
+
+    // Haar stump, in window coordinates. Unused rectangles have a null weight.
+    struct HaarStump {
+        cv::Rect rects[3];
+        float weights[3];
+        float threshold, left, right;
+    };
+
+    // LBP stump: 3x3 blocks of 'rect' size, and the set of LBP codes (256
+    // bits) leading to the left leaf.
+    struct LbpStump {
+        cv::Rect rect;
+        int subset[8];
+        float left, right;
+    };
+
+    // Same stumps, with the rectangles converted to offsets in the integral
+    // image of the current scale.
+    struct HaarNode {
+        int corners[12];
+        float weights[3];
+        int nrects;
+        float threshold, left, right;
+    };
+
+    struct LbpNode {
+        int corners[16];
+        int subset[8];
+        float left, right;
+    };
+
+    static bool readHaarFeature(const cv::FileNode& feature, HaarStump& stump);
+    bool readOldFormat(const cv::FileNode& root);
+    bool readNewFormat(const cv::FileNode& root);
+
+    /** Computes the offsets of the features for an integral image of the
+     * given width.
+     */
+    void compile(int step);
+
+    void detectSingleScale(const cv::Mat& scaledImage,
+                           cv::Size processingRectSize,
+                           int yStep, double factor,
+                           std::vector<cv::Rect>& candidates);
+
+    /** Runs the cascade on all the windows of a scale, once 'sum' (and
+     * 'sqsum' for Haar cascades) point to its integral image(s), 'cn' wide.
+     */
+    void evaluateWindows(int cn, cv::Size processingRectSize,
+                         int yStep, double factor,
+                         std::vector<cv::Rect>& candidates);
+
+    /** Evaluates a stage on windows[0..count), and stores the outcome in
+     * 'pass'.
+     */
+    void runStage(const Stage& stage, size_t count);
+
+    void haarStageScalar(const Stage& stage, size_t begin, size_t end);
+    void lbpStageScalar(const Stage& stage, size_t begin, size_t end);
+    void haarStageSse2(const Stage& stage, size_t count);
+    void lbpStageSse2(const Stage& stage, size_t count);
+    void haarStageAvx2(const Stage& stage, size_t count);
+    void lbpStageAvx2(const Stage& stage, size_t count);
+
+    InstructionSet simd;
+
+    FeatureType featureType;
+    cv::Size origWinSize;
+    std::vector<Stage> stages;
+    std::vector<HaarStump> haarStumps;
+    std::vector<LbpStump> lbpStumps;
+
+    int compiledStep;
+    std::vector<HaarNode> haarNodes;
+    std::vector<LbpNode> lbpNodes;
+    int normCorners[4];
+    int normArea;
+
+    // buffers, kept from one call to the next
+    cv::Mat imageBuffer, sumBuffer, sqsumBuffer;
+    const int* sum;
+    const double* sqsum;
+
+    // candidate windows (offset of their top-left corner in the integral
+    // image), their inverse standard deviation (Haar only), and whether they
+    // passed the current stage
+    std::vector<int> windows;
+    std::vector<double> norms;
+    std::vector<unsigned char> pass;
+};
+
+#endif // SIMD_CASCADE_H
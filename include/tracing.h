@@ -0,0 +1,126 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/** Timeline of what the library spends its time on, in the Chrome trace
+ * format (open it in chrome://tracing or https://ui.perfetto.dev).
+ *
+ * The expensive calls are wrapped in spans:
+ *
+ *     void FaceDetector::detectBothEyes(...) {
+ *         TRACE_SPAN("FaceDetector::detectBothEyes");
+ *         ...
+ *
+ * Each span is tagged with the frame and the track it was recorded for (see
+ * TRACE_CONTEXT), and stored in a buffer of the recording thread: threads do
+ * not contend. The buffers are written to the file by stopTracing().
+ *
+ * Tracing is off until startTracing(): until then, a span only costs a
+ * relaxed atomic load. Without FACETRACKING_TRACING (see the WITH_TRACING CMake
+ * option), the spans are compiled out entirely.
+ */
+
+// max nb of spans recorded per thread during a session: past that, spans are
+// dropped (and counted). Several minutes of tracking, with a few faces.
+static const size_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+/** Starts recording the spans, to be written to 'path' by stopTracing(). The
+ * buffers of the threads are allocated when they record their first span.
+ */
+void startTracing(const std::string& path);
+
+/** Stops recording, and writes the spans recorded so far. Returns false if
+ * the file could not be written.
+ */
+bool stopTracing();
+
+/** Nb of spans dropped during the current (or last) session, because a
+ * thread buffer was full.
+ */
+size_t droppedSpans();
+
+namespace tracing {
+
+extern std::atomic<bool> enabled;
+
+/** The frame and the track the current thread is working on: the spans
+ * recorded meanwhile are tagged with them. -1: unknown.
+ */
+struct Context {
+    long frame;
+    int track;
+};
+
+Context& context();
+
+/** Stores a complete span in the buffer of the current thread.
+ */
+void record(const char* name, int64_t begin, int64_t end, const Context& context);
+
+inline int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Records the span from its construction to its destruction. 'name' must be
+ * a string literal (only the pointer is stored).
+ */
+class Span {
+
+public:
+    explicit Span(const char* name) : name(nullptr) {
+        if (!enabled.load(std::memory_order_relaxed)) return;
+        this->name = name;
+        spanContext = context();
+        begin = now();
+    }
+    ~Span() {
+        if (name) record(name, begin, now(), spanContext);
+    }
+
+private:
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    const char* name;
+    Context spanContext;
+    int64_t begin;
+};
+
+/** Sets the frame and track of the current thread, until the end of the
+ * scope. A negative value keeps the current one.
+ */
+class Scope {
+
+public:
+    Scope(long frame, int track) : previous(context()) {
+        if (frame >= 0) context().frame = frame;
+        if (track >= 0) context().track = track;
+    }
+    ~Scope() {context() = previous;}
+
+private:
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    Context previous;
+};
+
+} // namespace tracing
+
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef FACETRACKING_TRACING
+#define TRACE_SPAN(name) tracing::Span TRACE_CONCAT(_traceSpan, __LINE__)(name)
+#define TRACE_CONTEXT(frame, track) tracing::Scope TRACE_CONCAT(_traceScope, __LINE__)(frame, track)
+#else
+#define TRACE_SPAN(name) do {} while (0)
+#define TRACE_CONTEXT(frame, track) do {} while (0)
+#endif
+
+#endif // TRACING_H
@@ -0,0 +1,141 @@
+#ifndef TRACK_LOG_H
+#define TRACK_LOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+/** Binary log of the tracking results, for offline analysis (see
+ * TrackLogWriter for the writing side, and the tracklog tool).
+ *
+ * The file is a header followed by fixed-size records, only ever appended:
+ *  - a FACE record per track and per frame (LOST tracks included): where the
+ *    face is, its pose, and the mode of the track;
+ *  - a NAME record each time a name is used for the first time. The FACE
+ *    records refer to the names by their index: the names form a string
+ *    table, built as the file is read.
+ *
+ * The records are in frame order: the faces of a frame are found by binary
+ * search. A log cut short (eg the tracker crashed) is still valid, up to its
+ * last complete record.
+ *
+ * This header does not depend on OpenCV: readers only need the
+ * facetracking_reader library.
+ */
+
+static const uint32_t TRACK_LOG_MAGIC = 0x46544C31; // "FTL1"
+static const uint32_t TRACK_LOG_VERSION = 2;
+
+// max length of a name (0 included). Longer ones are truncated.
+static const uint32_t TRACK_LOG_NAME_SIZE = 68;
+
+enum TrackLogKind : uint32_t {TRACK_LOG_FACE = 1, TRACK_LOG_NAME = 2};
+
+// the modes of the tracks, as Mode (see human.h)
+static const char* const TRACK_LOG_MODES[] = {"tentative", "tracking", "lost", "expired"};
+
+struct TrackLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+struct TrackLogFace {
+    // index of the name in the string table
+    uint32_t name;
+    int32_t x, y, width, height;
+    // Mode and Identity of the track (see human.h)
+    uint8_t mode;
+    uint8_t identity;
+    uint16_t reserved;
+    // the head pose: the first 3 rows of the 4x4 transformation, row-major
+    float pose[12];
+};
+
+struct TrackLogName {
+    // index of the name in the string table: 0 for the first one, and so on
+    uint32_t index;
+    char name[TRACK_LOG_NAME_SIZE];
+};
+
+struct TrackLogRecord {
+    // the frame number (as counted by the tracker)
+    uint64_t frame;
+    // when the frame was tracked: steady clock (CLOCK_MONOTONIC on Linux),
+    // in nanoseconds
+    int64_t timestamp;
+    // the stamp of the image the frame comes from (eg its ROS header stamp),
+    // in nanoseconds since the epoch of the camera clock. 0 if unknown.
+    int64_t stamp;
+    uint32_t kind;
+    // the track id (FACE records)
+    uint32_t track;
+    union {
+        TrackLogFace face;
+        TrackLogName name;
+    };
+};
+
+static_assert(sizeof(TrackLogRecord) == 104, "the layout of the track log records must not change");
+
+/** Random access to a track log, mapped in memory.
+ *
+ * Opening the log reads the string table, and indexes the records of each
+ * track. The faces of a frame are found by binary search.
+ */
+class TrackLogReader {
+
+public:
+    /** Maps the log. Check isOpen(): the file may not exist, or not be a
+     * track log.
+     */
+    TrackLogReader(const std::string& path);
+    ~TrackLogReader();
+
+    bool isOpen() const {return records != nullptr;}
+
+    /** All the records (NAME ones included), in the order they were
+     * written.
+     */
+    const TrackLogRecord* begin() const {return records;}
+    const TrackLogRecord* end() const {return records + nbRecords;}
+
+    /** Nb of FACE records.
+     */
+    size_t faces() const {return nbFaces;}
+
+    /** The FACE records of frame 'n' (none if no face was tracked then).
+     */
+    void frame(uint64_t n, std::vector<const TrackLogRecord*>& faces) const;
+
+    /** The FACE records of a track, in frame order.
+     */
+    void track(uint32_t id, std::vector<const TrackLogRecord*>& faces) const;
+
+    /** The ids of all the tracks.
+     */
+    std::vector<uint32_t> tracks() const;
+
+    /** The name of a FACE record.
+     */
+    const std::string& name(const TrackLogRecord& face) const;
+
+private:
+    TrackLogReader(const TrackLogReader&) = delete;
+    TrackLogReader& operator=(const TrackLogReader&) = delete;
+
+    void* memory;
+    size_t size;
+
+    const TrackLogRecord* records;
+    size_t nbRecords;
+    size_t nbFaces;
+
+    std::vector<std::string> names;
+    // track id -> indices of its FACE records
+    std::map<uint32_t, std::vector<uint32_t>> trackRecords;
+};
+
+#endif // TRACK_LOG_H
@@ -0,0 +1,77 @@
+#ifndef TRACK_LOG_WRITER_H
+#define TRACK_LOG_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+
+#include "facetracking.h"
+#include "pipeline.h"
+#include "track_log.h"
+
+// nb of records encoded before they are handed over to the writing thread
+static const size_t TRACK_LOG_BATCH = 1024;
+// nb of batches waiting to be written, at most: past that, log() blocks
+static const size_t TRACK_LOG_QUEUE = 8;
+// a batch is handed over at least that often, so that a crash loses little
+static const std::chrono::milliseconds TRACK_LOG_FLUSH_INTERVAL(1000);
+
+/** Appends the tracking results to a binary track log (see track_log.h).
+ *
+ * The tracking thread only encodes the records into batches, which a
+ * background thread writes to the file: the tracking never waits for the
+ * disk (unless the disk can not even keep up with the log, and the queue of
+ * batches is full). The batches are recycled: once the names are known,
+ * logging does not allocate.
+ *
+ * The file is overwritten when the writer is created.
+ */
+class TrackLogWriter {
+
+public:
+    /** Check isOpen(): the file may not be writable.
+     */
+    TrackLogWriter(const std::string& path);
+
+    /** Writes the pending records, and closes the file.
+     */
+    ~TrackLogWriter();
+
+    bool isOpen() const {return file != nullptr;}
+
+    /** Logs the tracks of a frame (see FaceTracking::snapshot()), whose
+     * image was stamped 'stamp' by its source (see TrackLogRecord::stamp).
+     * From one thread at a time.
+     */
+    void log(const TrackingSnapshot& snapshot, int64_t stamp = 0);
+
+    /** Hands the records logged so far over to the writing thread.
+     */
+    void flush();
+
+private:
+    TrackLogWriter(const TrackLogWriter&) = delete;
+    TrackLogWriter& operator=(const TrackLogWriter&) = delete;
+
+    /** The index of a name in the string table. A NAME record is logged the
+     * first time it is used.
+     */
+    uint32_t nameIndex(const std::string& name, uint64_t frame, int64_t timestamp, int64_t stamp);
+
+    void run();
+
+    std::string path;
+    FILE* file;
+
+    // the records being encoded
+    std::vector<TrackLogRecord> batch;
+    std::chrono::steady_clock::time_point lastFlush;
+    std::unordered_map<std::string, uint32_t> names;
+
+    BoundedQueue<std::vector<TrackLogRecord>> queue;
+    std::thread writer;
+};
+
+#endif // TRACK_LOG_WRITER_H
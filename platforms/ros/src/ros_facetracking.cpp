@@ -1,4 +1,6 @@
 #include <string>
+#include <atomic>
+#include <memory>
 
 // ROS
 #include <ros/ros.h>
@@ -6,8 +8,13 @@
 #include <image_transport/image_transport.h>
 #include <cv_bridge/cv_bridge.h>
 #include <std_msgs/Int16.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <diagnostic_updater/publisher.h>
 
 #include "facetracking.h"
+#include "pipeline.h"
+#include "tracing.h"
+#include "track_log_writer.h"
 
 // how many second in the *future* the markers transformation should be published?
 // this allow to compensate for the 'slowness' of tag detection, but introduce
@@ -18,6 +25,33 @@
 using namespace std;
 using namespace cv;
 
+/** What goes through the pipeline: an image, and what was found in it.
+ */
+struct Frame {
+    // keeps the image message alive, without copying it
+    cv_bridge::CvImageConstPtr image;
+    // the stamp of the image header
+    ros::Time stamp;
+    vector<Face> faces;
+    // only taken if the tracks are logged
+    TrackingSnapshot snapshot;
+};
+
+/** The thresholds of the diagnostics: past them, the tracker is reported to
+ * fall behind its camera.
+ */
+struct DiagnosticsParameters {
+    // expected rates of the images, and of the tracking results (Hz)
+    double minRate = 5.;
+    double maxRate = 60.;
+    // max delay between the stamp of an image and the publication of the
+    // humans found in it (s)
+    double maxLatency = 0.5;
+    // max ratio of the images not tracked (missed by the subscriber, or
+    // dropped by the tracker), between two updates of the diagnostics
+    double maxDropRatio = 0.2;
+};
+
 class ROSFaceTracker {
 
     ros::NodeHandle& rosNode;
@@ -30,24 +64,106 @@ class ROSFaceTracker {
 
     ros::Publisher detectedfaces_pub;
 
-    Mat inputImage;
-
     FaceTracking facetracking;
 
+    // the binary log of the tracks, if requested
+    unique_ptr<TrackLogWriter> trackLog;
+
+    DiagnosticsParameters diagnostics;
+    diagnostic_updater::Updater updater;
+    ros::Timer diagnosticsTimer;
+    // rate of the images
+    unique_ptr<diagnostic_updater::HeaderlessTopicDiagnostic> inputStatus;
+    // rate of the results, and latency from the image stamps
+    unique_ptr<diagnostic_updater::TopicDiagnostic> trackingStatus;
+
+    // only used from the image callbacks
+    uint32_t lastSeq;
+    atomic<size_t> received;
+    // images the subscriber missed (gaps in the header sequence numbers):
+    // its queue only holds one image
+    atomic<size_t> missed;
+    // the counts at the last update of the diagnostics
+    size_t reportedReceived, reportedMissed, reportedDropped;
+    vector<StageStats> stageStats;
+
+    // tracking and publication run on their own threads, so that the image
+    // callbacks are never held up by the tracking
+    Pipeline<Frame> pipeline;
+    // only used from the image callbacks
+    Frame input;
+
 public:
 
     ROSFaceTracker(ros::NodeHandle& rosNode,
-                      const string& camera_frame):
+                      const string& camera_frame,
+                      const TrackingParameters& params,
+                      QueuePolicy trackingPolicy,
+                      const DiagnosticsParameters& diagnostics,
+                      const string& trackLogPath):
             rosNode(rosNode),
             it(rosNode),
-            camera_frame(camera_frame)
+            camera_frame(camera_frame),
+            facetracking(params),
+            diagnostics(diagnostics),
+            lastSeq(0),
+            received(0),
+            missed(0),
+            reportedReceived(0),
+            reportedMissed(0),
+            reportedDropped(0)
     {
+        if (!trackLogPath.empty()) trackLog.reset(new TrackLogWriter(trackLogPath));
+
+        updater.setHardwareID(camera_frame);
+
+        diagnostic_updater::FrequencyStatusParam rates(&this->diagnostics.minRate,
+                                                       &this->diagnostics.maxRate);
+        inputStatus.reset(new diagnostic_updater::HeaderlessTopicDiagnostic(
+                                "images", updater, rates));
+        trackingStatus.reset(new diagnostic_updater::TopicDiagnostic(
+                                "tracking", updater, rates,
+                                diagnostic_updater::TimeStampStatusParam(-1., diagnostics.maxLatency)));
+        updater.add("frame drops", this, &ROSFaceTracker::dropDiagnostics);
+
+        // from the spinner: the diagnostics are still reported when the
+        // images stop coming
+        diagnosticsTimer = rosNode.createTimer(ros::Duration(1.),
+                                               [this](const ros::TimerEvent&) {updater.update();});
+
+        StageOptions options;
+        options.policy = trackingPolicy;
+        pipeline.addStage("track", [this](Frame& frame) {
+            // copy-assignment reuses the buffers of the frame
+            frame.faces = facetracking.track(frame.image->image);
+            if (trackLog) facetracking.snapshot(frame.snapshot);
+            return true;
+        }, options);
+
+        options.policy = BLOCK;
+        pipeline.addStage("publish", [this](Frame& frame) {
+            publish(frame.faces);
+            // the header stamp relates the log to the bags, and to TF
+            if (trackLog) trackLog->log(frame.snapshot, (int64_t) frame.stamp.toNSec());
+            trackingStatus->tick(frame.stamp);
+            return true;
+        }, options);
+
+        pipeline.start();
 
         sub = it.subscribeCamera("image", 1, &ROSFaceTracker::track, this);
 
         detectedfaces_pub = rosNode.advertise<std_msgs::Int16>("detectedfaces", 5);
     }
 
+    ~ROSFaceTracker()
+    {
+        diagnosticsTimer.stop();
+        sub.shutdown();
+        pipeline.stop();
+        pipeline.wait();
+    }
+
     void setROSTransform(Matx44d trans, tf::Transform& transform)
     {
         transform.setOrigin( tf::Vector3( trans(0,3) / 1000,
@@ -66,15 +182,23 @@ public:
     void track(const sensor_msgs::ImageConstPtr& msg, 
                const sensor_msgs::CameraInfoConstPtr& camerainfo)
     {
-        // hopefully no copy here:
-        //  - assignement operator of cv::Mat does not copy the data
-        //  - toCvShare does no copy if the default (source) encoding is used.
-        inputImage = cv_bridge::toCvShare(msg, "mono8")->image; 
-
-
-        auto humans = facetracking.track(inputImage);
+        // hopefully no copy here: toCvShare does no copy if the default
+        // (source) encoding is used.
+        input.image = cv_bridge::toCvShare(msg, "mono8");
+        input.stamp = msg->header.stamp;
+
+        inputStatus->tick();
+        received++;
+        // (some drivers do not number the images)
+        if (lastSeq != 0 && msg->header.seq > lastSeq + 1) missed += msg->header.seq - lastSeq - 1;
+        lastSeq = msg->header.seq;
+
+        pipeline.push(input);
+    }
 
-        ROS_INFO_STREAM(humans.size() << " humans found.");
+    void publish(const vector<Face>& humans)
+    {
+        ROS_DEBUG_STREAM(humans.size() << " humans found.");
 
         detectedfaces_pub.publish(humans.size());
 
@@ -94,6 +218,45 @@ public:
 
     }
 
+    void dropDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status)
+    {
+        // the images the tracker could not keep up with
+        pipeline.stats(stageStats);
+        const StageStats& tracking = stageStats[0];
+
+        size_t received = this->received, missed = this->missed;
+        size_t newReceived = received - reportedReceived;
+        size_t newMissed = missed - reportedMissed;
+        size_t newDropped = tracking.input.dropped - reportedDropped;
+        reportedReceived = received;
+        reportedMissed = missed;
+        reportedDropped = tracking.input.dropped;
+
+        size_t images = newReceived + newMissed;
+        double ratio = images ? (double) (newMissed + newDropped) / images : 0.;
+
+        if (images == 0) {
+            status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "No image received");
+        }
+        else if (ratio > diagnostics.maxDropRatio) {
+            status.summaryf(diagnostic_msgs::DiagnosticStatus::WARN,
+                            "%.0f%% of the images were not tracked: the tracker falls behind the camera",
+                            100. * ratio);
+        }
+        else {
+            status.summary(diagnostic_msgs::DiagnosticStatus::OK, "The tracker keeps up with the camera");
+        }
+
+        status.add("Images received", newReceived);
+        status.add("Images missed by the subscriber", newMissed);
+        status.add("Images dropped by the tracker", newDropped);
+        status.add("Drop ratio", ratio);
+        status.add("Max drop ratio", diagnostics.maxDropRatio);
+        status.add("Tracking queue depth", tracking.input.depth);
+        status.add("Mean tracking time (ms)", tracking.meanTime);
+        status.add("Max tracking time (ms)", tracking.maxTime);
+    }
+
 
 };
 
@@ -110,12 +273,74 @@ int main(int argc, char* argv[])
     string camera_frame;
     _private_node.param<string>("camera_frame_id", camera_frame, "camera");
 
+    // face detector: 'haar' (default) or 'lbp' (faster)
+    string detector;
+    _private_node.param<string>("detector", detector, "haar");
+
+    TrackingParameters params;
+    if (!detectorFromName(detector, params.detector)) {
+        ROS_ERROR_STREAM("Unknown face detector <" << detector << ">. Use 'haar' or 'lbp'.");
+        return 1;
+    }
+
+    // use our vectorized cascade evaluator instead of OpenCV's
+    bool simd_cascades;
+    _private_node.param<bool>("simd_cascades", simd_cascades, false);
+    if (simd_cascades) params.cascadeEngine = SIMD_CASCADES;
+
+    // static camera: only look for faces where the image changes
+    _private_node.param<bool>("motion_gating", params.motionGating, false);
+
+    // range of face sizes (widths in pixels) worth detecting, depending on
+    // where the camera is mounted. 0: no bound.
+    _private_node.param<int>("min_face_size", params.faceSizes.minFace, 0);
+    _private_node.param<int>("max_face_size", params.faceSizes.maxFace, 0);
+
+    // max nb of local searches for the faces of failing tracks, per frame
+    int rescue_budget;
+    _private_node.param<int>("rescue_budget", rescue_budget, params.rescueBudget);
+    params.rescueBudget = max(0, rescue_budget);
+
+    // max nb of training samples submitted to the recognizer, per frame
+    int training_budget;
+    _private_node.param<int>("training_budget", training_budget, params.trainingBudget);
+    params.trainingBudget = max(0, training_budget);
+
+    // how the tracker keeps up with the camera: 'keep-latest' (only the most
+    // recent image is tracked), 'drop-oldest' or 'block'
+    string tracking_policy;
+    _private_node.param<string>("tracking_policy", tracking_policy, "keep-latest");
+    QueuePolicy trackingPolicy;
+    if (!queuePolicyFromName(tracking_policy, trackingPolicy)) {
+        ROS_ERROR_STREAM("Unknown queue policy <" << tracking_policy << ">. Use 'keep-latest', 'drop-oldest' or 'block'.");
+        return 1;
+    }
+
+    // records a timeline of the library (see tracing.h), written to that
+    // file when the node exits
+    string trace_file;
+    _private_node.param<string>("trace_file", trace_file, "");
+    if (!trace_file.empty()) startTracing(trace_file);
+
+    // logs the tracks in that binary file, for offline analysis (see
+    // track_log.h, and the tracklog tool)
+    string track_log;
+    _private_node.param<string>("track_log", track_log, "");
+
+    // thresholds of the diagnostics (see DiagnosticsParameters)
+    DiagnosticsParameters diagnostics;
+    _private_node.param<double>("min_rate", diagnostics.minRate, diagnostics.minRate);
+    _private_node.param<double>("max_rate", diagnostics.maxRate, diagnostics.maxRate);
+    _private_node.param<double>("max_latency", diagnostics.maxLatency, diagnostics.maxLatency);
+    _private_node.param<double>("max_drop_ratio", diagnostics.maxDropRatio, diagnostics.maxDropRatio);
 
     // initialize the detector by subscribing to the camera video stream
-    ROSFaceTracker tracker(rosNode, camera_frame);
+    ROSFaceTracker tracker(rosNode, camera_frame, params, trackingPolicy, diagnostics, track_log);
     ROS_INFO_STREAM("ros_facetracking is ready. Humans locations will be published on TF. The camera frame is " << camera_frame);
     ros::spin();
 
+    if (!trace_file.empty()) stopTracing();
+
     return 0;
 }
 
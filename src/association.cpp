@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "association.h"
+
+using namespace cv;
+using namespace std;
+
+// cost of the pairs that are not candidates
+static const float NOT_A_CANDIDATE = 1e6f;
+
+float Associator::iou(const Rect& a, const Rect& b)
+{
+    int x0 = max(a.x, b.x), y0 = max(a.y, b.y);
+    int x1 = min(a.x + a.width, b.x + b.width), y1 = min(a.y + a.height, b.y + b.height);
+
+    if (x1 <= x0 || y1 <= y0) return 0.f;
+
+    float intersection = (float) (x1 - x0) * (y1 - y0);
+    return intersection / (a.area() + b.area() - intersection);
+}
+
+float Associator::cost(const Rect& track, const Rect& detection)
+{
+    float dx = (detection.x + detection.width * .5f) - (track.x + track.width * .5f);
+    float dy = (detection.y + detection.height * .5f) - (track.y + track.height * .5f);
+    float diagonal = sqrt((float) track.width * track.width + (float) track.height * track.height);
+
+    return 1.f - iou(track, detection)
+           + ASSOCIATION_MOTION_WEIGHT * sqrt(dx * dx + dy * dy) / max(diagonal, 1.f);
+}
+
+void Associator::findCandidates(const vector<Rect>& tracks,
+                                const vector<Rect>& detections)
+{
+    candidates.clear();
+
+    if (tracks.empty() || detections.empty()) return;
+
+    // Tracks are registered in the cells covered by their bounding box,
+    // enlarged so that any detection close enough to be a candidate overlaps
+    // it. Cells are as large as the largest enlarged track: each track lands
+    // in at most 2x2 cells.
+    auto margin = [](const Rect& r) {
+        return (int) ceil((ASSOCIATION_MAX_COST - 1.f) / ASSOCIATION_MOTION_WEIGHT
+                          * sqrt((float) r.width * r.width + (float) r.height * r.height));
+    };
+
+    int cellSize = 1;
+    int minX = numeric_limits<int>::max(), minY = numeric_limits<int>::max();
+    int maxX = numeric_limits<int>::min(), maxY = numeric_limits<int>::min();
+
+    for (const auto& t : tracks) {
+        int m = margin(t);
+        cellSize = max(cellSize, max(t.width, t.height) + 2 * m);
+        minX = min(minX, t.x - m);
+        minY = min(minY, t.y - m);
+        maxX = max(maxX, t.x + t.width + m);
+        maxY = max(maxY, t.y + t.height + m);
+    }
+
+    int gridWidth = (maxX - minX) / cellSize + 1;
+    int gridHeight = (maxY - minY) / cellSize + 1;
+
+    auto cellRange = [&](int x0, int y0, int x1, int y1, int& cx0, int& cy0, int& cx1, int& cy1) {
+        cx0 = max(0, (x0 - minX) / cellSize);
+        cy0 = max(0, (y0 - minY) / cellSize);
+        cx1 = min(gridWidth - 1, (x1 - minX) / cellSize);
+        cy1 = min(gridHeight - 1, (y1 - minY) / cellSize);
+    };
+
+    // count the tracks per cell...
+    cellStart.assign(gridWidth * gridHeight + 1, 0);
+    for (const auto& t : tracks) {
+        int m = margin(t), cx0, cy0, cx1, cy1;
+        cellRange(t.x - m, t.y - m, t.x + t.width + m, t.y + t.height + m, cx0, cy0, cx1, cy1);
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++)
+                cellStart[cy * gridWidth + cx + 1]++;
+    }
+    for (size_t i = 1; i < cellStart.size(); i++) cellStart[i] += cellStart[i - 1];
+
+    // ...then fill them
+    cellTracks.resize(cellStart.back());
+    lastSeen.assign(cellStart.size(), 0); // used as insertion cursor
+    for (size_t i = 0; i < tracks.size(); i++) {
+        const auto& t = tracks[i];
+        int m = margin(t), cx0, cy0, cx1, cy1;
+        cellRange(t.x - m, t.y - m, t.x + t.width + m, t.y + t.height + m, cx0, cy0, cx1, cy1);
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++) {
+                int cell = cy * gridWidth + cx;
+                cellTracks[cellStart[cell] + lastSeen[cell]++] = i;
+            }
+    }
+
+    // for each detection, only look at the tracks sharing a cell with it
+    lastSeen.assign(tracks.size(), -1);
+    for (size_t d = 0; d < detections.size(); d++) {
+        const auto& det = detections[d];
+
+        if (det.x > maxX || det.y > maxY
+            || det.x + det.width < minX || det.y + det.height < minY) continue;
+
+        int cx0, cy0, cx1, cy1;
+        cellRange(det.x, det.y, det.x + det.width, det.y + det.height, cx0, cy0, cx1, cy1);
+
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++) {
+                int cell = cy * gridWidth + cx;
+                for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+                    int t = cellTracks[i];
+                    if (lastSeen[t] == (int) d) continue; // already considered
+                    lastSeen[t] = d;
+
+                    float c = cost(tracks[t], det);
+                    if (c < ASSOCIATION_MAX_COST) candidates.push_back(Candidate{t, (int) d, c, -1});
+                }
+            }
+    }
+}
+
+int Associator::findRoot(int node)
+{
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+const vector<int>& Associator::associate(const vector<Rect>& tracks,
+                                         const vector<Rect>& detections)
+{
+    assignment.assign(detections.size(), -1);
+
+    findCandidates(tracks, detections);
+
+    if (candidates.empty()) return assignment;
+
+    // Group the candidates in independent clusters (nodes are the tracks,
+    // followed by the detections). In practice, clusters are tiny, even in
+    // crowds: the optimal assignment is computed per cluster.
+    int nbTracks = tracks.size();
+    parent.resize(nbTracks + detections.size());
+    for (size_t i = 0; i < parent.size(); i++) parent[i] = i;
+
+    for (const auto& c : candidates) {
+        int a = findRoot(c.track), b = findRoot(nbTracks + c.detection);
+        if (a != b) parent[a] = b;
+    }
+    for (auto& c : candidates) c.cluster = findRoot(c.track);
+
+    sort(candidates.begin(), candidates.end(),
+         [](const Candidate& a, const Candidate& b) {return a.cluster < b.cluster;});
+
+    clusterOf.assign(parent.size(), -1); // local index of each node in its cluster
+
+    size_t begin = 0;
+    while (begin < candidates.size()) {
+        size_t end = begin;
+        while (end < candidates.size() && candidates[end].cluster == candidates[begin].cluster) end++;
+
+        // trivial (and by far the most common) case: one track, one detection
+        if (end - begin == 1) {
+            assignment[candidates[begin].detection] = candidates[begin].track;
+            begin = end;
+            continue;
+        }
+
+        trackIds.clear();
+        detectionIds.clear();
+        for (size_t i = begin; i < end; i++) {
+            int t = candidates[i].track, d = nbTracks + candidates[i].detection;
+            if (clusterOf[t] < 0) {clusterOf[t] = trackIds.size(); trackIds.push_back(t);}
+            if (clusterOf[d] < 0) {clusterOf[d] = detectionIds.size(); detectionIds.push_back(d);}
+        }
+
+        // the Hungarian algorithm wants at most as many rows as columns
+        bool tracksAsRows = trackIds.size() <= detectionIds.size();
+        int rows = tracksAsRows ? trackIds.size() : detectionIds.size();
+        int cols = tracksAsRows ? detectionIds.size() : trackIds.size();
+
+        matrix.assign(rows * cols, NOT_A_CANDIDATE);
+        for (size_t i = begin; i < end; i++) {
+            int t = clusterOf[candidates[i].track], d = clusterOf[nbTracks + candidates[i].detection];
+            if (tracksAsRows) matrix[t * cols + d] = candidates[i].cost;
+            else matrix[d * cols + t] = candidates[i].cost;
+        }
+
+        hungarian(rows, cols);
+
+        for (int r = 0; r < rows; r++) {
+            int c = colOfRow[r];
+            if (c < 0 || matrix[r * cols + c] >= ASSOCIATION_MAX_COST) continue;
+
+            int t = tracksAsRows ? trackIds[r] : trackIds[c];
+            int d = (tracksAsRows ? detectionIds[c] : detectionIds[r]) - nbTracks;
+            assignment[d] = t;
+        }
+
+        begin = end;
+    }
+
+    return assignment;
+}
+
+/**
+ * Shortest augmenting path version of the Hungarian algorithm, O(rows^2.cols).
+ * Indices are 1-based internally, 0 being a virtual column.
+ */
+void Associator::hungarian(int rows, int cols)
+{
+    const float INF = numeric_limits<float>::max();
+
+    u.assign(rows + 1, 0.f);
+    v.assign(cols + 1, 0.f);
+    p.assign(cols + 1, 0);
+    way.assign(cols + 1, 0);
+
+    for (int i = 1; i <= rows; i++) {
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(cols + 1, INF);
+        used.assign(cols + 1, false);
+
+        do {
+            used[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            float delta = INF;
+
+            for (int j = 1; j <= cols; j++) {
+                if (used[j]) continue;
+
+                float cur = matrix[(i0 - 1) * cols + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j]) {minv[j] = cur; way[j] = j0;}
+                if (minv[j] < delta) {delta = minv[j]; j1 = j;}
+            }
+
+            for (int j = 0; j <= cols; j++) {
+                if (used[j]) {u[p[j]] += delta; v[j] -= delta;}
+                else minv[j] -= delta;
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    colOfRow.assign(rows, -1);
+    for (int j = 1; j <= cols; j++) {
+        if (p[j] > 0) colOfRow[p[j] - 1] = j - 1;
+    }
+}
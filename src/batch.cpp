@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <functional> // greater
+#include <limits>
+#include <thread>
+#include <tuple>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "batch.h"
+#include "logging.h"
+
+using namespace cv;
+using namespace std;
+
+#ifdef OPENCV3
+static const int FRAME_COUNT = cv::CAP_PROP_FRAME_COUNT;
+static const int POS_FRAMES = cv::CAP_PROP_POS_FRAMES;
+#else
+static const int FRAME_COUNT = CV_CAP_PROP_FRAME_COUNT;
+static const int POS_FRAMES = CV_CAP_PROP_POS_FRAMES;
+#endif
+
+BatchTracking::BatchTracking(const BatchParameters& params) :
+        params(params),
+        nextId(1)
+{
+}
+
+bool BatchTracking::track(const string& video, vector<vector<Face>>& faces)
+{
+    VideoCapture capture(video);
+    if (!capture.isOpened()) {
+        FT_LOG_ERROR("Unable to open " << video);
+        return false;
+    }
+    unsigned long nbFrames = frameCount(capture);
+    unsigned long chunkFrames = max(params.chunkFrames, 1u);
+
+    vector<ChunkResult> chunks;
+    if (nbFrames == 0) {
+        FT_LOG_WARN("Unknown number of frames in " << video << ": tracking it as one chunk");
+        chunks.resize(1);
+        chunks[0].end = numeric_limits<unsigned long>::max();
+    }
+    else {
+        for (unsigned long begin = 0; begin < nbFrames; begin += chunkFrames) {
+            ChunkResult chunk;
+            chunk.first = begin > params.overlapFrames ? begin - params.overlapFrames : 0;
+            chunk.begin = begin;
+            chunk.end = min(begin + chunkFrames, nbFrames);
+            chunks.push_back(chunk);
+        }
+        // the count may only be an estimate (from the duration and the frame
+        // rate): the last chunk reads up to the end of the video, however far
+        chunks.back().end = numeric_limits<unsigned long>::max();
+    }
+
+    // if seeking does not get any closer to the second chunk, each chunk
+    // would decode the video from the start: better read it once
+    if (chunks.size() > 1 && seek(capture, chunks[1].first) <= 0) {
+        FT_LOG_WARN("Can not seek in " << video << ": tracking it as one chunk");
+        chunks.resize(1);
+        chunks[0].end = numeric_limits<unsigned long>::max();
+    }
+    capture.release();
+
+    unsigned int threads = params.threads ? params.threads
+                                          : max(1u, thread::hardware_concurrency());
+    threads = min(threads, (unsigned int) chunks.size());
+
+    auto start = chrono::steady_clock::now();
+
+    // each worker takes the next chunk to track, until there is none left
+    atomic<size_t> nextChunk(0);
+    atomic<bool> complete(true);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++) {
+                if (!trackChunk(video, chunks[c])) complete = false;
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    if (!complete) FT_LOG_WARN("Some frames of " << video << " could not be read");
+
+    size_t continued = stitch(chunks, faces);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    FT_LOG_INFO("Tracked " << faces.size() << " frames of " << video << " in " << seconds << "s ("
+             << faces.size() / seconds << " fps): " << chunks.size() << " chunk(s) on "
+             << threads << " thread(s), " << continued << " track(s) stitched across chunks");
+    return true;
+}
+
+bool BatchTracking::trackChunk(const string& video, ChunkResult& chunk) const
+{
+    chunk.faces.clear();
+
+    // each chunk reads the file on its own
+    VideoCapture capture(video);
+    long position = capture.isOpened() ? seek(capture, chunk.first) : 0;
+    if (position < 0 || position > (long) chunk.first) {
+        FT_LOG_DEBUG("Lost in " << video << " seeking frame " << chunk.first << ": reading it from the start");
+        capture.release();
+        capture.open(video);
+        position = 0;
+    }
+    // the seek may land on the previous keyframe: skip up to the chunk
+    for (; position < (long) chunk.first; position++) {
+        if (!capture.grab()) break;
+    }
+
+    // the detector runs on the first frame, as on any new FaceTracking
+    FaceTracking tracking(params.tracking);
+
+    Mat frame, gray;
+    for (unsigned long f = chunk.first; f < chunk.end; f++) {
+        if (!capture.read(frame) || frame.empty()) break;
+
+        if (frame.channels() == 1) gray = frame;
+        else cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+
+        chunk.faces.push_back(tracking.track(gray));
+    }
+
+    // the end of the video (when the number of frames was unknown)
+    if (chunk.end == numeric_limits<unsigned long>::max()) {
+        chunk.end = chunk.first + chunk.faces.size();
+        return true;
+    }
+    return chunk.first + chunk.faces.size() == chunk.end;
+}
+
+unsigned long BatchTracking::frameCount(VideoCapture& capture) const
+{
+    double reported = capture.get(FRAME_COUNT);
+    return reported > 0 ? (unsigned long) reported : 0;
+}
+
+long BatchTracking::seek(VideoCapture& capture, unsigned long frame) const
+{
+    if (frame == 0) return 0;
+
+    capture.set(POS_FRAMES, (double) frame);
+
+    // where the next read() will be, as far as the backend knows
+    double position = capture.get(POS_FRAMES);
+    if (position < 0 || position != floor(position)) return -1;
+    return (long) position;
+}
+
+size_t BatchTracking::stitch(const vector<ChunkResult>& chunks,
+                             vector<vector<Face>>& faces)
+{
+    faces.clear();
+    nextId = 1;
+    size_t continued = 0;
+
+    // local id -> global id, for the previous and the current chunk
+    map<unsigned int, unsigned int> previousIds, ids;
+    // local provisional name -> global id
+    map<string, unsigned int> names;
+    // global id -> name: continued tracks keep their name
+    map<unsigned int, string> humanNames;
+
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const ChunkResult& chunk = chunks[c];
+
+        ids.clear();
+        if (c > 0) {
+            matchTracks(chunks[c - 1], previousIds, chunk, ids);
+            continued += ids.size();
+        }
+
+        // new global ids, in order of appearance
+        names.clear();
+        for (const auto& frame : chunk.faces) {
+            for (const auto& face : frame) {
+                if (!ids.count(face.id())) ids[face.id()] = nextId++;
+                names[provisionalName(face.id())] = ids[face.id()];
+            }
+        }
+
+        // up to the last frame read: a chunk cut short by the end of the
+        // video (whose length was overestimated) does not add empty frames.
+        // Frames that could not be read before a later chunk stay empty.
+        unsigned long end = min(chunk.end, chunk.first + (unsigned long) chunk.faces.size());
+        faces.resize(max((unsigned long) faces.size(), end));
+        for (unsigned long f = chunk.begin; f < end; f++) {
+
+            vector<Face>& output = faces[f];
+            output.clear();
+            for (const auto& face : chunk.faces[f - chunk.first]) {
+                unsigned int id = ids[face.id()];
+
+                // the human is either this track (its provisional name), or
+                // the one it was recognized as
+                string name = face.name();
+                auto human = names.find(face.name());
+                if (human != names.end()) {
+                    auto known = humanNames.find(human->second);
+                    name = known != humanNames.end() ? known->second : provisionalName(human->second);
+                }
+                humanNames[id] = name;
+
+                output.push_back(Face(id, name, face.boundingbox(), face.pose()));
+            }
+        }
+
+        swap(previousIds, ids);
+    }
+
+    return continued;
+}
+
+void BatchTracking::matchTracks(const ChunkResult& previous,
+                                const map<unsigned int, unsigned int>& previousIds,
+                                const ChunkResult& chunk, map<unsigned int, unsigned int>& ids)
+{
+    // (previous track, track) -> nb of overlap frames where they match
+    map<pair<unsigned int, unsigned int>, unsigned int> votes;
+    // track -> nb of overlap frames where it is reported
+    map<unsigned int, unsigned int> reported;
+
+    for (unsigned long f = chunk.first; f < chunk.begin; f++) {
+        if (f < previous.first || f - previous.first >= previous.faces.size()
+            || f - chunk.first >= chunk.faces.size()) continue;
+
+        const auto& before = previous.faces[f - previous.first];
+        const auto& after = chunk.faces[f - chunk.first];
+
+        previousBoxes.clear();
+        for (const auto& face : before) previousBoxes.push_back(face.boundingbox());
+        boxes.clear();
+        for (const auto& face : after) boxes.push_back(face.boundingbox());
+
+        const auto& assignment = associator.associate(previousBoxes, boxes);
+
+        for (size_t i = 0; i < after.size(); i++) {
+            reported[after[i].id()]++;
+            if (assignment[i] >= 0
+                && Associator::iou(previousBoxes[assignment[i]], boxes[i]) >= STITCH_MIN_IOU) {
+                votes[make_pair(before[assignment[i]].id(), after[i].id())]++;
+            }
+        }
+    }
+
+    // the pairs that agree the most first, each track continuing at most one
+    // previous track
+    vector<tuple<unsigned int, unsigned int, unsigned int>> pairs;
+    for (const auto& vote : votes) {
+        pairs.push_back(make_tuple(vote.second, vote.first.first, vote.first.second));
+    }
+    sort(pairs.begin(), pairs.end(), greater<tuple<unsigned int, unsigned int, unsigned int>>());
+
+    map<unsigned int, bool> continuedTracks;
+    for (const auto& candidate : pairs) {
+        unsigned int count, before, after;
+        tie(count, before, after) = candidate;
+
+        if (count < STITCH_MIN_AGREEMENT * reported[after]) continue;
+        if (ids.count(after) || continuedTracks[before]) continue;
+
+        auto global = previousIds.find(before);
+        if (global == previousIds.end()) continue;
+
+        ids[after] = global->second;
+        continuedTracks[before] = true;
+    }
+}
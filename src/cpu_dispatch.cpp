@@ -0,0 +1,26 @@
+#include "cpu_dispatch.h"
+
+using namespace std;
+
+string instructionSetName(InstructionSet set)
+{
+    switch (set) {
+    case SCALAR: return "scalar";
+    case SSE2: return "sse2";
+    case AVX2: return "avx2";
+    }
+    return "";
+}
+
+InstructionSet bestInstructionSet()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+    // SSE2 is always available on x86-64. The kernels compile AVX2 for the
+    // functions that need it only.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return AVX2;
+    return SSE2;
+#else
+    return SCALAR;
+#endif
+}
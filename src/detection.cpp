@@ -1,95 +1,136 @@
 #include <iostream>
 #include <tuple>
+#include <algorithm>
 
 #include <opencv2/imgproc/imgproc.hpp>
-#include <opencv2/video/video.hpp>
 
 #include "detection.h"
 #include "face_constants.h"
-
-#ifdef DEBUG
-#include <iostream>
-#include <opencv2/highgui/highgui.hpp>
-#endif
+#include "tracing.h"
 
 using namespace cv;
 using namespace std;
 
-static const string face_classifier("haarcascade_frontalface_default.xml");
-static const string eye_classifier("haarcascade_eye.xml");
-
-FaceDetector::FaceDetector() :
-        frontalface(CascadeClassifier(INSTALL_PREFIX + ("/share/facetracking/" + face_classifier))),
-        eyes(CascadeClassifier(INSTALL_PREFIX + ("/share/facetracking/" + eye_classifier)))
+FaceDetector::FaceDetector(DetectorType type, CascadeEngine engine) :
+        backend(DetectorBackend::create(type, engine))
 {
 
-    if (frontalface.empty()) {
-        cerr << "Could not load classifier model <" << face_classifier << ">!" << endl;
+    if (!backend) {
         //TODO: bad in a library!!
         exit(-1);
     }
+}
 
-    if (eyes.empty()) {
-        cerr << "Could not load classifier model <" << eye_classifier << ">!" << endl;
-        //TODO: bad in a library!!
-        exit(-1);
-    }
+vector<tuple<Rect, Point, Point>> FaceDetector::detect(const Mat& image, int scaledWidth) {
+
+    TRACE_SPAN("FaceDetector::detect");
+
+    vector<tuple<Rect, Point, Point>> faces;
+
+    // Possibly shrink the image, to run much faster.
+    scan(image, Rect(Point(), image.size()), max(1.f, image.cols / (float)scaledWidth), 0, faces);
 
+    return faces;
 
-#ifdef DEBUG
-    namedWindow("detection-debug");
-#endif
 }
 
-vector<tuple<Rect, Point, Point>> FaceDetector::detect(const Mat& image, int scaledWidth) {
+vector<tuple<Rect, Point, Point>> FaceDetector::detect(const Mat& image, const ScaleWindow& window) {
+
+    TRACE_SPAN("FaceDetector::detect");
 
-    vector<Rect> rawfaces;
     vector<tuple<Rect, Point, Point>> faces;
 
-    Point leftEye, rightEye;
-    
-    // Possibly shrink the image, to run much faster.
-    Mat inputImg;
-    float scale = image.cols / (float)scaledWidth;
-    if (image.cols > scaledWidth) {
-        // Shrink the image while keeping the same aspect ratio.
-        int scaledHeight = cvRound(image.rows / scale);
-        resize(image, inputImg, Size(scaledWidth, scaledHeight));
-    }
-    else {
-        // Access the input image directly, since it is already small.
-        inputImg = image;
+    if (window.empty()) return faces;
+
+    scan(image, Rect(Point(), image.size()),
+         image.cols / (float)scaledWidth(image.cols, window), window.maxFace, faces);
+
+    return faces;
+}
+
+vector<tuple<Rect, Point, Point>> FaceDetector::detect(const Mat& image,
+                                                       const vector<DetectionRegion>& regions) {
+
+    TRACE_SPAN("FaceDetector::detect");
+
+    vector<tuple<Rect, Point, Point>> faces;
+
+    for (const auto& region : regions) {
+        if (region.window.empty()) continue;
+
+        scan(image, region.area,
+             image.cols / (float)scaledWidth(image.cols, region.window), region.window.maxFace, faces);
     }
+    return faces;
+}
+
+void FaceDetector::scan(const Mat& image, Rect region, float scale, int maxFace,
+                        vector<tuple<Rect, Point, Point>>& faces) {
 
+    vector<Rect> rawfaces;
+    Point leftEye, rightEye;
+
+    region &= Rect(Point(), image.size());
+    Size scaledSize(cvRound(region.width / scale), cvRound(region.height / scale));
+    if (scaledSize.width < MIN_FACE_SIZE || scaledSize.height < MIN_FACE_SIZE) return;
+
+    // Shrink the image while keeping the same aspect ratio. Always a copy:
+    // equalizeHist must not modify the image.
+    Mat inputImg;
+    resize(image(region), inputImg, scaledSize);
     equalizeHist( inputImg, inputImg );
 
+    // no need to go up to the scales of faces larger than that
+    Size maxSize;
+    if (maxFace > 0) {
+        int size = max(MIN_FACE_SIZE, cvCeil(maxFace / scale));
+        maxSize = Size(size, size);
+    }
+
     //-- Detect faces
-    frontalface.detectMultiScale( inputImg, rawfaces, 1.1, 2, 0, Size(30, 30) );
+    backend->detectFaces( inputImg, rawfaces, Size(MIN_FACE_SIZE, MIN_FACE_SIZE), maxSize );
 
+    for (const auto& raw : rawfaces) {
 
-    for (auto& face : rawfaces) {
+        Rect face(region.x + cvRound(raw.x * scale), region.y + cvRound(raw.y * scale),
+                  cvRound(raw.width * scale), cvRound(raw.height * scale));
+        face &= Rect(Point(), image.size());
 
-        face.width *= scale;
-        face.height *= scale;
-        face.x *= scale;
-        face.y *= scale;
+        // the regions may overlap: skip the faces found already
+        bool found = any_of(faces.begin(), faces.end(),
+                            [&face](const tuple<Rect, Point, Point>& f) {
+                                Rect other = get<0>(f);
+                                return (face & other).area() > min(face.area(), other.area()) / 2;});
+        if (found) continue;
 
         // only keep face if the eyes are detected as well
         if (detectBothEyes(image(face), leftEye, rightEye, true)) {
-                faces.push_back(make_tuple(face, 
-                                           leftEye + face.tl(), 
+                faces.push_back(make_tuple(face,
+                                           leftEye + face.tl(),
                                            rightEye + face.tl()));
         }
-
     }
-    return faces;
+}
+
+int FaceDetector::scaledWidth(int imageWidth, const ScaleWindow& window) {
+    if (window.minFace <= 0) return min(imageWidth, DETECTION_WIDTH);
+
+    // the smallest face must span MIN_FACE_SIZE pixels once downscaled. Never
+    // upscaled.
+    return max(1, min(imageWidth, cvRound(imageWidth * MIN_FACE_SIZE / (float)window.minFace)));
+}
 
+Size FaceDetector::minFaceSize(int imageWidth, const ScaleWindow& window) {
+    int size = cvCeil(MIN_FACE_SIZE * imageWidth / (float)scaledWidth(imageWidth, window));
+    return Size(size, size);
 }
 
 bool FaceDetector::detectBothEyes(const Mat &face, 
                                   Point &leftEye, Point &rightEye, 
                                   bool relaxed) const
 {
+    TRACE_SPAN("FaceDetector::detectBothEyes");
+
     // Skip the borders of the face, since it is usually just hair and ears, that we don't care about.
     
     // For default eye.xml or eyeglasses.xml: Finds both eyes in roughly 40% of detected faces, but does not detect closed eyes.
@@ -120,16 +161,8 @@ bool FaceDetector::detectBothEyes(const Mat &face,
     vector<Rect> leftEyeRects, rightEyeRects;
     Rect leftEyeRect, rightEyeRect;
 
-#ifdef DEBUG
-    Mat debugImage = face.clone();
-    rectangle(debugImage, Rect(leftX, topY, widthX, heightY), cv::Scalar(255,255,255), 3);
-    rectangle(debugImage, Rect(rightX, topY, widthX, heightY), cv::Scalar(255,255,255), 3);
-#endif
-
-
-    int flags = CASCADE_FIND_BIGGEST_OBJECT;
-    eyes.detectMultiScale( topLeftOfFace, leftEyeRects, 1.1, 2, flags, Size(30, 30) );
-    eyes.detectMultiScale( topRightOfFace, rightEyeRects, 1.1, 2, flags, Size(30, 30) );
+    backend->detectEye( topLeftOfFace, leftEyeRects, Size(30, 30) );
+    backend->detectEye( topRightOfFace, rightEyeRects, Size(30, 30) );
 
     if (   leftEyeRects.size() == 0
         || rightEyeRects.size() == 0) // Check if the eye was detected.
@@ -147,153 +180,49 @@ bool FaceDetector::detectBothEyes(const Mat &face,
     rightEyeRect.y += topY;  // Adjust the right-eye rectangle because the face border was removed.
     rightEye = Point(rightEyeRect.x + rightEyeRect.width/2, rightEyeRect.y + rightEyeRect.height/2);
 
-#ifdef DEBUG
-    line(debugImage, leftEye,leftEye, cv::Scalar(255,255,255), 3);
-    line(debugImage, rightEye,rightEye, cv::Scalar(255,255,255), 3);
-    namedWindow("eyes-debug");
-    imshow("eyes-debug", debugImage);
-#endif
-
     return true;
 }
 
 
-Point2f mean(const vector<Point2f>& vals)
-{
-    size_t nbvals = vals.size();
-
-    auto sum = vals[0];
-    for(uint i = 1 ; i < nbvals ; ++i) sum += vals[i];
-    return sum * (1.f/nbvals);
-}
-
-double variance(const vector<Point2f>& vals)
+void EyeTracker::reset(const OpticalFlow& flow, const Point2f& leftEye, const Point2f& rightEye)
 {
-    size_t nbvals = vals.size();
-
-    auto current_mean = mean(vals);
-
-    auto temp = norm(current_mean-vals[0])*norm(current_mean-vals[0]);
-    for(uint i = 1 ; i < vals.size() ; ++i)
-        temp += norm(current_mean-vals[i])*norm(current_mean-vals[i]);
-    return temp/nbvals;
+    eyes[0] = leftEye;
+    eyes[1] = rightEye;
+    eyesFrame = flow.frame();
+    seedDistance = norm(rightEye - leftEye);
+    tracking = seedDistance > 0.f;
 }
 
-
-FaceTracker::FaceTracker(const Mat& image,
-                         const vector<Point2f>& features): 
-                prevImg(image.clone()),
-                prevFeatures(features),
-                _centroid(mean(features)),
-                _variance(variance(features))
+bool EyeTracker::track(const OpticalFlow& flow, const Rect& face)
 {
-#ifdef DEBUG
-    cout << "Initial variance of the feature cluster: " << _variance << endl;
-#endif
-}
-
-vector<Point2f> FaceTracker::track(const Mat& nextImg) {
-
-    vector<Point2f> nextFeatures;
-    nextFeatures.reserve(NB_FEATURES);
-    vector<unsigned char> status;
-    vector<float> err;
-
-    calcOpticalFlowPyrLK(prevImg, nextImg, 
-                         prevFeatures, nextFeatures, 
-                         status, err, 
-                         Size(10,10), 3, 
-                         TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 20, 0.01));
-
-#ifdef DEBUG
-    cout << "Optical flow status: ";
-    for (auto s : status) cout << (int)s << " ";
-    cout << endl;
-#endif
-
+    if (!tracking) return false;
 
-    prevImg = nextImg.clone();
+    // the eyes were detected in this very frame
+    if (eyesFrame == flow.frame()) return true;
 
-    vector<Point2f> found;
-    found.reserve(NB_FEATURES);
-
-    for ( int i = 0 ; i < nextFeatures.size() ; i++ ) {
-        if (status[i] == 1) found.push_back(nextFeatures[i]);
-    }
-
-
-    if (!found.empty()) {
-
-        _centroid = mean(found);
-        // do not recompute the variance. Keep the original value computed when the face
-        // tracker is created or reset.
+    if (eyesFrame + 1 != flow.frame() || !flow.hasPrevious()) {
+        tracking = false;
+        return false;
     }
 
-    found = pruneFeatures(found);
-    prevFeatures = found;
-    return found;
+    flow.track(eyes, nextEyes, status, err, 2);
+    eyesFrame = flow.frame();
 
-}
-
-void FaceTracker::resetFeatures(const Mat& image, const Rect& face) {
-    prevImg = image.clone();
-    prevFeatures = features(image, face);
-    _centroid = mean(prevFeatures);
-    _variance = variance(prevFeatures);
-}
-
-vector<Point2f> FaceTracker::features(const Mat& image, const Rect& face) {
-
-    double quality = 0.1;
-    double min_distance = 15;
-
-    Mat mask = Mat(image.size(), CV_8U, Scalar(0)); // Start with an empty mask.
-    Point faceCenter = Point( face.x + face.width/2, 
-                              face.y + face.height * FACE_ELLIPSE_CY);
-    Size size = Size( cvRound(face.size().width * FACE_ELLIPSE_W), 
-                      cvRound(face.size().height * FACE_ELLIPSE_H) );
-    ellipse(mask, faceCenter, size, 0, 0, 360, Scalar(255), -1); // tickness=-1 -> filled
- 
-    vector<Point2f> features;
-    features.reserve(NB_FEATURES);
-
-    goodFeaturesToTrack(image, features, NB_FEATURES, quality, min_distance, mask);
-
-#ifdef DEBUG
-    Mat debugImage;
-    image.copyTo(debugImage, mask);
-    
-    cvtColor(debugImage, debugImage, cv::COLOR_GRAY2BGR);
-
-    rectangle( debugImage, face, cv::Scalar(0,0,255), 4 );
-
-
-    for ( auto p : features ) {
-        line( debugImage, p, p, cv::Scalar(10, 200, 100), 10 );
+    for (int i = 0; i < 2; i++) {
+        if (status[i] != 1 || err[i] > EYE_MAX_TRACKING_ERROR || !face.contains(nextEyes[i])) {
+            tracking = false;
+            return false;
+        }
     }
 
-    imshow("detection-debug", debugImage);
-#endif
-
-    return features;
-}
-
-/**
- * Only keep features 'close enough' to the feature cloud centroid.
- * 'close' is dependent on the initial variance of the cloud.
- */
-vector<Point2f> FaceTracker::pruneFeatures(const vector<Point2f>& features) {
-
-    //auto centroid = mean(features);
-    //auto variance = variance(features);
-
-    vector<Point2f> prunedFeatures;
-
-    for (auto p : features) {
-        if (pow(norm(p - _centroid),2) < 3 * _variance) prunedFeatures.push_back(p);
+    // the eyes drifted apart (or together): one of them slid on the face
+    float distance = norm(nextEyes[1] - nextEyes[0]);
+    if (abs(distance - seedDistance) > EYE_DISTANCE_TOLERANCE * seedDistance) {
+        tracking = false;
+        return false;
     }
 
-    return prunedFeatures;
-
-
+    eyes[0] = nextEyes[0];
+    eyes[1] = nextEyes[1];
+    return true;
 }
@@ -0,0 +1,83 @@
+#include <utility>
+
+#include "detector_backend.h"
+#include "logging.h"
+
+using namespace cv;
+using namespace std;
+
+static const string model_path(INSTALL_PREFIX "/share/facetracking/");
+
+static const string haar_face_classifier("haarcascade_frontalface_default.xml");
+static const string lbp_face_classifier("lbpcascade_frontalface.xml");
+static const string eye_classifier("haarcascade_eye.xml");
+
+// LBP cascades report more false positives: ask for more neighbours
+static const int HAAR_MIN_NEIGHBOURS = 2;
+static const int LBP_MIN_NEIGHBOURS = 3;
+
+bool detectorFromName(const string& name, DetectorType& type)
+{
+    if (name == "haar") type = HAAR;
+    else if (name == "lbp") type = LBP;
+    else return false;
+
+    return true;
+}
+
+string detectorName(DetectorType type)
+{
+    switch (type) {
+    case HAAR: return "haar";
+    case LBP: return "lbp";
+    }
+    return "";
+}
+
+unique_ptr<DetectorBackend> DetectorBackend::create(DetectorType type, CascadeEngine engine)
+{
+    const string& face_classifier = (type == LBP) ? lbp_face_classifier : haar_face_classifier;
+
+    unique_ptr<CascadeBackend> backend(new CascadeBackend(type,
+                                                          model_path + face_classifier,
+                                                          model_path + eye_classifier,
+                                                          engine));
+
+    if (backend->empty()) {
+        FT_LOG_ERROR("Could not load the models of the " << detectorName(type) << " detector <"
+                  << face_classifier << ", " << eye_classifier << ">!");
+        return nullptr;
+    }
+
+    return move(backend);
+}
+
+CascadeBackend::CascadeBackend(DetectorType type,
+                               const string& faceModel,
+                               const string& eyeModel,
+                               CascadeEngine engine) :
+        _type(type)
+{
+    if (engine == SIMD_CASCADES) {
+        simdFace.load(faceModel);
+        simdEyes.load(eyeModel);
+    }
+
+    // not supported by SimdCascade (or not requested)
+    if (simdFace.empty()) frontalface.load(faceModel);
+    if (simdEyes.empty()) eyes.load(eyeModel);
+}
+
+void CascadeBackend::detectFaces(const Mat& image, vector<Rect>& faces, Size minSize, Size maxSize)
+{
+    int minNeighbours = (_type == LBP) ? LBP_MIN_NEIGHBOURS : HAAR_MIN_NEIGHBOURS;
+
+    if (!simdFace.empty()) simdFace.detectMultiScale(image, faces, 1.1, minNeighbours, 0, minSize, maxSize);
+    else frontalface.detectMultiScale(image, faces, 1.1, minNeighbours, 0, minSize, maxSize);
+}
+
+void CascadeBackend::detectEye(const Mat& region, vector<Rect>& found, Size minSize)
+{
+    if (!simdEyes.empty()) simdEyes.detectMultiScale(region, found, 1.1, HAAR_MIN_NEIGHBOURS, CASCADE_FIND_BIGGEST_OBJECT, minSize);
+    else eyes.detectMultiScale(region, found, 1.1, HAAR_MIN_NEIGHBOURS, CASCADE_FIND_BIGGEST_OBJECT, minSize);
+}
@@ -0,0 +1,33 @@
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "face_tracker.h"
+#include "face_constants.h"
+#include "tracing.h"
+
+using namespace cv;
+using namespace std;
+
+size_t FaceTrackerBase::detectFeatures(const Mat& image, const Rect& face,
+                                       Point2f* features, size_t capacity)
+{
+    TRACE_SPAN("FaceTracker::detectFeatures");
+
+    double quality = 0.1;
+    double min_distance = 15;
+
+    Mat mask = Mat(image.size(), CV_8U, Scalar(0)); // Start with an empty mask.
+    Point faceCenter = Point( face.x + face.width/2,
+                              face.y + face.height * FACE_ELLIPSE_CY);
+    Size size = Size( cvRound(face.size().width * FACE_ELLIPSE_W),
+                      cvRound(face.size().height * FACE_ELLIPSE_H) );
+    ellipse(mask, faceCenter, size, 0, 0, 360, Scalar(255), -1); // tickness=-1 -> filled
+
+    vector<Point2f> corners;
+    corners.reserve(capacity);
+
+    goodFeaturesToTrack(image, corners, (int) capacity, quality, min_distance, mask);
+
+    size_t count = min(corners.size(), capacity);
+    copy(corners.begin(), corners.begin() + count, features);
+    return count;
+}
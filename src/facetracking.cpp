@@ -1,84 +1,345 @@
 #include <opencv2/core/core.hpp>
-#include <iostream>
-#include <sstream>
+#include <string>
 #include <vector>
 #include <tuple>
+#include <algorithm>
 
 #include "facetracking.h"
+#include "logging.h"
+#include "tracing.h"
 
 using namespace cv;
 using namespace std;
 
 
-FaceTracking::FaceTracking() : frameCount(0), faceRecognizer(facedetector) {}
+FaceTracking::FaceTracking(const TrackingParameters& params) :
+    params(params),
+    frameCount(0),
+    nextId(1),
+    trainingSamples(0),
+    _detectorRan(false),
+    facedetector(params.detector, params.cascadeEngine),
+    trackPool(params.trackPoolSize)
+{
+    humans.reserve(params.trackPoolSize);
+    faces.reserve(params.trackPoolSize);
+    publication.prepare([&params](TrackingSnapshot& snapshot) {
+                            snapshot.tracks.reserve(params.trackPoolSize);});
+}
 
-vector<Face> FaceTracking::track(const Mat inputImage, Mat debugImage)
+const vector<Face>& FaceTracking::track(const Mat inputImage)
 {
+    frameTime = chrono::steady_clock::now();
+
+    // the spans of this frame (and of the recognition requests it issues)
+    // are tagged with its number
+    TRACE_CONTEXT(frameCount, -1);
+    TRACE_SPAN("FaceTracking::track");
+
+    // the image pyramid of the frame, shared by all the trackers
+    opticalFlow.push(inputImage);
+    _detectorRan = false;
+
+    applyRecognitionResults();
+
+    if (params.motionGating) motionGate.update(inputImage);
+
     // Force detection every few second to be able to detect new users.
     if (frameCount % FRAMES_BETWEEN_DETECTION == 0) {
-        auto faces = facedetector.detect(inputImage);
 
-        for( const auto& face_details : faces )
+        trackBoxes.clear();
+        for (auto human : humans) trackBoxes.push_back(human->predictedBoundingBox());
+
+        vector<tuple<Rect, Point, Point>> detections;
+        if (params.motionGating) {
+            gatedRegions(motionGate, trackBoxes, inputImage.cols, params.faceSizes,
+                         detectionRegions);
+
+            // nothing moved, and nothing to track: no detection at all
+            if (!detectionRegions.empty()) {
+                _detectorRan = true;
+                detections = facedetector.detect(inputImage, detectionRegions);
+            }
+        }
+        else {
+            _detectorRan = true;
+            detections = facedetector.detect(inputImage, params.faceSizes);
+        }
+
+        detectedBoxes.clear();
+        for (const auto& face_details : detections) detectedBoxes.push_back(get<0>(face_details));
+
+        const auto& assignment = associator.associate(trackBoxes, detectedBoxes);
+
+        for (size_t i = 0; i < detections.size(); i++)
         {
             Rect face;
             Point lefteye, righteye;
 
             // yeah! tuple unpacking in C++11
-            tie(face, lefteye, righteye) = face_details;
-
-            bool alreadyTracked = false;
-            for(auto& human : humans) {
-                if (human.isMyself(face))
-                {
-                    human.estimatePose(inputImage.size(), 
-                                       lefteye, righteye);
-
-                    human.relocalizeFace(inputImage, face);
-                    alreadyTracked = true;
-                    break;
+            tie(face, lefteye, righteye) = detections[i];
+
+            if (assignment[i] >= 0) {
+                auto human = humans[assignment[i]];
+
+                human->eyesDetected(opticalFlow, lefteye, righteye);
+
+                // re-extracting the features is expensive: only do it if the
+                // track drifted away from the detection, or is about to fail.
+                if (!human->trackingIsHealthy()
+                    || Associator::iou(human->boundingBox(), face) < RELOCALIZATION_IOU) {
+                    human->relocalizeFace(opticalFlow, face);
                 }
+                continue;
             }
-            if (alreadyTracked) continue;
-
-            // if we come here, a new face has been detected
-            // first check if we recognize it.
-            // if not, create a new human
-            auto guess = faceRecognizer.whois(inputImage(face));
-            if (guess.second != 0.) {
-                cout << "I think this is " << guess.first << " (confidence: " << guess.second << ")" << endl;
-                for (auto& human : humans) {
-                    if (human.name() == guess.first)
-                    {
-                        human.relocalizeFace(inputImage, face);
-                        break;
-                    }
-                }
-            } else {
-                cout << "I do not recognize this face! Creating new human" << endl;
 
-                stringstream namestr;
-                namestr << "human" << humans.size() + 1;
-                humans.push_back(Human(namestr.str(), inputImage, face, faceRecognizer));
-            }
+            // if we come here, a new face has been detected.
+            // Start tracking it right away under a provisional name: the
+            // recognition worker will tell us later if we already know it.
+            auto human = trackPool.acquire();
+            human->reset(nextId, provisionalName(nextId), opticalFlow, face);
+            human->eyesDetected(opticalFlow, lefteye, righteye);
+            humans.push_back(human);
+            nextId++;
         }
 
     }
 
-    vector<Face> faces;
+    // eye tracks lost on the previous frames: look for the eyes where the
+    // faces are expected
+    for (auto human : humans) {
+        TRACE_CONTEXT(-1, human->id());
+        if (human->needsEyeDetection()) detectEyes(*human, inputImage);
+    }
+
+    // failing tracks: look for their faces around where they are expected,
+    // rather than waiting for the next full detection (no need if it just
+    // ran)
+    if (frameCount % FRAMES_BETWEEN_DETECTION != 0) {
+        unsigned int rescues = 0;
+        for (auto human : humans) {
+            if (rescues == params.rescueBudget) break;
+            if (human->needsRescue()) {
+                TRACE_CONTEXT(-1, human->id());
+                rescue(*human, inputImage);
+                rescues++;
+            }
+        }
+    }
+
+    // reused from one frame to the next
+    faces.clear();
+    trainingSamples = 0;
     // face tracking!
     for( auto human : humans) {
-        human.update(inputImage);
+        TRACE_CONTEXT(-1, human->id());
+        human->update(opticalFlow);
 
-        if (human.mode() != LOST) faces.push_back(Face(human));
+        switch (human->mode()) {
+        case TENTATIVE:
+            if (human->framesInMode() >= params.confirmationFrames) human->setMode(TRACKING);
+            break;
+        case LOST:
+            if (human->framesInMode() >= params.expiryFrames) human->setMode(EXPIRED);
+            break;
+        default:
+            break;
+        }
 
-        if (!debugImage.empty()) human.showFace(debugImage);
+        if (human->mode() == TRACKING) {
+            requestRecognition(*human, inputImage);
+            faces.push_back(Face(*human));
+        }
     }
 
+    evictExpiredTracks();
+
     frameCount++;
 
+    // if the readers hold all the snapshots, this one is skipped
+    TrackingSnapshot* published = publication.beginWrite();
+    if (published) {
+        snapshot(*published);
+        publication.publish();
+    }
+
     return faces;
 
 
 
 }
 
+void FaceTracking::gatedRegions(MotionGate& gate, const vector<Rect>& tracks,
+                                int imageWidth, const ScaleWindow& faceSizes,
+                                vector<DetectionRegion>& regions)
+{
+    regions.clear();
+
+    // wherever something moved, any face may be there...
+    for (const auto& region : gate.regions(FaceDetector::minFaceSize(imageWidth, faceSizes))) {
+        regions.push_back(DetectionRegion(region, faceSizes));
+    }
+
+    // ...while around the tracks (the faces may have moved a bit further),
+    // the faces are about as large as the tracked ones
+    for (const auto& track : tracks) {
+        Rect area(track.x - track.width / 4, track.y - track.height / 4,
+                  track.width + track.width / 2, track.height + track.height / 2);
+        regions.push_back(DetectionRegion(area,
+                ScaleWindow::around(track.width, TRACK_SCALE_MARGIN) & faceSizes));
+    }
+}
+
+void FaceTracking::snapshot(TrackingSnapshot& snapshot) const
+{
+    snapshot.frame = frameCount;
+    snapshot.timestamp = frameTime;
+    snapshot.detectorRan = _detectorRan;
+
+    // expired tracks were evicted at the end of track()
+    snapshot.tracks.resize(humans.size());
+    for (size_t i = 0; i < humans.size(); i++) humans[i]->snapshot(snapshot.tracks[i]);
+}
+
+void FaceTracking::evictExpiredTracks()
+{
+    auto expired = partition(humans.begin(), humans.end(),
+                             [](const Human* h) {return h->mode() != EXPIRED;});
+
+    for (auto human = expired; human != humans.end(); ++human) trackPool.release(*human);
+
+    humans.erase(expired, humans.end());
+}
+
+void FaceTracking::detectEyes(Human& human, const Mat& inputImage)
+{
+    Rect face = human.predictedBoundingBox() & Rect(Point(), inputImage.size());
+    Point lefteye, righteye;
+
+    if (face.area() == 0) return;
+
+    _detectorRan = true;
+    if (facedetector.detectBothEyes(inputImage(face), lefteye, righteye)) {
+        human.eyesDetected(opticalFlow, lefteye + face.tl(), righteye + face.tl());
+    }
+}
+
+void FaceTracking::rescue(Human& human, const Mat& inputImage)
+{
+    human.rescueAttempted();
+    _detectorRan = true;
+
+    Rect face = human.boundingBox();
+    detectionRegions.clear();
+    detectionRegions.push_back(DetectionRegion(human.searchWindow(),
+            ScaleWindow::around(face.width, TRACK_SCALE_MARGIN) & params.faceSizes));
+
+    auto detections = facedetector.detect(inputImage, detectionRegions);
+
+    // the face closest to where this one is expected...
+    Rect predicted = human.predictedBoundingBox();
+    auto best = min_element(detections.begin(), detections.end(),
+                            [&predicted](const tuple<Rect, Point, Point>& a,
+                                         const tuple<Rect, Point, Point>& b) {
+                                return Associator::cost(predicted, get<0>(a))
+                                       < Associator::cost(predicted, get<0>(b));});
+    if (best == detections.end()) return;
+
+    Point lefteye, righteye;
+    tie(face, lefteye, righteye) = *best;
+
+    // ...unless another track is already following it
+    for (auto other : humans) {
+        if (other != &human && other->mode() != LOST
+            && Associator::iou(other->boundingBox(), face) > RELOCALIZATION_IOU) return;
+    }
+
+    FT_LOG_DEBUG("Track " << human.name() << " rescued by a local search");
+    human.relocalizeFace(opticalFlow, face);
+    human.eyesDetected(opticalFlow, lefteye, righteye);
+}
+
+void FaceTracking::requestRecognition(Human& human, const Mat& inputImage)
+{
+    // the eyes were detected along with the face, or tracked since: the
+    // recognizer does not need to look for them again
+    Point2f eyes[2];
+    const Point2f* knownEyes = human.eyesInFace(eyes) ? eyes : nullptr;
+
+    if (human.identity() == PROVISIONAL) {
+        // if the queue is full, we simply try again on the next frame
+        if (recognition.identify(human.id(), inputImage(human.boundingBox()), knownEyes)) {
+            human.identificationRequested();
+        }
+    }
+    else if (human.needsTrainingSamples()
+             && trainingSamples < params.trainingBudget
+             && human.isUsefulTrainingSample(inputImage, frameCount)) {
+        if (recognition.learn(human.id(), inputImage(human.boundingBox()), human.name(),
+                              frameCount, knownEyes)) {
+            human.trainingSampleSubmitted();
+            trainingSamples++;
+        }
+    }
+}
+
+void FaceTracking::applyRecognitionResults()
+{
+    recognition.results(recognitionResults);
+
+    for (const auto& result : recognitionResults) {
+
+        auto human = find_if(humans.begin(), humans.end(),
+                             [&result](const Human* h) {return h->id() == result.trackId;});
+
+        // the track may have expired in the meantime
+        if (human == humans.end()) continue;
+
+        switch (result.kind) {
+
+        case RecognitionResult::IDENTIFIED:
+        {
+            // someone else currently tracked already goes by this name: do
+            // not trust the recognizer, and keep the provisional name.
+            bool nameTaken = any_of(humans.begin(), humans.end(),
+                                    [&result](const Human* h) {
+                                        return h->id() != result.trackId
+                                            && h->name() == result.name
+                                            && h->mode() != LOST;});
+            if (nameTaken) {
+                (*human)->unrecognized();
+                break;
+            }
+
+            FT_LOG_INFO("I think this is " << result.name << " (confidence: " << result.confidence << ")");
+            (*human)->recognizedAs(result.name);
+
+            // this track supersedes the former (lost) tracks of the same human
+            for (auto h : humans) {
+                if (h->id() != result.trackId && h->name() == result.name) h->setMode(EXPIRED);
+            }
+            break;
+        }
+
+        case RecognitionResult::UNKNOWN:
+            FT_LOG_INFO("I do not recognize " << (*human)->name() << "! Learning this new face.");
+            (*human)->unrecognized();
+            break;
+
+        case RecognitionResult::TRAINED:
+            (*human)->trainingDone();
+            break;
+
+        case RecognitionResult::SAMPLE_ACQUIRED:
+            (*human)->trainingSampleLearned(result.frame);
+            break;
+
+        case RecognitionResult::SAMPLE_REJECTED:
+            (*human)->trainingSampleRejected(result.frame);
+            break;
+        }
+    }
+
+    evictExpiredTracks();
+}
+
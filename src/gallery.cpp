@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "gallery.h"
+#include "quantization.h"
+
+using namespace std;
+
+// max nb of points in a leaf of the tree. They are scanned linearly.
+static const size_t LEAF_SIZE = 8;
+
+GalleryIndex::GalleryIndex(size_t dimension) :
+        dim(dimension),
+        simd(bestInstructionSet()),
+        indexed(0),
+        queryCodes(dimension),
+        seed(42)
+{
+}
+
+void GalleryIndex::clear(size_t dimension)
+{
+    dim = dimension;
+    codes.clear();
+    scales.clear();
+    norms.clear();
+    labels.clear();
+    nodes.clear();
+    order.clear();
+    indexed = 0;
+    queryCodes.resize(dim);
+}
+
+void GalleryIndex::setInstructionSet(InstructionSet set)
+{
+    simd = min(set, bestInstructionSet());
+}
+
+void GalleryIndex::add(const float* vector, int label)
+{
+    size_t index = labels.size();
+    codes.resize((index + 1) * dim);
+    int8_t* c = &codes[index * dim];
+
+    scales.push_back(quantize(vector, dim, c));
+    norms.push_back(dotProduct(c, c, dim, simd));
+    labels.push_back(label);
+    order.push_back(labels.size() - 1);
+}
+
+void GalleryIndex::refresh()
+{
+    size_t pending = labels.size() - indexed;
+    if (pending > LEAF_SIZE && pending * pending > labels.size()) rebuild();
+}
+
+void GalleryIndex::rebuild()
+{
+    nodes.clear();
+    indexed = labels.size();
+
+    if (indexed == 0) return;
+
+    nodes.reserve(2 * (indexed / LEAF_SIZE + 1));
+    build(0, indexed);
+}
+
+double GalleryIndex::distance(const Vector& a, const Vector& b) const
+{
+    // |a - b|^2 = |a|^2 + |b|^2 - 2 a.b, with exact integer norms and dot
+    // product: only the scaling is rounded
+    double sa = a.scale, sb = b.scale;
+    double sum = sa * sa * a.norm + sb * sb * b.norm
+               - 2. * sa * sb * dotProduct(a.codes, b.codes, dim, simd);
+    return sqrt(max(sum, 0.));
+}
+
+int GalleryIndex::build(size_t begin, size_t end)
+{
+    int idx = nodes.size();
+    nodes.push_back(Node{begin, end, 0, 0., -1, -1});
+
+    if (end - begin <= LEAF_SIZE) return idx;
+
+    // pick a (pseudo-random) vantage point, and move it in front
+    seed = seed * 1103515245 + 12345;
+    swap(order[begin], order[begin + (seed >> 8) % (end - begin)]);
+    size_t vantage = order[begin];
+    Vector vp = point(vantage);
+
+    distances.clear();
+    for (size_t i = begin + 1; i < end; i++) {
+        distances.push_back(make_pair(distance(point(order[i]), vp), order[i]));
+    }
+
+    // split the remaining points around the median distance
+    auto median = distances.begin() + distances.size() / 2;
+    nth_element(distances.begin(), median, distances.end());
+    double radius = median->first;
+
+    for (size_t i = 0; i < distances.size(); i++) {
+        order[begin + 1 + i] = distances[i].second;
+    }
+    size_t split = begin + 1 + distances.size() / 2;
+
+    int inside = build(begin + 1, split);
+    int outside = build(split, end);
+
+    // 'nodes' may have been reallocated by the recursive calls
+    nodes[idx].vantage = vantage;
+    nodes[idx].radius = radius;
+    nodes[idx].inside = inside;
+    nodes[idx].outside = outside;
+
+    return idx;
+}
+
+void GalleryIndex::search(int idx, const Vector& query,
+                          Candidate& best, size_t& checks, size_t maxChecks) const
+{
+    if (maxChecks > 0 && checks >= maxChecks) return;
+
+    const Node& node = nodes[idx];
+
+    if (node.inside < 0) { // leaf
+        for (size_t i = node.begin; i < node.end; i++) {
+            double d = distance(point(order[i]), query);
+            checks++;
+            if (d < best.distance) best = Candidate{labels[order[i]], d};
+        }
+        return;
+    }
+
+    double d = distance(point(node.vantage), query);
+    checks++;
+    if (d < best.distance) best = Candidate{labels[node.vantage], d};
+
+    // points inside are at most 'radius' away from the vantage point, points
+    // outside at least 'radius': by the triangle inequality, a subtree can be
+    // skipped if it can not hold anything closer than the current best.
+    if (d < node.radius) {
+        search(node.inside, query, best, checks, maxChecks);
+        if (d + best.distance >= node.radius)
+            search(node.outside, query, best, checks, maxChecks);
+    }
+    else {
+        search(node.outside, query, best, checks, maxChecks);
+        if (d - best.distance <= node.radius)
+            search(node.inside, query, best, checks, maxChecks);
+    }
+}
+
+bool GalleryIndex::nearest(const float* query, int& label, double& distance,
+                           size_t maxChecks)
+{
+    if (labels.empty()) return false;
+
+    float scale = quantize(query, dim, queryCodes.data());
+    Vector quantized{queryCodes.data(), scale, dotProduct(queryCodes.data(), queryCodes.data(), dim, simd)};
+
+    Candidate best{-1, numeric_limits<double>::max()};
+    size_t checks = 0;
+
+    if (!nodes.empty()) search(0, quantized, best, checks, maxChecks);
+
+    // the points not yet in the tree
+    for (size_t i = indexed; i < labels.size(); i++) {
+        double d = this->distance(point(i), quantized);
+        if (d < best.distance) best = Candidate{labels[i], d};
+    }
+
+    label = best.label;
+    distance = best.distance;
+    return true;
+}
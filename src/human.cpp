@@ -1,30 +1,58 @@
-#include <iostream>
+#include <algorithm>
 
 #include "human.h"
 
 #include "detection.h" // FEATURES_THRESHOLD
 #include "face_constants.h"
+#include "logging.h"
 
 using namespace std;
 using namespace cv;
 
-Human::Human(const string& name, 
-             const Mat inputImage, 
-             const Rect boundingbox,
-             Recognizer& faceRecognizer) :
-            _name(name),
-            boundingbox(boundingbox),
-            tracker(FaceTracker(inputImage,
-                                FaceTracker::features(inputImage, boundingbox))),
-            faceRecognizer(faceRecognizer)
+Human::Human() :
+            _id(0),
+            _identity(PROVISIONAL),
+            _mode(EXPIRED),
+            _framesInMode(0),
+            framesWithoutEyes(0),
+            framesSinceRescue(RESCUE_INTERVAL),
+            recognizerTrained(false)
 {
-    _mode = TRACKING;
+}
+
+Human::Human(unsigned int id,
+             const string& name, 
+             const OpticalFlow& flow,
+             const Rect boundingbox) :
+            Human()
+{
+    reset(id, name, flow, boundingbox);
+}
+
+void Human::reset(unsigned int id,
+                  const string& name,
+                  const OpticalFlow& flow,
+                  const Rect& boundingbox)
+{
+    _id = id;
+    _name = name;
+    _identity = PROVISIONAL;
     recognizerTrained = false;
-    
-    // explicit conversion from Point2f to Point
-    Point centroid = tracker.centroid();
-    trackerOffset = boundingbox.tl() - centroid;
+    trainingSamples.clear();
+    _pose = Matx44d();
+    velocity = Point2f();
+    eyeTracker.clear();
+    framesWithoutEyes = 0;
+    framesSinceRescue = RESCUE_INTERVAL;
+
+    relocalizeFace(flow, boundingbox);
+    setMode(TENTATIVE);
+}
 
+void Human::setMode(Mode mode)
+{
+    _mode = mode;
+    _framesInMode = 0;
 }
 
 bool Human::isMyself(const Rect face) const
@@ -32,18 +60,38 @@ bool Human::isMyself(const Rect face) const
     return (face & boundingbox).area() != 0;
 }
 
-void Human::relocalizeFace(const Mat& image, const Rect face)
+Rect Human::predictedBoundingBox() const
+{
+    // a lost face may be anywhere: keep its last known position
+    if (_mode == LOST) return boundingbox;
+
+    return Rect(boundingbox.tl() + Point(velocity), boundingbox.size());
+}
+
+bool Human::trackingIsHealthy() const
+{
+    return _mode == TRACKING
+           && tracker.size() >= (NB_FEATURES + FEATURES_THRESHOLD) / 2;
+}
+
+void Human::relocalizeFace(const OpticalFlow& flow, const Rect face)
 {
     boundingbox = face;
 
-    tracker.resetFeatures(image, face);
+    tracker.resetFeatures(flow, face);
 
-    // explicit conversion from Point2f to Point
-    Point centroid = tracker.centroid();
+    trackerOffset = Point2f(face.tl()) - tracker.centroid();
+    faceSize = face.size();
 
-    trackerOffset = face.tl() - centroid;
+    setMode(TRACKING);
+}
 
-    _mode = TRACKING;
+void Human::recognizedAs(const string& name)
+{
+    _name = name;
+    _identity = CONFIRMED;
+    // we only recognize faces the recognizer has been trained on
+    recognizerTrained = true;
 }
 
 void Human::estimatePose(const Size& image_size,
@@ -77,69 +125,108 @@ void Human::estimatePose(const Size& image_size,
 
 }
 
-void Human::update(const Mat inputImage)
+void Human::eyesDetected(const OpticalFlow& flow,
+                         const Point2f& leftEye, const Point2f& rightEye)
 {
-    if (_mode == LOST) return;
+    estimatePose(flow.image().size(), leftEye, rightEye);
+    eyeTracker.reset(flow, leftEye, rightEye);
+    framesWithoutEyes = 0;
+}
 
-    features = tracker.track(inputImage);
+bool Human::eyesInFace(Point2f eyes[2]) const
+{
+    if (_mode != TRACKING || !eyeTracker.isTracking()) return false;
+
+    Rect_<float> face(0.f, 0.f, boundingbox.width, boundingbox.height);
+    eyes[0] = eyeTracker.leftEye() - Point2f(boundingbox.tl());
+    eyes[1] = eyeTracker.rightEye() - Point2f(boundingbox.tl());
+    return face.contains(eyes[0]) && face.contains(eyes[1]);
+}
 
-    if (features.size() < FEATURES_THRESHOLD) {
-#ifdef DEBUG
-        cout << "Not enough features! Going back to detection" << endl;
-#endif
-        _mode = LOST;
+bool Human::needsEyeDetection() const
+{
+    // right after the eyes are lost, then every EYE_DETECTION_INTERVAL frames
+    return _mode == TRACKING
+           && !eyeTracker.isTracking()
+           && framesWithoutEyes % EYE_DETECTION_INTERVAL == 1;
+}
+
+bool Human::needsRescue() const
+{
+    if (framesSinceRescue < RESCUE_INTERVAL) return false;
+
+    return (_mode == TRACKING && !trackingIsHealthy())
+           || (_mode == LOST && _framesInMode < RESCUE_FRAMES);
+}
+
+Rect Human::searchWindow() const
+{
+    Rect window = boundingbox | predictedBoundingBox();
+    int dx = cvRound(boundingbox.width * RESCUE_MARGIN);
+    int dy = cvRound(boundingbox.height * RESCUE_MARGIN);
+    return Rect(window.x - dx, window.y - dy, window.width + 2 * dx, window.height + 2 * dy);
+}
+
+void Human::update(const OpticalFlow& flow)
+{
+    const Mat& inputImage = flow.image();
+
+    _framesInMode++;
+    framesSinceRescue++;
+
+    if (_mode == LOST || _mode == EXPIRED) return;
+
+    // no need to track the eyes from the previous frame if they were
+    // detected in this one: the tracker knows
+    if (eyeTracker.isTracking() && eyeTracker.track(flow, boundingbox)) {
+        estimatePose(inputImage.size(), eyeTracker.leftEye(), eyeTracker.rightEye());
+    }
+
+    if (!eyeTracker.isTracking()) framesWithoutEyes++;
+
+    if (tracker.track(flow) < FEATURES_THRESHOLD) {
+        FT_LOG_DEBUG("Not enough features! Going back to detection");
+        // a tentative track that can not even be tracked was likely a false
+        // detection: no need to keep it around
+        setMode(_mode == TENTATIVE ? EXPIRED : LOST);
+        eyeTracker.clear();
         return;
     }
     
-    Point centroid = tracker.centroid();
-    boundingbox = Rect(centroid + trackerOffset, boundingbox.size());
+    // the features spread out as the face comes closer: so do the box
+    // and its offset to them
+    float scale = tracker.scale();
+    Point previous = boundingbox.tl();
+    boundingbox = Rect(Point(tracker.centroid() + trackerOffset * scale),
+                       Size(cvRound(faceSize.width * scale), cvRound(faceSize.height * scale)));
+    velocity = 0.7f * velocity + 0.3f * Point2f(boundingbox.tl() - previous);
     boundingbox.x = max(0, boundingbox.x);
     boundingbox.y = max(0, boundingbox.y);
     boundingbox.width = min(inputImage.cols - boundingbox.x, boundingbox.width);
     boundingbox.height = min(inputImage.rows - boundingbox.y, boundingbox.height);
 
 
-#ifdef DEBUG
-    cout << "Tracking " << features.size() << " features" << endl;
-#endif
-
-    if (!recognizerTrained)
-    {
-        recognizerTrained = faceRecognizer.addPictureOf(inputImage(boundingbox), _name);
- 
-#ifdef DEBUG
-        if (recognizerTrained) {
-            cout << "Model trained for " << _name << ". I can now recognize him!" << endl;
-        }
-#endif
-   }
+    FT_LOG_DEBUG("Tracking " << tracker.size() << " features");
 }
 
-void Human::showFace(Mat& outputImage) {
-
-    if (_mode != LOST) {
+void Human::snapshot(TrackSnapshot& track) const {
 
-        auto centroid = tracker.centroid();
-        line( outputImage, centroid, centroid, cv::Scalar(10, 100, 200), 20 );
+    track.id = _id;
+    track.name.assign(_name); // reuses the capacity of the string
+    track.mode = _mode;
+    track.identity = _identity;
+    track.boundingbox = boundingbox;
+    track.pose = _pose;
 
-        for ( auto p : features ) {
-            line( outputImage, p, p, cv::Scalar(10, 200, 100), 10 );
-        }
+    track.centroid = tracker.centroid();
+    track.nbFeatures = min(tracker.size(), (size_t) NB_FEATURES);
+    copy(tracker.begin(), tracker.begin() + track.nbFeatures, track.features);
 
-        putText(outputImage,
-                _name,
-                centroid + Point2f(10,10),
-                FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(10,100,200));
+    track.eyesTracked = eyeTracker.isTracking();
+    if (track.eyesTracked) {
+        track.leftEye = eyeTracker.leftEye();
+        track.rightEye = eyeTracker.rightEye();
     }
-    else //LOST!
-    {
-        putText(outputImage,
-                _name + " LOST!",
-                boundingbox.tl() + Point(20,20),
-                FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(200,100,10));
-    }
-
-    rectangle( outputImage, boundingbox, cv::Scalar(255,0,255), 4 );
 }
 
 
@@ -0,0 +1,169 @@
+#include <cstring>
+#include <thread>
+
+#include "log4cxx/logger.h"
+
+#include "logging.h"
+
+using namespace std;
+using namespace log4cxx;
+
+namespace {
+
+struct LogRecord {
+    LogLevel level;
+    const char* file;
+    int line;
+    unsigned int suppressed;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+/** Bounded multi-producer, single-consumer ring buffer of log records
+ * (D. Vyukov's algorithm): each cell carries a sequence number telling
+ * whether it is free for the producer at that position, or ready for the
+ * consumer. Producers never block: they drop the record if the ring is full.
+ *
+ * The consumer is a background thread, that forwards the records to log4cxx.
+ */
+class LogSink {
+
+public:
+    LogSink() : enqueuePos(0), dequeuePos(0), consumed(0), dropped(0), running(true) {
+        static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0,
+                      "LOG_RING_SIZE must be a power of 2");
+        for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+        // get the logger before starting the thread: log4cxx is then
+        // initialized before the sink, and destroyed after it
+        logger = Logger::getLogger("facetracking");
+        worker = thread(&LogSink::run, this);
+    }
+
+    ~LogSink() {
+        running.store(false, memory_order_release);
+        worker.join();
+    }
+
+    void push(LogLevel level, const char* file, int line,
+              unsigned int suppressed, const char* text) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & (LOG_RING_SIZE - 1)];
+            size_t sequence = cell->sequence.load(memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                // full
+                dropped.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            else pos = enqueuePos.load(memory_order_relaxed);
+        }
+
+        cell->record.level = level;
+        cell->record.file = file;
+        cell->record.line = line;
+        cell->record.suppressed = suppressed;
+        strcpy(cell->record.text, text);
+        cell->sequence.store(pos + 1, memory_order_release);
+    }
+
+    void flush() {
+        size_t target = enqueuePos.load(memory_order_acquire);
+        while (consumed.load(memory_order_acquire) < target) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    size_t droppedRecords() const {return dropped.load(memory_order_relaxed);}
+
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    bool pop() {
+        Cell& cell = cells[dequeuePos & (LOG_RING_SIZE - 1)];
+        if (cell.sequence.load(memory_order_acquire) != dequeuePos + 1) return false;
+
+        write(cell.record);
+
+        cell.sequence.store(dequeuePos + LOG_RING_SIZE, memory_order_release);
+        dequeuePos++;
+        consumed.store(dequeuePos, memory_order_release);
+        return true;
+    }
+
+    void write(const LogRecord& record) {
+        LevelPtr level;
+        switch (record.level) {
+            case LOG_DEBUG_LEVEL: level = Level::getDebug(); break;
+            case LOG_INFO_LEVEL: level = Level::getInfo(); break;
+            case LOG_WARN_LEVEL: level = Level::getWarn(); break;
+            default: level = Level::getError(); break;
+        }
+        if (!logger->isEnabledFor(level)) return;
+
+        string message(record.text);
+        if (record.suppressed > 0) {
+            message += " (" + to_string(record.suppressed) + " similar message(s) suppressed)";
+        }
+        logger->forcedLog(level, message, spi::LocationInfo(record.file, "", record.line));
+    }
+
+    void run() {
+        while (true) {
+            bool stopping = !running.load(memory_order_acquire);
+            bool any = false;
+            while (pop()) any = true;
+            if (stopping) return;
+            if (!any) this_thread::sleep_for(chrono::milliseconds(5));
+        }
+    }
+
+    Cell cells[LOG_RING_SIZE];
+    atomic<size_t> enqueuePos;
+    // only used by the consumer
+    size_t dequeuePos;
+    atomic<size_t> consumed;
+    atomic<size_t> dropped;
+
+    atomic<bool> running;
+    LoggerPtr logger;
+    thread worker;
+};
+
+LogSink& sink()
+{
+    static LogSink logSink;
+    return logSink;
+}
+
+} // namespace
+
+LogMessage::LogMessage(LogLevel level, const char* file, int line, unsigned int suppressed) :
+    level(level),
+    file(file),
+    line(line),
+    suppressed(suppressed),
+    _stream(this)
+{
+    // keep the last char for the terminating 0. Longer messages are
+    // truncated: overflow() fails.
+    setp(text, text + LOG_MESSAGE_SIZE - 1);
+}
+
+LogMessage::~LogMessage()
+{
+    *pptr() = '\0';
+    sink().push(level, file, line, suppressed, text);
+}
+
+void flushLogs() {sink().flush();}
+
+size_t droppedLogs() {return sink().droppedRecords();}
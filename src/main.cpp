@@ -1,9 +1,10 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/core/core.hpp>
-#ifdef OPENCV3
-#include <opencv2/core/utility.hpp> // getTickCount
-#endif
+#include <cstdlib> // getenv
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <algorithm>
 
 // include log4cxx header files.
 #include "log4cxx/logger.h"
@@ -11,6 +12,11 @@
 
 
 #include "facetracking.h"
+#include "overlay.h"
+#include "shm_publisher.h"
+#include "track_log_writer.h"
+#include "pipeline.h"
+#include "tracing.h"
 
 using namespace cv;
 using namespace std;
@@ -18,6 +24,18 @@ using namespace log4cxx;
 
 LoggerPtr logger(Logger::getLogger("facetracking"));
 
+// the pipeline stats are printed every so many frames
+static const unsigned long STATS_INTERVAL = 30;
+
+/** What goes through the pipeline: a camera frame, and what was found in it.
+ */
+struct Frame {
+    Mat camera;
+    Mat gray;
+    vector<Face> faces;
+    TrackingSnapshot snapshot;
+};
+
 int main(int argc, char *argv[])
 {
 
@@ -32,6 +50,31 @@ int main(int argc, char *argv[])
         cameraIndex = atoi(argv[1]);
     }
 
+    // Face detector: 'haar' (default) or 'lbp' (faster)
+    TrackingParameters params;
+    if (argc > 2 && !detectorFromName(argv[2], params.detector)) {
+        LOG4CXX_ERROR(logger, "Unknown face detector <" << argv[2] << ">. Use 'haar' or 'lbp'.");
+        return 1;
+    }
+
+    // 'simd' to use our vectorized cascade evaluator
+    if (argc > 3 && string(argv[3]) == "simd") params.cascadeEngine = SIMD_CASCADES;
+
+    // 'motion' to only run the face detector where the image changes (static
+    // cameras)
+    if (argc > 4 && string(argv[4]) == "motion") params.motionGating = true;
+
+    // 'shm' to publish the faces in shared memory, for other local processes
+    // (see shm_ring.h)
+    unique_ptr<ShmPublisher> publisher;
+    if (argc > 5 && string(argv[5]) == "shm") publisher.reset(new ShmPublisher());
+
+    // FACETRACKING_TRACK_LOG=<file> to log the tracks in a binary file, for
+    // offline analysis (see track_log.h, and the tracklog tool)
+    unique_ptr<TrackLogWriter> trackLog;
+    const char* trackLogPath = getenv("FACETRACKING_TRACK_LOG");
+    if (trackLogPath) trackLog.reset(new TrackLogWriter(trackLogPath));
+
     // The source of input images
     cv::VideoCapture videoCapture(cameraIndex);
     if (!videoCapture.isOpened())
@@ -48,41 +91,101 @@ int main(int argc, char *argv[])
     videoCapture.set(CV_CAP_PROP_FRAME_HEIGHT, 480);
 #endif
 
-    namedWindow("faces"); 
-
-    FaceTracking facetracking;
-
-    Mat cameraImage, inputImage;
+    // how the tracker keeps up with the camera: 'keep-latest' (default: only
+    // the most recent frame is tracked), 'drop-oldest' or 'block'
+    QueuePolicy trackingPolicy = KEEP_LATEST;
+    if (argc > 6 && !queuePolicyFromName(argv[6], trackingPolicy)) {
+        LOG4CXX_ERROR(logger, "Unknown queue policy <" << argv[6] << ">. Use 'keep-latest', 'drop-oldest' or 'block'.");
+        return 1;
+    }
 
+    // 'pin' to pin each stage of the pipeline to its own core
+    bool pin = argc > 7 && string(argv[7]) == "pin";
+    unsigned int cores = max(1u, thread::hardware_concurrency());
+
+    FaceTracking facetracking(params);
+
+    // draws the results in the "faces" window, from its own thread
+    OverlayRenderer renderer("faces");
+
+    // Capture, preprocessing, tracking and publication run concurrently, each
+    // on its own thread: the camera keeps capturing while the previous frames
+    // are tracked. (The recognition already runs on the background thread of
+    // the tracker.)
+    Pipeline<Frame> pipeline;
+    StageOptions options;
+
+    pipeline.addSource("capture", [&videoCapture, &renderer](Frame& frame) {
+        // exiting when 'q' is pressed
+        if ('q' == (char) renderer.lastKey()) return false;
+        return videoCapture.read(frame.camera);
+    }, pin ? 0 : -1);
+
+    options.cpu = pin ? 1 % cores : -1;
+    pipeline.addStage("preprocess", [](Frame& frame) {
+        cvtColor(frame.camera, frame.gray, cv::COLOR_BGR2GRAY);
+        return true;
+    }, options);
+
+    options.policy = trackingPolicy;
+    options.cpu = pin ? 2 % cores : -1;
+    pipeline.addStage("track", [&facetracking](Frame& frame) {
+        // copy-assignment reuses the buffers of the frame
+        frame.faces = facetracking.track(frame.gray);
+        facetracking.snapshot(frame.snapshot);
+        return true;
+    }, options);
+
+    options.policy = BLOCK;
+    options.cpu = pin ? 3 % cores : -1;
+    vector<StageStats> stats;
+    pipeline.addStage("publish", [&](Frame& frame) {
+
+        cout << frame.faces.size() << " face(s) detected." << endl;
+
+        for (auto& human : frame.faces) {
+            auto pose = human.pose();
+            cout << "Human " << human.name() << ": ";
+            cout << "x: " << pose(0,3);
+            cout << " y: " << pose(1,3);
+            cout << " z: " << pose(2,3) << endl;
+        }
 
-    // Main loop, exiting when 'q is pressed'
-    for (; 'q' != (char) cv::waitKey(1); ) {
+        if (publisher) publisher->publish(frame.faces);
 
-        // Capture a new image.
-        videoCapture.read(cameraImage);
-        auto debugImage = cameraImage.clone();
+        if (trackLog) trackLog->log(frame.snapshot);
 
-        cvtColor(cameraImage, inputImage, cv::COLOR_BGR2GRAY);
+        renderer.publish(frame.camera, frame.snapshot);
 
-        int64 tStartCount = getTickCount();
+        if (frame.snapshot.frame % STATS_INTERVAL == 0) {
+            pipeline.stats(stats);
+            for (const auto& stage : stats) {
+                cout << "Stage " << stage.name << ": " << stage.processed << " frame(s), "
+                     << stage.meanTime << "ms on average (max " << stage.maxTime << "ms)";
+                if (stage.input.capacity > 0) {
+                    cout << ", queue " << stage.input.depth << "/" << stage.input.capacity
+                         << " (" << stage.input.dropped << " frame(s) dropped)";
+                }
+                cout << endl;
+            }
 
-        auto humans = facetracking.track(inputImage, debugImage);
+            auto recognition = facetracking.recognitionStats();
+            cout << "Recognition queue: " << recognition.depth << "/" << recognition.capacity;
+            cout << " (" << recognition.dropped << " request(s) dropped so far)" << endl;
+        }
+        return true;
+    }, options);
 
-        cout << "Time to detect faces: " << ((double)getTickCount() - tStartCount)/getTickFrequency() * 1000. << "ms" << std::endl;
-        cout << humans.size() << " face(s) detected." << endl;
+    // FACETRACKING_TRACE=<file.json> to record a timeline of the library
+    // (see tracing.h)
+    const char* tracePath = getenv("FACETRACKING_TRACE");
+    if (tracePath) startTracing(tracePath);
 
-        for (auto& human : humans) {
-            auto pose = human.pose();
-            cout << "Human " << human.name() << ": ";
-            cout << "x: " << pose(0,3);
-            cout << " y: " << pose(1,3);
-            cout << " z: " << pose(2,3) << endl;
-        }
+    pipeline.start();
+    pipeline.wait();
 
-        imshow("faces", debugImage);
-    }
+    if (tracePath) stopTracing();
 
-    cv::destroyWindow("faces");
     videoCapture.release();
 
 }
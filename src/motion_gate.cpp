@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "motion_gate.h"
+
+using namespace cv;
+using namespace std;
+
+void MotionGate::update(const Mat& frame)
+{
+    if (!initialized || frame.size() != frameSize) {
+        frameSize = frame.size();
+        scale = frame.cols / (float) MOTION_WIDTH;
+        resize(frame, small, Size(MOTION_WIDTH, max(1, cvRound(frame.rows / scale))), 0, 0, INTER_AREA);
+        small.convertTo(background, CV_32F);
+
+        // nothing is known of the scene yet: everything changed
+        changed = Mat((small.rows + MOTION_BLOCK - 1) / MOTION_BLOCK,
+                      (small.cols + MOTION_BLOCK - 1) / MOTION_BLOCK,
+                      CV_8U, Scalar(1));
+        initialized = true;
+        return;
+    }
+
+    resize(frame, small, small.size(), 0, 0, INTER_AREA);
+    small.convertTo(difference, CV_32F);
+    absdiff(difference, background, difference);
+
+    for (int by = 0; by < changed.rows; by++) {
+        unsigned char* row = changed.ptr<unsigned char>(by);
+        for (int bx = 0; bx < changed.cols; bx++) {
+            Rect block = Rect(bx * MOTION_BLOCK, by * MOTION_BLOCK, MOTION_BLOCK, MOTION_BLOCK)
+                         & Rect(Point(), small.size());
+            if (mean(difference(block))[0] > MOTION_THRESHOLD) row[bx] = 1;
+        }
+    }
+
+    accumulateWeighted(small, background, MOTION_LEARNING_RATE);
+}
+
+const vector<Rect>& MotionGate::regions(Size minSize)
+{
+    _regions.clear();
+    if (!initialized) return _regions;
+
+    changed.copyTo(active);
+
+    // frame pixels per block
+    float blockSize = MOTION_BLOCK * scale;
+
+    // a face that moves only changes the blocks along its edges: grow the
+    // changed areas by one block
+    dilate(active, active, Mat());
+
+    // connected groups of blocks (8-connectivity), by flood fill. 'active'
+    // is cleared as the blocks are visited.
+    for (int by = 0; by < active.rows; by++) {
+        for (int bx = 0; bx < active.cols; bx++) {
+            if (!active.at<unsigned char>(by, bx)) continue;
+
+            int x0 = bx, y0 = by, x1 = bx, y1 = by;
+            active.at<unsigned char>(by, bx) = 0;
+            stack.clear();
+            stack.push_back(Point(bx, by));
+
+            while (!stack.empty()) {
+                Point p = stack.back();
+                stack.pop_back();
+                x0 = min(x0, p.x); x1 = max(x1, p.x);
+                y0 = min(y0, p.y); y1 = max(y1, p.y);
+
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        Point q(p.x + dx, p.y + dy);
+                        if (q.x < 0 || q.y < 0 || q.x >= active.cols || q.y >= active.rows) continue;
+                        if (!active.at<unsigned char>(q)) continue;
+                        active.at<unsigned char>(q) = 0;
+                        stack.push_back(q);
+                    }
+                }
+            }
+
+            Rect region(cvFloor(x0 * blockSize), cvFloor(y0 * blockSize),
+                        cvCeil((x1 - x0 + 1) * blockSize), cvCeil((y1 - y0 + 1) * blockSize));
+
+            // large enough for the detector to find a face in it
+            if (region.width < minSize.width) {
+                region.x -= (minSize.width - region.width) / 2;
+                region.width = minSize.width;
+            }
+            if (region.height < minSize.height) {
+                region.y -= (minSize.height - region.height) / 2;
+                region.height = minSize.height;
+            }
+
+            // shifted back inside the frame rather than cropped
+            region.x = max(0, min(region.x, frameSize.width - region.width));
+            region.y = max(0, min(region.y, frameSize.height - region.height));
+            region &= Rect(Point(), frameSize);
+            if (region.area() > 0) _regions.push_back(region);
+        }
+    }
+
+    changed.setTo(Scalar(0));
+    return _regions;
+}
@@ -0,0 +1,54 @@
+#include <cstdlib> // atoi
+#include <iostream>
+#include <vector>
+
+// include log4cxx header files.
+#include "log4cxx/logger.h"
+#include "log4cxx/basicconfigurator.h"
+
+#include "batch.h"
+
+using namespace std;
+using namespace log4cxx;
+
+LoggerPtr logger(Logger::getLogger("facetracking"));
+
+/** Tracks the faces of a recorded video, split in chunks tracked concurrently
+ * (see BatchTracking), and prints them as CSV, one line per face and frame.
+ */
+int main(int argc, char *argv[])
+{
+    BasicConfigurator::configure();
+
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <video> [haar|lbp] [threads] [chunk frames]" << endl;
+        return 1;
+    }
+
+    BatchParameters params;
+    if (argc > 2 && !detectorFromName(argv[2], params.tracking.detector)) {
+        LOG4CXX_ERROR(logger, "Unknown face detector <" << argv[2] << ">. Use 'haar' or 'lbp'.");
+        return 1;
+    }
+
+    // default: one chunk per core at a time
+    if (argc > 3) params.threads = atoi(argv[3]);
+    if (argc > 4) params.chunkFrames = atoi(argv[4]);
+
+    BatchTracking batch(params);
+    vector<vector<Face>> faces;
+    if (!batch.track(argv[1], faces)) return 1;
+
+    cout << "frame,id,name,x,y,width,height,pose_x,pose_y,pose_z" << endl;
+    for (size_t frame = 0; frame < faces.size(); frame++) {
+        for (const auto& face : faces[frame]) {
+            auto box = face.boundingbox();
+            auto pose = face.pose();
+            cout << frame << "," << face.id() << "," << face.name() << ","
+                 << box.x << "," << box.y << "," << box.width << "," << box.height << ","
+                 << pose(0,3) << "," << pose(1,3) << "," << pose(2,3) << endl;
+        }
+    }
+
+    return 0;
+}
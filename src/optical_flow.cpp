@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+#include "optical_flow.h"
+
+using namespace cv;
+using namespace std;
+
+// Reflection of out-of-range coordinates, like BORDER_REFLECT_101 (gfedcb|abcdefgh|gfedcba)
+static int reflect101(int p, int len)
+{
+    if (len == 1) return 0;
+    while (p < 0 || p >= len) p = p < 0 ? -p : 2 * len - 2 - p;
+    return p;
+}
+
+// Fills the 'border' pixels wide border around a (rows x cols) image, by reflection
+static void fillBorder(uchar* data, size_t step, int cols, int rows, int border)
+{
+    for (int y = 0; y < rows; y++) {
+        uchar* row = data + y * step;
+        for (int x = 1; x <= border; x++) {
+            row[-x] = row[reflect101(-x, cols)];
+            row[cols - 1 + x] = row[reflect101(cols - 1 + x, cols)];
+        }
+    }
+    for (int y = 1; y <= border; y++) {
+        memcpy(data - y * step - border, data + reflect101(-y, rows) * step - border, cols + 2 * border);
+        memcpy(data + (rows - 1 + y) * step - border,
+               data + reflect101(rows - 1 + y, rows) * step - border, cols + 2 * border);
+    }
+}
+
+// Gaussian 5x5 downsampling to ((cols+1)/2, (rows+1)/2), like cv::pyrDown.
+// 'buffer' holds 5 rows of the destination width.
+static void pyrDown(const uchar* src, size_t srcStep, int cols, int rows,
+                    uchar* dst, size_t dstStep, int* buffer)
+{
+    int dcols = (cols + 1) / 2, drows = (rows + 1) / 2;
+
+    for (int dy = 0; dy < drows; dy++) {
+
+        // horizontal pass on the 5 source rows
+        for (int k = 0; k < 5; k++) {
+            const uchar* row = src + reflect101(2 * dy - 2 + k, rows) * srcStep;
+            int* out = buffer + k * dcols;
+            for (int dx = 0; dx < dcols; dx++) {
+                int sx = 2 * dx;
+                if (sx >= 2 && sx + 2 < cols) {
+                    out[dx] = row[sx - 2] + 4 * (row[sx - 1] + row[sx + 1]) + 6 * row[sx] + row[sx + 2];
+                }
+                else {
+                    out[dx] = row[reflect101(sx - 2, cols)]
+                              + 4 * (row[reflect101(sx - 1, cols)] + row[reflect101(sx + 1, cols)])
+                              + 6 * row[sx] + row[reflect101(sx + 2, cols)];
+                }
+            }
+        }
+
+        // vertical pass, rounded
+        uchar* out = dst + dy * dstStep;
+        const int *r0 = buffer, *r1 = r0 + dcols, *r2 = r1 + dcols, *r3 = r2 + dcols, *r4 = r3 + dcols;
+        for (int dx = 0; dx < dcols; dx++) {
+            out[dx] = (uchar) ((r0[dx] + 4 * (r1[dx] + r3[dx]) + 6 * r2[dx] + r4[dx] + 128) >> 8);
+        }
+    }
+}
+
+// Scharr derivatives (dx, dy) of an image, like the ones
+// cv::buildOpticalFlowPyramid computes. 'buffer' holds 2 * (cols + 2) ints.
+static void scharr(const uchar* src, size_t srcStep, int cols, int rows,
+                   short* dst, size_t dstStep, int* buffer)
+{
+    int* trow0 = buffer + 1;
+    int* trow1 = trow0 + cols + 2;
+
+    for (int y = 0; y < rows; y++) {
+        const uchar* srow0 = src + reflect101(y - 1, rows) * srcStep;
+        const uchar* srow1 = src + y * srcStep;
+        const uchar* srow2 = src + reflect101(y + 1, rows) * srcStep;
+
+        // vertical smoothing, and vertical derivative
+        for (int x = 0; x < cols; x++) {
+            trow0[x] = (srow0[x] + srow2[x]) * 3 + srow1[x] * 10;
+            trow1[x] = srow2[x] - srow0[x];
+        }
+        int x1 = cols > 1 ? 1 : 0, x2 = cols > 1 ? cols - 2 : 0;
+        trow0[-1] = trow0[x1]; trow0[cols] = trow0[x2];
+        trow1[-1] = trow1[x1]; trow1[cols] = trow1[x2];
+
+        // horizontal derivative, and horizontal smoothing
+        short* drow = (short*) ((uchar*) dst + y * dstStep);
+        for (int x = 0; x < cols; x++) {
+            drow[2 * x] = (short) (trow0[x + 1] - trow0[x - 1]);
+            drow[2 * x + 1] = (short) ((trow1[x + 1] + trow1[x - 1]) * 3 + trow1[x] * 10);
+        }
+    }
+}
+
+void ImagePyramid::build(const Mat& image)
+{
+    CV_Assert(image.type() == CV_8U);
+
+    const int border = LK_WINDOW;
+
+    int needed = max(2 * (image.cols + 2), 5 * ((image.cols + 1) / 2));
+    if (rowBuffer.cols < needed) rowBuffer.create(1, needed, CV_32S);
+    int* buffer = rowBuffer.ptr<int>();
+
+    Size size = image.size();
+    _levels = 0;
+
+    for (int level = 0; level <= LK_LEVELS; level++) {
+
+        // both reuse their buffers when the size does not change
+        imageBuffers[level].create(size.height + 2 * border, size.width + 2 * border, CV_8U);
+        derivBuffers[level].create(size.height + 2 * border, size.width + 2 * border, CV_16SC2);
+        images[level] = imageBuffers[level](Rect(border, border, size.width, size.height));
+        derivs[level] = derivBuffers[level](Rect(border, border, size.width, size.height));
+
+        Mat& img = images[level];
+        if (level == 0) {
+            for (int y = 0; y < size.height; y++) {
+                memcpy(img.ptr(y), image.ptr(y), size.width);
+            }
+        }
+        else {
+            const Mat& prev = images[level - 1];
+            pyrDown(prev.ptr(), prev.step, prev.cols, prev.rows, img.ptr(), img.step, buffer);
+        }
+        fillBorder(img.ptr(), img.step, size.width, size.height, border);
+
+        derivBuffers[level] = Scalar::all(0);
+        scharr(img.ptr(), img.step, size.width, size.height,
+               derivs[level].ptr<short>(), derivs[level].step, buffer);
+
+        _levels++;
+
+        // like cv::buildOpticalFlowPyramid, stop before the levels get
+        // smaller than the window
+        size = Size((size.width + 1) / 2, (size.height + 1) / 2);
+        if (size.width <= LK_WINDOW || size.height <= LK_WINDOW) break;
+    }
+}
+
+void OpticalFlow::push(const Mat& frame)
+{
+    current = 1 - current;
+    pyramids[current].build(frame);
+    _frame++;
+}
+
+// Bilinear interpolation weights, in fixed point, like cv::calcOpticalFlowPyrLK
+static const int W_BITS = 14;
+
+static inline int descale(int x, int n) {return (x + (1 << (n - 1))) >> n;}
+
+static void weights(float a, float b, int& iw00, int& iw01, int& iw10, int& iw11)
+{
+    iw00 = cvRound((1.f - a) * (1.f - b) * (1 << W_BITS));
+    iw01 = cvRound(a * (1.f - b) * (1 << W_BITS));
+    iw10 = cvRound((1.f - a) * b * (1 << W_BITS));
+    iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+}
+
+void OpticalFlow::track(const Point2f* prevPts, Point2f* nextPts,
+                        unsigned char* status, float* err, size_t count) const
+{
+    const ImagePyramid& prev = pyramids[1 - current];
+    const ImagePyramid& next = pyramids[current];
+
+    const float FLT_SCALE = 1.f / (1 << 20);
+    const float epsilon = LK_EPSILON * LK_EPSILON;
+    const Point2f halfWin((LK_WINDOW - 1) * 0.5f, (LK_WINDOW - 1) * 0.5f);
+    const int maxLevel = min(LK_LEVELS, min(prev.levels(), next.levels()) - 1);
+
+    // the patch around the point in the previous frame, and its derivatives
+    short IWin[LK_WINDOW * LK_WINDOW];
+    short derivIWin[LK_WINDOW * LK_WINDOW * 2];
+
+    for (size_t i = 0; i < count; i++) {
+
+        status[i] = 1;
+        if (err) err[i] = 0.f;
+
+        for (int level = maxLevel; level >= 0; level--) {
+
+            const Mat& I = prev.image(level);
+            const Mat& J = next.image(level);
+            const Mat& derivI = prev.derivatives(level);
+
+            const int stepI = (int) I.step, stepJ = (int) J.step;
+            const int dstep = (int) (derivI.step / sizeof(short));
+
+            Point2f prevPt = prevPts[i] * (float) (1. / (1 << level));
+            Point2f nextPt = level == maxLevel ? prevPt : nextPts[i] * 2.f;
+            nextPts[i] = nextPt;
+
+            prevPt -= halfWin;
+            Point iprevPt(cvFloor(prevPt.x), cvFloor(prevPt.y));
+
+            if (iprevPt.x < -LK_WINDOW || iprevPt.x >= derivI.cols
+                || iprevPt.y < -LK_WINDOW || iprevPt.y >= derivI.rows) {
+                if (level == 0) {
+                    status[i] = 0;
+                    if (err) err[i] = 0.f;
+                }
+                continue;
+            }
+
+            int iw00, iw01, iw10, iw11;
+            weights(prevPt.x - iprevPt.x, prevPt.y - iprevPt.y, iw00, iw01, iw10, iw11);
+
+            // extract the patch from the first image, compute covariation
+            // matrix of derivatives
+            float A11 = 0.f, A12 = 0.f, A22 = 0.f;
+
+            for (int y = 0; y < LK_WINDOW; y++) {
+                const uchar* src = I.ptr() + (y + iprevPt.y) * stepI + iprevPt.x;
+                const short* dsrc = (const short*) derivI.ptr() + (y + iprevPt.y) * dstep + iprevPt.x * 2;
+                short* Iptr = IWin + y * LK_WINDOW;
+                short* dIptr = derivIWin + y * LK_WINDOW * 2;
+
+                for (int x = 0; x < LK_WINDOW; x++, dsrc += 2, dIptr += 2) {
+                    int ival = descale(src[x] * iw00 + src[x + 1] * iw01
+                                       + src[x + stepI] * iw10 + src[x + stepI + 1] * iw11, W_BITS - 5);
+                    int ixval = descale(dsrc[0] * iw00 + dsrc[2] * iw01
+                                        + dsrc[dstep] * iw10 + dsrc[dstep + 2] * iw11, W_BITS);
+                    int iyval = descale(dsrc[1] * iw00 + dsrc[3] * iw01
+                                        + dsrc[dstep + 1] * iw10 + dsrc[dstep + 3] * iw11, W_BITS);
+
+                    Iptr[x] = (short) ival;
+                    dIptr[0] = (short) ixval;
+                    dIptr[1] = (short) iyval;
+
+                    A11 += (float) (ixval * ixval);
+                    A12 += (float) (ixval * iyval);
+                    A22 += (float) (iyval * iyval);
+                }
+            }
+
+            A11 *= FLT_SCALE;
+            A12 *= FLT_SCALE;
+            A22 *= FLT_SCALE;
+
+            float D = A11 * A22 - A12 * A12;
+            float minEig = (A22 + A11 - sqrt((A11 - A22) * (A11 - A22) + 4.f * A12 * A12))
+                           / (2 * LK_WINDOW * LK_WINDOW);
+
+            // not enough texture to track this point
+            if (minEig < 1e-4f || D < FLT_EPSILON) {
+                if (level == 0) status[i] = 0;
+                continue;
+            }
+
+            D = 1.f / D;
+
+            nextPt -= halfWin;
+            Point2f prevDelta;
+
+            for (int j = 0; j < LK_MAX_ITERATIONS; j++) {
+                Point inextPt(cvFloor(nextPt.x), cvFloor(nextPt.y));
+
+                if (inextPt.x < -LK_WINDOW || inextPt.x >= J.cols
+                    || inextPt.y < -LK_WINDOW || inextPt.y >= J.rows) {
+                    if (level == 0) status[i] = 0;
+                    break;
+                }
+
+                weights(nextPt.x - inextPt.x, nextPt.y - inextPt.y, iw00, iw01, iw10, iw11);
+
+                float b1 = 0.f, b2 = 0.f;
+
+                for (int y = 0; y < LK_WINDOW; y++) {
+                    const uchar* Jptr = J.ptr() + (y + inextPt.y) * stepJ + inextPt.x;
+                    const short* Iptr = IWin + y * LK_WINDOW;
+                    const short* dIptr = derivIWin + y * LK_WINDOW * 2;
+
+                    for (int x = 0; x < LK_WINDOW; x++, dIptr += 2) {
+                        int diff = descale(Jptr[x] * iw00 + Jptr[x + 1] * iw01
+                                           + Jptr[x + stepJ] * iw10 + Jptr[x + stepJ + 1] * iw11, W_BITS - 5)
+                                   - Iptr[x];
+                        b1 += (float) (diff * dIptr[0]);
+                        b2 += (float) (diff * dIptr[1]);
+                    }
+                }
+
+                b1 *= FLT_SCALE;
+                b2 *= FLT_SCALE;
+
+                Point2f delta((float) ((A12 * b2 - A22 * b1) * D),
+                              (float) ((A12 * b1 - A11 * b2) * D));
+
+                nextPt += delta;
+                nextPts[i] = nextPt + halfWin;
+
+                if (delta.ddot(delta) <= epsilon) break;
+
+                // oscillating around the solution: take the middle
+                if (j > 0 && abs(delta.x + prevDelta.x) < 0.01 && abs(delta.y + prevDelta.y) < 0.01) {
+                    nextPts[i] -= delta * 0.5f;
+                    break;
+                }
+                prevDelta = delta;
+            }
+
+            if (status[i] && err && level == 0) {
+                Point2f nextPoint = nextPts[i] - halfWin;
+                Point inextPoint(cvFloor(nextPoint.x), cvFloor(nextPoint.y));
+
+                if (inextPoint.x < -LK_WINDOW || inextPoint.x >= J.cols
+                    || inextPoint.y < -LK_WINDOW || inextPoint.y >= J.rows) {
+                    status[i] = 0;
+                    continue;
+                }
+
+                weights(nextPoint.x - inextPoint.x, nextPoint.y - inextPoint.y, iw00, iw01, iw10, iw11);
+
+                float errval = 0.f;
+                for (int y = 0; y < LK_WINDOW; y++) {
+                    const uchar* Jptr = J.ptr() + (y + inextPoint.y) * stepJ + inextPoint.x;
+                    const short* Iptr = IWin + y * LK_WINDOW;
+
+                    for (int x = 0; x < LK_WINDOW; x++) {
+                        int diff = descale(Jptr[x] * iw00 + Jptr[x + 1] * iw01
+                                           + Jptr[x + stepJ] * iw10 + Jptr[x + stepJ + 1] * iw11, W_BITS - 5)
+                                   - Iptr[x];
+                        errval += abs((float) diff);
+                    }
+                }
+                err[i] = errval / (32 * LK_WINDOW * LK_WINDOW);
+            }
+        }
+    }
+}
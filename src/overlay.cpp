@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "overlay.h"
+
+using namespace cv;
+using namespace std;
+
+void drawSnapshot(const TrackingSnapshot& snapshot, Mat& image)
+{
+    for (const auto& track : snapshot.tracks) {
+
+        if (track.mode != LOST) {
+
+            line( image, track.centroid, track.centroid, cv::Scalar(10, 100, 200), 20 );
+
+            for (size_t i = 0; i < track.nbFeatures; i++) {
+                line( image, track.features[i], track.features[i], cv::Scalar(10, 200, 100), 10 );
+            }
+
+            if (track.eyesTracked) {
+                circle( image, track.leftEye, 4, cv::Scalar(255, 255, 255), 2 );
+                circle( image, track.rightEye, 4, cv::Scalar(255, 255, 255), 2 );
+            }
+
+            putText(image,
+                    track.name,
+                    track.centroid + Point2f(10,10),
+                    FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(10,100,200));
+        }
+        else //LOST!
+        {
+            putText(image,
+                    track.name + " LOST!",
+                    track.boundingbox.tl() + Point(20,20),
+                    FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(200,100,10));
+        }
+
+        rectangle( image, track.boundingbox, cv::Scalar(255,0,255), 4 );
+    }
+}
+
+OverlayRenderer::OverlayRenderer(const string& window, double maxFps) :
+    back(0),
+    front(1),
+    middle(2),
+    window(window),
+    period(max(1, cvRound(1000. / maxFps))),
+    running(true),
+    _lastKey(-1)
+{
+    worker = thread(&OverlayRenderer::run, this);
+}
+
+OverlayRenderer::~OverlayRenderer()
+{
+    running = false;
+    worker.join();
+}
+
+void OverlayRenderer::publish(const Mat& frame, const FaceTracking& tracking)
+{
+    Slot& slot = slots[back];
+    frame.copyTo(slot.frame);
+    tracking.snapshot(slot.snapshot);
+
+    // hand the slot over, and take the former middle one (whether the
+    // renderer saw it or not) to write the next frame
+    back = middle.exchange(back | FRESH) & ~FRESH;
+}
+
+void OverlayRenderer::publish(const Mat& frame, const TrackingSnapshot& snapshot)
+{
+    Slot& slot = slots[back];
+    frame.copyTo(slot.frame);
+    // copy-assignment reuses the buffers of the slot
+    slot.snapshot = snapshot;
+
+    back = middle.exchange(back | FRESH) & ~FRESH;
+}
+
+void OverlayRenderer::run()
+{
+    namedWindow(window);
+
+    while (running) {
+        if (middle.load() & FRESH) {
+            front = middle.exchange(front) & ~FRESH;
+
+            Slot& slot = slots[front];
+            drawSnapshot(slot.snapshot, slot.frame);
+            imshow(window, slot.frame);
+        }
+
+        // also paces the renderer
+        int key = waitKey(period);
+        if (key >= 0) _lastKey = key;
+    }
+
+    destroyWindow(window);
+}
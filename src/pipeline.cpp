@@ -0,0 +1,37 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "pipeline.h"
+#include "logging.h"
+
+using namespace std;
+
+bool queuePolicyFromName(const string& name, QueuePolicy& policy)
+{
+    if (name == "block") policy = BLOCK;
+    else if (name == "drop-oldest") policy = DROP_OLDEST;
+    else if (name == "keep-latest") policy = KEEP_LATEST;
+    else return false;
+
+    return true;
+}
+
+bool pinThread(thread& thread, int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    int error = pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpus);
+    if (error == 0) return true;
+
+    FT_LOG_WARN("Could not pin a thread to CPU " << cpu << " (error " << error << ")");
+    return false;
+#else
+    FT_LOG_WARN("Pinning threads to CPUs is not supported on this platform");
+    return false;
+#endif
+}
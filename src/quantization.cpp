@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+// as in simd_cascade.cpp: SSE2 is always available on x86-64, AVX2 is
+// selected at runtime
+#define QUANTIZATION_X86_SIMD
+#include <immintrin.h>
+#define QUANTIZATION_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "quantization.h"
+
+using namespace cv;
+using namespace std;
+
+static float dotScalar(const float* a, const float* b, size_t size)
+{
+    float sum = 0.f;
+    for (size_t i = 0; i < size; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+static int32_t dotScalar(const int8_t* a, const int8_t* b, size_t size)
+{
+    int32_t sum = 0;
+    for (size_t i = 0; i < size; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+#ifdef QUANTIZATION_X86_SIMD
+
+static float horizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static int32_t horizontalSum(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static float dotSSE2(const float* a, const float* b, size_t size)
+{
+    // two accumulators, to hide the latency of the additions
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    return horizontalSum(_mm_add_ps(sum0, sum1)) + dotScalar(a + i, b + i, size - i);
+}
+
+/** The products of 8 pairs of int8, summed two by two in 4 int32.
+ */
+static __m128i multiplyAdd(__m128i a, __m128i b)
+{
+    // SSE2 has no int8 multiplication: sign-extend to int16 first
+    __m128i zero = _mm_setzero_si128();
+    __m128i a16 = _mm_unpacklo_epi8(a, _mm_cmpgt_epi8(zero, a));
+    __m128i b16 = _mm_unpacklo_epi8(b, _mm_cmpgt_epi8(zero, b));
+    return _mm_madd_epi16(a16, b16);
+}
+
+static int32_t dotSSE2(const int8_t* a, const int8_t* b, size_t size)
+{
+    __m128i sum = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i va = _mm_loadl_epi64((const __m128i*) (a + i));
+        __m128i vb = _mm_loadl_epi64((const __m128i*) (b + i));
+        sum = _mm_add_epi32(sum, multiplyAdd(va, vb));
+    }
+    return horizontalSum(sum) + dotScalar(a + i, b + i, size - i);
+}
+
+QUANTIZATION_AVX2 static float dotAVX2(const float* a, const float* b, size_t size)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    return horizontalSum(half) + dotSSE2(a + i, b + i, size - i);
+}
+
+QUANTIZATION_AVX2 static int32_t dotAVX2(const int8_t* a, const int8_t* b, size_t size)
+{
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    return horizontalSum(half) + dotSSE2(a + i, b + i, size - i);
+}
+
+#endif // QUANTIZATION_X86_SIMD
+
+float dotProduct(const float* a, const float* b, size_t size, InstructionSet set)
+{
+    switch (set) {
+#ifdef QUANTIZATION_X86_SIMD
+    case AVX2: return dotAVX2(a, b, size);
+    case SSE2: return dotSSE2(a, b, size);
+#endif
+    default: return dotScalar(a, b, size);
+    }
+}
+
+int32_t dotProduct(const int8_t* a, const int8_t* b, size_t size, InstructionSet set)
+{
+    switch (set) {
+#ifdef QUANTIZATION_X86_SIMD
+    case AVX2: return dotAVX2(a, b, size);
+    case SSE2: return dotSSE2(a, b, size);
+#endif
+    default: return dotScalar(a, b, size);
+    }
+}
+
+float quantize(const float* vector, size_t size, int8_t* codes)
+{
+    float largest = 0.f;
+    for (size_t i = 0; i < size; i++) largest = max(largest, fabs(vector[i]));
+
+    if (largest == 0.f) {
+        fill(codes, codes + size, 0);
+        return 0.f;
+    }
+
+    float scale = largest / 127.f;
+    for (size_t i = 0; i < size; i++) {
+        codes[i] = (int8_t) max(-127.f, min(127.f, roundf(vector[i] / scale)));
+    }
+    return scale;
+}
+
+FaceProjector::FaceProjector() :
+        simd(bestInstructionSet()),
+        components(0),
+        pixels(0)
+{
+}
+
+void FaceProjector::setBasis(const Mat& eigenvectors, const Mat& meanFace)
+{
+    components = eigenvectors.cols;
+    pixels = eigenvectors.rows;
+
+    // one eigenface per row
+    Mat transposed;
+    transpose(eigenvectors, transposed);
+    transposed.convertTo(transposed, CV_32F);
+
+    basis.resize(components * pixels);
+    for (size_t k = 0; k < components; k++) {
+        const float* row = transposed.ptr<float>(k);
+        copy(row, row + pixels, basis.begin() + k * pixels);
+    }
+
+    Mat mean32;
+    meanFace.reshape(1, 1).convertTo(mean32, CV_32F);
+    mean.assign(mean32.ptr<float>(), mean32.ptr<float>() + pixels);
+
+    centered.resize(pixels);
+}
+
+void FaceProjector::setInstructionSet(InstructionSet set)
+{
+    simd = min(set, bestInstructionSet());
+}
+
+void FaceProjector::project(const Mat& face, float* projection)
+{
+    CV_Assert(face.type() == CV_8U && face.total() == pixels && face.isContinuous());
+
+    // centering first (instead of subtracting the projection of the mean)
+    // keeps the float sums small
+    const uchar* p = face.ptr<uchar>();
+    for (size_t i = 0; i < pixels; i++) centered[i] = p[i] - mean[i];
+
+    for (size_t k = 0; k < components; k++) {
+        projection[k] = dotProduct(&basis[k * pixels], centered.data(), pixels, simd);
+    }
+}
@@ -1,9 +1,10 @@
 #include <utility> // make_pair
-#include <iostream>
 #include <cassert>
 
 #include "recognition.h"
 #include "face_constants.h"
+#include "logging.h"
+#include "tracing.h"
 
 //#define DEBUG_recognition
 #ifdef DEBUG_recognition
@@ -37,81 +38,158 @@ static Mat norm_0_255(InputArray _src) {
 }
 
 Recognizer::Recognizer(const FaceDetector& detector):
-        _detector(detector)
+        _detector(detector),
+        basisSamples(0)
 {
 
-    //int num_components = 0;
     //double threshold = 100.0;
     //model = createEigenFaceRecognizer(num_components, threshold);
-    model = createEigenFaceRecognizer();
+    model = createEigenFaceRecognizer(NB_EIGENFACES);
 }
 
 bool Recognizer::addPictureOf(const Mat& image, const string& label) {
+    return addPicture(image, nullptr, label);
+}
 
-    int idx = -1;
+bool Recognizer::addPictureOf(const Mat& image,
+                              const Point2f& leftEye, const Point2f& rightEye,
+                              const string& label) {
+    Point2f eyes[] = {leftEye, rightEye};
+    return addPicture(image, eyes, label);
+}
 
-    for (const auto& kv : human_labels) {
-        if (label == kv.second) {
-            idx = kv.first;
-            break;
-        }
-    }
+bool Recognizer::addPicture(const Mat& image, const Point2f* eyes, const string& label) {
+
+    int idx;
 
-    if (idx == -1) // new label!
+    auto known = label_ids.find(label);
+    if (known == label_ids.end()) // new label!
     {
         idx = human_labels.size();
         trained_labels[idx] = false;
         human_labels[idx] = label;
+        label_ids[label] = idx;
     }
+    else idx = known->second;
 
+    if (trained_labels[idx]) return true;
 
     if (trainingSet[idx].size() < MAX_TRAINING_IMAGES) {
-        cout << "Acquiring " << trainingSet[idx].size() + 1 << "/" << MAX_TRAINING_IMAGES << " images for " << label << "... ";
         Mat preprocessedFace;
 
-        if (preprocessFace(image, preprocessedFace)) {
-            cout << "ok." << endl;
+        bool preprocessed = eyes ? preprocessFace(image, eyes[0], eyes[1], preprocessedFace)
+                                 : preprocessFace(image, preprocessedFace);
+        if (preprocessed) {
             trainingSet[idx].push_back(preprocessedFace);
+            FT_LOG_INFO("Acquired " << trainingSet[idx].size() << "/" << MAX_TRAINING_IMAGES << " images for " << label);
         }
         else
-            cout << "failed!" << endl;
+            FT_LOG_DEBUG("Could not acquire a training image for " << label);
 
         return false;
     }
 
-    if (!trained_labels[idx])
-    {
-        cout << "Enough data for " << label << "! Training the recognizer..." << endl;
-        train(idx);
-    }
+    FT_LOG_INFO("Enough data for " << label << "! Training the recognizer...");
+    train(idx);
     return true;
 }
 
 void Recognizer::train(int label) {
+
+    TRACE_SPAN("Recognizer::train");
+
+    trained_labels[label] = true;
+
+    size_t nbSamples = 0;
+    for (const auto& kv : trainingSet) {
+        if (trained_labels[kv.first]) nbSamples += kv.second.size();
+    }
+
+    if (basisSamples == 0
+        || (nbSamples >= 2 * basisSamples && basisSamples < MAX_EIGENFACES_SAMPLES)) {
+        computeEigenfaces();
+    }
+    else {
+        // project the new face on the existing eigenfaces
+        for (const auto& image : trainingSet[label]) {
+            projector.project(image, projection.data());
+            gallery.add(projection.data(), label);
+        }
+        gallery.refresh();
+
+        // the basis is not going to change anymore: no need to keep the
+        // images around
+        if (basisSamples >= MAX_EIGENFACES_SAMPLES) vector<Mat>().swap(trainingSet[label]);
+    }
+
+    FT_LOG_INFO("I can now recognize " << human_labels[label] << " in new images.");
+}
+
+void Recognizer::computeEigenfaces() {
     vector<Mat> images;
     vector<int> labels;
 
-    for (const auto& image : trainingSet[label]) {
-        labels.push_back(label);
-        images.push_back(image);
+    for (const auto& kv : trainingSet) {
+        if (!trained_labels[kv.first]) continue;
+
+        for (const auto& image : kv.second) {
+            labels.push_back(kv.first);
+            images.push_back(image);
+        }
     }
 
     model->train(images, labels);
-    trained_labels[label] = true;
-    cout << "I can now recognize " << human_labels[label] << " in new images." << endl;
+
+    projector.setBasis(model->getMat("eigenvectors"), model->getMat("mean"));
+    projection.resize(projector.dimension());
+    basisSamples = images.size();
+
+    // re-index the whole gallery in the new basis
+    auto projections = model->getMatVector("projections");
+
+    gallery.clear(projector.dimension());
+    Mat projection32;
+    for (size_t i = 0; i < projections.size(); i++) {
+        projections[i].convertTo(projection32, CV_32F);
+        gallery.add(projection32.ptr<float>(), labels[i]);
+    }
+    gallery.rebuild();
+}
+
+size_t Recognizer::trainingImages(const string& label) const {
+    auto known = label_ids.find(label);
+    if (known == label_ids.end()) return 0;
+
+    auto images = trainingSet.find(known->second);
+    return images != trainingSet.end() ? images->second.size() : 0;
 }
 
 pair<string, double> Recognizer::whois(const Mat& image) {
+    return recognize(image, nullptr);
+}
+
+pair<string, double> Recognizer::whois(const Mat& image,
+                                       const Point2f& leftEye, const Point2f& rightEye) {
+    Point2f eyes[] = {leftEye, rightEye};
+    return recognize(image, eyes);
+}
 
-    if (trained_labels.empty()) return make_pair("", 0.0);
+pair<string, double> Recognizer::recognize(const Mat& image, const Point2f* eyes) {
+
+    TRACE_SPAN("Recognizer::whois");
+
+    if (gallery.size() == 0) return make_pair("", 0.0);
 
     int label = -1;
     double confidence = 0.0;
 
     Mat preprocessedFace;
 
-    if (preprocessFace(image, preprocessedFace)) {
-        model->predict(preprocessedFace, label, confidence);
+    bool preprocessed = eyes ? preprocessFace(image, eyes[0], eyes[1], preprocessedFace)
+                             : preprocessFace(image, preprocessedFace);
+    if (preprocessed) {
+        projector.project(preprocessedFace, projection.data());
+        gallery.nearest(projection.data(), label, confidence, GALLERY_MAX_CHECKS);
     }
     else
     {
@@ -126,10 +204,29 @@ pair<string, double> Recognizer::whois(const Mat& image) {
         return make_pair("", 0.0);
 }
 
+bool Recognizer::preprocessFace(const Mat& faceImg, Mat& dstImg) {
+
+    // Search for the 2 eyes at the full resolution, since eye detection needs max resolution possible!
+    Point leftEye, rightEye;
+    bool eyes_detected = _detector.detectBothEyes(faceImg, leftEye, rightEye);
+    
+    // Check if both eyes were detected.
+    if (!eyes_detected) {
+        FT_LOG_DEBUG("Eyes not detected!");
+        return false;
+    }
+
+    return preprocessFace(faceImg, leftEye, rightEye, dstImg);
+}
+
 /**
  * Code from Mastering OpenCV, Chapter 8
  */
-bool Recognizer::preprocessFace(const Mat& faceImg, Mat& dstImg) {
+bool Recognizer::preprocessFace(const Mat& faceImg,
+                                const Point2f& leftEye, const Point2f& rightEye,
+                                Mat& dstImg) {
+
+    TRACE_SPAN("Recognizer::preprocessFace");
 
     int desiredFaceHeight, desiredFaceWidth;
 
@@ -138,16 +235,6 @@ bool Recognizer::preprocessFace(const Mat& faceImg, Mat& dstImg) {
 
     // the image MUST be grayscale
     assert(faceImg.channels() == 1);
-    
-    // Search for the 2 eyes at the full resolution, since eye detection needs max resolution possible!
-    Point leftEye, rightEye;
-    bool eyes_detected = _detector.detectBothEyes(faceImg, leftEye, rightEye);
-    
-    // Check if both eyes were detected.
-    if (!eyes_detected) {
-        cout << "Eyes not detected!";
-        return false;
-    }
 
     // Make the face image the same size as the training images.
 
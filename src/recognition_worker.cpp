@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <utility> // swap
+
+#include "recognition_worker.h"
+#include "tracing.h"
+
+using namespace cv;
+using namespace std;
+
+RecognitionWorker::RecognitionWorker(size_t capacity) :
+        recognizer(detector),
+        capacity(capacity),
+        jobs(capacity),
+        head(0),
+        queued(0),
+        stopping(false),
+        submitted(0),
+        processed(0),
+        dropped(0),
+        worker(&RecognitionWorker::run, this)
+{
+}
+
+RecognitionWorker::~RecognitionWorker()
+{
+    {
+        lock_guard<mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    pending.notify_one();
+    worker.join();
+}
+
+bool RecognitionWorker::identify(unsigned int trackId, const Mat& face, const Point2f* eyes)
+{
+    {
+        lock_guard<mutex> lock(jobsMutex);
+
+        submitted++;
+
+        if (queued >= capacity) {
+            // make room by sacrificing the oldest training sample, if any
+            size_t learnJob = 0;
+            while (learnJob < queued && slot(learnJob).kind != Job::LEARN) learnJob++;
+            dropped++;
+            if (learnJob == queued) return false;
+
+            // the track gets to know its sample was not used
+            const Job& evicted = slot(learnJob);
+            done.push_back(RecognitionResult{RecognitionResult::SAMPLE_REJECTED, evicted.trackId,
+                                             evicted.name, 0., (unsigned long) evicted.frame});
+
+            // move it to the end of the queue (the jobs after it move up),
+            // where its buffers will be reused
+            for (size_t i = learnJob; i + 1 < queued; i++) swap(slot(i), slot(i + 1));
+            queued--;
+        }
+
+        push(Job::IDENTIFY, trackId, tracing::context().frame, face, eyes, "");
+    }
+    pending.notify_one();
+    return true;
+}
+
+bool RecognitionWorker::learn(unsigned int trackId, const Mat& face, const string& name,
+                              unsigned long frame, const Point2f* eyes)
+{
+    {
+        lock_guard<mutex> lock(jobsMutex);
+
+        submitted++;
+
+        if (queued >= capacity) {
+            dropped++;
+            return false;
+        }
+
+        push(Job::LEARN, trackId, frame, face, eyes, name);
+    }
+    pending.notify_one();
+    return true;
+}
+
+void RecognitionWorker::push(Job::Kind kind, unsigned int trackId, long frame, const Mat& face,
+                             const Point2f* eyes, const string& name)
+{
+    Job& job = slot(queued);
+    job.kind = kind;
+    job.trackId = trackId;
+    job.frame = frame;
+    // the crops change size from one frame to the next: only grow the
+    // buffer of the slot (with some slack) when it is too small
+    int bytes = (int) (face.total() * face.elemSize());
+    if (job.buffer.cols < bytes) job.buffer.create(1, bytes + bytes / 2, CV_8U);
+    job.face = Mat(face.size(), face.type(), job.buffer.data);
+    face.copyTo(job.face);
+    job.eyesKnown = eyes != nullptr;
+    if (eyes) {
+        job.eyes[0] = eyes[0];
+        job.eyes[1] = eyes[1];
+    }
+    job.name = name;
+    queued++;
+}
+
+void RecognitionWorker::results(vector<RecognitionResult>& results)
+{
+    results.clear();
+
+    lock_guard<mutex> lock(jobsMutex);
+    swap(results, done);
+}
+
+RecognitionStats RecognitionWorker::stats() const
+{
+    lock_guard<mutex> lock(jobsMutex);
+    return RecognitionStats{queued, capacity, submitted, processed, dropped};
+}
+
+void RecognitionWorker::run()
+{
+    // swapped with the queue slots: the buffers go round
+    Job job;
+
+    while (true) {
+
+        {
+            unique_lock<mutex> lock(jobsMutex);
+            pending.wait(lock, [this]() {return stopping || queued > 0;});
+
+            if (stopping) return;
+
+            swap(job, slot(0));
+            head = (head + 1) % capacity;
+            queued--;
+        }
+
+        // the expensive part, done without holding the lock
+        RecognitionResult result;
+        bool report = process(job, result);
+
+        lock_guard<mutex> lock(jobsMutex);
+        processed++;
+        if (report) done.push_back(result);
+    }
+}
+
+bool RecognitionWorker::process(const Job& job, RecognitionResult& result)
+{
+    TRACE_CONTEXT(job.frame, job.trackId);
+
+    if (job.kind == Job::IDENTIFY) {
+        auto guess = job.eyesKnown ? recognizer.whois(job.face, job.eyes[0], job.eyes[1])
+                                   : recognizer.whois(job.face);
+
+        // an exact match has a distance of 0: only the label tells
+        if (!guess.first.empty()) {
+            result = RecognitionResult{RecognitionResult::IDENTIFIED, job.trackId, guess.first, guess.second, 0};
+        }
+        else {
+            result = RecognitionResult{RecognitionResult::UNKNOWN, job.trackId, "", 0., 0};
+        }
+        return true;
+    }
+
+    // Job::LEARN: the sample only counts if it made it to the training set
+    size_t images = recognizer.trainingImages(job.name);
+    bool trained = job.eyesKnown
+                   ? recognizer.addPictureOf(job.face, job.eyes[0], job.eyes[1], job.name)
+                   : recognizer.addPictureOf(job.face, job.name);
+
+    RecognitionResult::Kind kind = trained ? RecognitionResult::TRAINED
+                                   : recognizer.trainingImages(job.name) > images
+                                     ? RecognitionResult::SAMPLE_ACQUIRED
+                                     : RecognitionResult::SAMPLE_REJECTED;
+    result = RecognitionResult{kind, job.trackId, job.name, 0., (unsigned long) job.frame};
+    return true;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sample_selector.h"
+
+using namespace cv;
+using namespace std;
+
+static const int SIGNATURE_LENGTH = SIGNATURE_SIZE * SIGNATURE_SIZE;
+
+void SampleSelector::clear()
+{
+    nbAccepted = 0;
+    nbPending = 0;
+    anySubmitted = false;
+    lastFrame = 0;
+    candidate.frame = 0;
+}
+
+bool SampleSelector::isUseful(const Mat& face, const Matx44d& pose, unsigned long frame)
+{
+    if (face.rows < SIGNATURE_SIZE || face.cols < SIGNATURE_SIZE) return false;
+    if (nbPending >= MAX_PENDING_SAMPLES) return false;
+
+    unsigned long elapsed = frame - lastFrame;
+    if (anySubmitted && elapsed < SAMPLE_MIN_INTERVAL) return false;
+
+    candidate.frame = frame;
+    candidate.width = face.cols;
+    candidate.pose = pose;
+    computeSignature(face);
+
+    if (!anySubmitted || elapsed >= SAMPLE_MAX_INTERVAL) return true;
+
+    int remembered = min(nbAccepted, (unsigned int) MAX_SELECTED_SAMPLES);
+    for (int i = 0; i < remembered; i++) {
+        if (isSimilar(candidate, samples[i])) return false;
+    }
+    for (unsigned int i = 0; i < nbPending; i++) {
+        if (isSimilar(candidate, pendingSamples[i])) return false;
+    }
+    return true;
+}
+
+void SampleSelector::submitted()
+{
+    if (nbPending >= MAX_PENDING_SAMPLES) return;
+
+    pendingSamples[nbPending++] = candidate;
+    anySubmitted = true;
+    lastFrame = candidate.frame;
+}
+
+void SampleSelector::learned(unsigned long frame)
+{
+    if (!takePending(frame, samples[nbAccepted % MAX_SELECTED_SAMPLES])) return;
+    nbAccepted++;
+}
+
+void SampleSelector::rejected(unsigned long frame)
+{
+    Sample forgotten;
+    takePending(frame, forgotten);
+}
+
+bool SampleSelector::takePending(unsigned long frame, Sample& sample)
+{
+    for (unsigned int i = 0; i < nbPending; i++) {
+        if (pendingSamples[i].frame != frame) continue;
+
+        sample = pendingSamples[i];
+        // the order of the pending samples does not matter
+        pendingSamples[i] = pendingSamples[--nbPending];
+        return true;
+    }
+    return false;
+}
+
+bool SampleSelector::isSimilar(const Sample& a, const Sample& b) const
+{
+    float scale = (float) max(a.width, b.width) / min(a.width, b.width);
+    if (scale >= SAMPLE_MIN_SCALE_CHANGE) return false;
+
+    // the pose is only known once the eyes were found
+    if (a.pose(3, 3) != 0 && b.pose(3, 3) != 0) {
+        double dx = a.pose(0, 3) - b.pose(0, 3),
+               dy = a.pose(1, 3) - b.pose(1, 3),
+               dz = a.pose(2, 3) - b.pose(2, 3);
+        if (dx * dx + dy * dy + dz * dz >= SAMPLE_MIN_MOTION * SAMPLE_MIN_MOTION) return false;
+    }
+
+    float difference = 0;
+    for (int i = 0; i < SIGNATURE_LENGTH; i++) {
+        difference += abs(a.signature[i] - b.signature[i]);
+    }
+    return difference / SIGNATURE_LENGTH < SAMPLE_MIN_APPEARANCE_CHANGE;
+}
+
+void SampleSelector::computeSignature(const Mat& face)
+{
+    CV_Assert(face.type() == CV_8UC1);
+
+    float* signature = candidate.signature;
+    fill(signature, signature + SIGNATURE_LENGTH, 0.f);
+
+    // mean of each cell of a SIGNATURE_SIZE x SIGNATURE_SIZE grid. A plain
+    // loop: faces are small, and it does not allocate.
+    int rows[SIGNATURE_SIZE] = {0}, cols[SIGNATURE_SIZE] = {0};
+    for (int y = 0; y < face.rows; y++) {
+        const uchar* row = face.ptr<uchar>(y);
+        int cellRow = y * SIGNATURE_SIZE / face.rows;
+        float* cells = signature + cellRow * SIGNATURE_SIZE;
+        for (int x = 0; x < face.cols; x++) {
+            cells[x * SIGNATURE_SIZE / face.cols] += row[x];
+        }
+        rows[cellRow]++;
+    }
+    for (int x = 0; x < face.cols; x++) cols[x * SIGNATURE_SIZE / face.cols]++;
+
+    for (int r = 0; r < SIGNATURE_SIZE; r++) {
+        for (int c = 0; c < SIGNATURE_SIZE; c++) {
+            signature[r * SIGNATURE_SIZE + c] /= rows[r] * cols[c];
+        }
+    }
+
+    // then normalized to zero mean and unit variance: lighting changes alone
+    // do not make a sample different
+    float mean = 0;
+    for (int i = 0; i < SIGNATURE_LENGTH; i++) mean += signature[i];
+    mean /= SIGNATURE_LENGTH;
+
+    float variance = 0;
+    for (int i = 0; i < SIGNATURE_LENGTH; i++) {
+        signature[i] -= mean;
+        variance += signature[i] * signature[i];
+    }
+    float stddev = sqrt(variance / SIGNATURE_LENGTH);
+    if (stddev == 0) return;
+
+    for (int i = 0; i < SIGNATURE_LENGTH; i++) signature[i] /= stddev;
+}
@@ -0,0 +1,127 @@
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_publisher.h"
+#include "logging.h"
+
+using namespace cv;
+using namespace std;
+
+/** Marks the ring of that name (if any) as retired: the readers still mapping
+ * it then look for the new one.
+ */
+static void retire(const string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return;
+
+    struct stat info;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(ShmRing)) {
+        memory = mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) return;
+
+    // only the rings of this version have the flag there
+    ShmRing* former = static_cast<ShmRing*>(memory);
+    if (former->magic.load(memory_order_acquire) == SHM_RING_MAGIC
+        && former->version == SHM_RING_VERSION) {
+        former->retired.store(1, memory_order_release);
+    }
+    munmap(memory, sizeof(ShmRing));
+}
+
+ShmPublisher::ShmPublisher(const string& name) :
+    name(name),
+    ring(nullptr)
+{
+    // a former publisher may have crashed, leaving its ring behind: retire
+    // it, and start afresh (readers still mapping the old one keep it alive,
+    // until they move to the new one)
+    retire(name);
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        FT_LOG_ERROR("Could not create the shared memory <" << name << ">: " << strerror(errno));
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(ShmRing)) < 0) {
+        FT_LOG_ERROR("Could not size the shared memory <" << name << ">: " << strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    void* memory = mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        FT_LOG_ERROR("Could not map the shared memory <" << name << ">: " << strerror(errno));
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    // the memory is zero-filled: all the sequences and counters are 0
+    ring = static_cast<ShmRing*>(memory);
+    ring->version = SHM_RING_VERSION;
+    ring->slots = SHM_RING_SLOTS;
+    ring->maxFaces = SHM_MAX_FACES;
+    ring->magic.store(SHM_RING_MAGIC, memory_order_release);
+}
+
+ShmPublisher::~ShmPublisher()
+{
+    if (!ring) return;
+    // after the last frame: the readers read it before they move on
+    ring->retired.store(1, memory_order_release);
+    munmap(ring, sizeof(ShmRing));
+    shm_unlink(name.c_str());
+}
+
+void ShmPublisher::publish(const vector<Face>& faces)
+{
+    if (!ring) return;
+
+    uint64_t n = ring->published.load(memory_order_relaxed) + 1;
+    ShmSlot& slot = ring->slot[n % SHM_RING_SLOTS];
+
+    // odd: being written. The data must not be written before that.
+    slot.sequence.store(2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    ShmFrame& frame = slot.frame;
+    frame.frame = n;
+    frame.timestamp = shmTimestamp();
+    frame.nbFaces = min((size_t) SHM_MAX_FACES, faces.size());
+
+    for (uint32_t i = 0; i < frame.nbFaces; i++) {
+        const Face& face = faces[i];
+        ShmFace& shmFace = frame.faces[i];
+
+        shmFace.id = face.id();
+        const string& faceName = face.name();
+        size_t length = min(faceName.size(), (size_t) SHM_NAME_SIZE - 1);
+        memcpy(shmFace.name, faceName.data(), length);
+        shmFace.name[length] = '\0';
+
+        Rect box = face.boundingbox();
+        shmFace.x = box.x;
+        shmFace.y = box.y;
+        shmFace.width = box.width;
+        shmFace.height = box.height;
+
+        Matx44d pose = face.pose();
+        copy(pose.val, pose.val + 16, shmFace.pose);
+    }
+
+    slot.sequence.store(2 * n + 2, memory_order_release);
+    ring->published.store(n, memory_order_release);
+}
@@ -0,0 +1,143 @@
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+using namespace std;
+
+int64_t shmTimestamp()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+ShmRingReader::ShmRingReader(const string& name) :
+    name(name),
+    ring(nullptr),
+    restarting(false),
+    lastRead(0),
+    _missed(0),
+    _restarts(0)
+{
+    if (open()) lastRead = ring->published.load(memory_order_acquire);
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    close();
+}
+
+bool ShmRingReader::open()
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(ShmRing)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* memory = mmap(nullptr, sizeof(ShmRing), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    ring = static_cast<const ShmRing*>(memory);
+
+    // not (completely) initialized yet, an incompatible publisher, or a
+    // retired ring its publisher did not replace yet
+    if (ring->magic.load(memory_order_acquire) != SHM_RING_MAGIC
+        || ring->version != SHM_RING_VERSION
+        || ring->slots != SHM_RING_SLOTS
+        || ring->maxFaces != SHM_MAX_FACES
+        || ring->retired.load(memory_order_acquire)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ShmRingReader::close()
+{
+    if (ring) munmap(const_cast<ShmRing*>(ring), sizeof(ShmRing));
+    ring = nullptr;
+}
+
+bool ShmRingReader::followRestart()
+{
+    // the publisher retires the ring after its last frame: once 'retired' is
+    // seen, 'published' does not change anymore
+    if (ring && ring->retired.load(memory_order_acquire)
+        && ring->published.load(memory_order_acquire) <= lastRead) {
+        close();
+        restarting = true;
+    }
+
+    // tried again on each call, until the new publisher is there
+    if (restarting && open()) {
+        restarting = false;
+        lastRead = 0;
+        _restarts++;
+    }
+    return ring != nullptr;
+}
+
+bool ShmRingReader::read(uint64_t n, ShmFrame& frame) const
+{
+    const ShmSlot& slot = ring->slot[n % SHM_RING_SLOTS];
+
+    uint64_t before = slot.sequence.load(memory_order_acquire);
+    if (before != 2 * n + 2) return false;
+
+    memcpy(&frame, &slot.frame, sizeof(ShmFrame));
+
+    // the copy must be complete before checking the sequence again
+    atomic_thread_fence(memory_order_acquire);
+    return slot.sequence.load(memory_order_relaxed) == before;
+}
+
+ShmRingReader::Status ShmRingReader::next(ShmFrame& frame)
+{
+    if (!followRestart()) return NO_FRAME;
+
+    uint64_t published = ring->published.load(memory_order_acquire);
+    if (published <= lastRead) return NO_FRAME;
+
+    // the next frame is still there, unless the publisher is about to
+    // overwrite it
+    if (published - lastRead < SHM_RING_SLOTS && read(lastRead + 1, frame)) {
+        lastRead++;
+        return FRAME;
+    }
+
+    // lapped: jump to the most recent frame. It can only be overwritten
+    // after SHM_RING_SLOTS more frames, but try again if it happens.
+    while (true) {
+        published = ring->published.load(memory_order_acquire);
+        if (read(published, frame)) break;
+    }
+    _missed += published - lastRead - 1;
+    lastRead = published;
+    return OVERRUN;
+}
+
+bool ShmRingReader::latest(ShmFrame& frame)
+{
+    if (!followRestart()) return false;
+
+    while (true) {
+        uint64_t published = ring->published.load(memory_order_acquire);
+        if (published == 0) return false;
+        if (read(published, frame)) {
+            lastRead = max(lastRead, published);
+            return true;
+        }
+    }
+}
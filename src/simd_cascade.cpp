@@ -0,0 +1,743 @@
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/objdetect/objdetect.hpp> // groupRectangles
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+// SSE2 is always available on x86-64. AVX2 is only compiled for the functions
+// that need it, and selected at runtime.
+#define CASCADE_X86_SIMD
+#include <immintrin.h>
+#define CASCADE_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "simd_cascade.h"
+
+using namespace cv;
+using namespace std;
+
+// OpenCV subtracts this from the stage thresholds when loading a cascade
+static const float THRESHOLD_EPS = 1e-5f;
+
+// as OpenCV's CascadeClassifier
+static const double GROUP_EPS = 0.2;
+
+// LBP codes are 8 bits: the subsets of a LBP stump are 8 x 32 bits
+static const int LBP_SUBSET_SIZE = 8;
+
+SimdCascade::SimdCascade() :
+        simd(bestInstructionSet()),
+        featureType(HAAR_FEATURES),
+        compiledStep(0),
+        normArea(0),
+        sum(nullptr),
+        sqsum(nullptr)
+{
+}
+
+SimdCascade::SimdCascade(const string& filename) :
+        SimdCascade()
+{
+    load(filename);
+}
+
+void SimdCascade::setInstructionSet(InstructionSet set)
+{
+    simd = min(set, bestInstructionSet());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  Loading
+
+bool SimdCascade::load(const string& filename)
+{
+    stages.clear();
+    haarStumps.clear();
+    lbpStumps.clear();
+    compiledStep = 0;
+
+    FileStorage fs(filename, FileStorage::READ);
+    if (!fs.isOpened()) return false;
+
+    FileNode root = fs.getFirstTopLevelNode();
+
+    bool loaded = root["stageType"].empty() ? readOldFormat(root) : readNewFormat(root);
+
+    if (!loaded) stages.clear();
+    return loaded;
+}
+
+bool SimdCascade::readHaarFeature(const FileNode& feature, HaarStump& stump)
+{
+    if ((int) feature["tilted"] != 0) return false;
+
+    FileNode rects = feature["rects"];
+    if (rects.size() > 3) return false;
+
+    for (int r = 0; r < 3; r++) {
+        stump.rects[r] = Rect();
+        stump.weights[r] = 0.f;
+    }
+    for (size_t r = 0; r < rects.size(); r++) {
+        FileNode rect = rects[r];
+        stump.rects[r] = Rect((int) rect[0], (int) rect[1], (int) rect[2], (int) rect[3]);
+        stump.weights[r] = (float) rect[4];
+    }
+    return true;
+}
+
+bool SimdCascade::readOldFormat(const FileNode& root)
+{
+    FileNode size = root["size"];
+    FileNode stagesNode = root["stages"];
+    if (size.empty() || stagesNode.empty()) return false;
+
+    featureType = HAAR_FEATURES;
+    origWinSize = Size((int) size[0], (int) size[1]);
+
+    for (size_t s = 0; s < stagesNode.size(); s++) {
+        FileNode stageNode = stagesNode[s];
+        FileNode trees = stageNode["trees"];
+
+        Stage stage;
+        stage.first = haarStumps.size();
+        stage.ntrees = trees.size();
+        stage.threshold = (float) stageNode["stage_threshold"] - THRESHOLD_EPS;
+        stages.push_back(stage);
+
+        for (size_t t = 0; t < trees.size(); t++) {
+            // a stump is a tree with a single node
+            if (trees[t].size() != 1) return false;
+            FileNode node = trees[t][0];
+            FileNode feature = node["feature"];
+
+            if (node["left_val"].empty() || node["right_val"].empty()) return false;
+
+            HaarStump stump;
+            if (!readHaarFeature(feature, stump)) return false;
+            stump.threshold = (float) node["threshold"];
+            stump.left = (float) node["left_val"];
+            stump.right = (float) node["right_val"];
+
+            haarStumps.push_back(stump);
+        }
+    }
+
+    return !stages.empty();
+}
+
+bool SimdCascade::readNewFormat(const FileNode& root)
+{
+    if ((string) root["stageType"] != "BOOST") return false;
+
+    string type = (string) root["featureType"];
+    if (type == "HAAR") featureType = HAAR_FEATURES;
+    else if (type == "LBP") featureType = LBP_FEATURES;
+    else return false;
+
+    origWinSize = Size((int) root["width"], (int) root["height"]);
+
+    int ncategories = (int) root["featureParams"]["maxCatCount"];
+    int subsetSize = (ncategories + 31) / 32;
+    size_t nodeStep = 3 + (ncategories > 0 ? subsetSize : 1);
+
+    if (featureType == HAAR_FEATURES && ncategories != 0) return false;
+    if (featureType == LBP_FEATURES && subsetSize != LBP_SUBSET_SIZE) return false;
+
+    FileNode features = root["features"];
+    FileNode stagesNode = root["stages"];
+    if (features.empty() || stagesNode.empty()) return false;
+
+    for (size_t s = 0; s < stagesNode.size(); s++) {
+        FileNode stageNode = stagesNode[s];
+        FileNode weaks = stageNode["weakClassifiers"];
+
+        Stage stage;
+        stage.first = (featureType == HAAR_FEATURES) ? haarStumps.size() : lbpStumps.size();
+        stage.ntrees = weaks.size();
+        stage.threshold = (float) stageNode["stageThreshold"] - THRESHOLD_EPS;
+        stages.push_back(stage);
+
+        for (size_t w = 0; w < weaks.size(); w++) {
+            FileNode internalNodes = weaks[w]["internalNodes"];
+            FileNode leafValues = weaks[w]["leafValues"];
+
+            // only stumps: one node, two leaves
+            if (internalNodes.size() != nodeStep || leafValues.size() != 2) return false;
+
+            int left = (int) internalNodes[0];
+            int right = (int) internalNodes[1];
+            int featureIdx = (int) internalNodes[2];
+            if (left > 0 || right > 0 || left < -1 || right < -1) return false;
+            if (featureIdx < 0 || featureIdx >= (int) features.size()) return false;
+
+            FileNode feature = features[featureIdx];
+
+            if (featureType == HAAR_FEATURES) {
+                HaarStump stump;
+                if (!readHaarFeature(feature, stump)) return false;
+                stump.threshold = (float) internalNodes[3];
+                stump.left = (float) leafValues[-left];
+                stump.right = (float) leafValues[-right];
+
+                haarStumps.push_back(stump);
+            }
+            else {
+                FileNode rect = feature["rect"];
+
+                LbpStump stump;
+                stump.rect = Rect((int) rect[0], (int) rect[1], (int) rect[2], (int) rect[3]);
+                for (int i = 0; i < LBP_SUBSET_SIZE; i++) stump.subset[i] = (int) internalNodes[3 + i];
+                stump.left = (float) leafValues[-left];
+                stump.right = (float) leafValues[-right];
+
+                lbpStumps.push_back(stump);
+            }
+        }
+    }
+
+    return !stages.empty();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  Detection
+
+void SimdCascade::compile(int step)
+{
+    if (step == compiledStep) return;
+    compiledStep = step;
+
+    auto corners = [step](const Rect& r, int* c) {
+        c[0] = r.y * step + r.x;                            // top left
+        c[1] = r.y * step + r.x + r.width;                  // top right
+        c[2] = (r.y + r.height) * step + r.x;               // bottom left
+        c[3] = (r.y + r.height) * step + r.x + r.width;     // bottom right
+    };
+
+    // same normalization rectangle as OpenCV
+    Rect normRect(1, 1, origWinSize.width - 2, origWinSize.height - 2);
+    corners(normRect, normCorners);
+    normArea = normRect.area();
+
+    haarNodes.resize(haarStumps.size());
+    for (size_t i = 0; i < haarStumps.size(); i++) {
+        const HaarStump& stump = haarStumps[i];
+        HaarNode& node = haarNodes[i];
+
+        for (int r = 0; r < 3; r++) {
+            corners(stump.rects[r], node.corners + 4 * r);
+            node.weights[r] = stump.weights[r];
+        }
+        node.nrects = (stump.weights[2] != 0.f) ? 3 : 2;
+        node.threshold = stump.threshold;
+        node.left = stump.left;
+        node.right = stump.right;
+    }
+
+    // the 16 corners of the 3x3 blocks, row by row
+    lbpNodes.resize(lbpStumps.size());
+    for (size_t i = 0; i < lbpStumps.size(); i++) {
+        const LbpStump& stump = lbpStumps[i];
+        LbpNode& node = lbpNodes[i];
+
+        for (int row = 0; row < 4; row++)
+            for (int col = 0; col < 4; col++)
+                node.corners[row * 4 + col] = (stump.rect.y + row * stump.rect.height) * step
+                                              + stump.rect.x + col * stump.rect.width;
+
+        copy(stump.subset, stump.subset + LBP_SUBSET_SIZE, node.subset);
+        node.left = stump.left;
+        node.right = stump.right;
+    }
+}
+
+void SimdCascade::detectMultiScale(const Mat& image,
+                                   vector<Rect>& objects,
+                                   double scaleFactor,
+                                   int minNeighbors,
+                                   int flags,
+                                   Size minSize,
+                                   Size maxSize)
+{
+    CV_Assert(scaleFactor > 1 && image.depth() == CV_8U);
+
+    objects.clear();
+    if (empty()) return;
+
+    if (maxSize.height == 0 || maxSize.width == 0) maxSize = image.size();
+
+    Mat grayImage = image;
+    if (grayImage.channels() > 1) {
+        Mat temp;
+        cvtColor(grayImage, temp, COLOR_BGR2GRAY);
+        grayImage = temp;
+    }
+
+    imageBuffer.create(image.rows + 1, image.cols + 1, CV_8U);
+    sumBuffer.create(image.rows + 1, image.cols + 1, CV_32S);
+    if (featureType == HAAR_FEATURES) sqsumBuffer.create(image.rows + 1, image.cols + 1, CV_64F);
+
+    // the exact same pyramid as OpenCV
+    for (double factor = 1; ; factor *= scaleFactor) {
+
+        Size windowSize(cvRound(origWinSize.width * factor), cvRound(origWinSize.height * factor));
+        Size scaledImageSize(cvRound(grayImage.cols / factor), cvRound(grayImage.rows / factor));
+        Size processingRectSize(scaledImageSize.width - origWinSize.width,
+                                scaledImageSize.height - origWinSize.height);
+
+        if (processingRectSize.width <= 0 || processingRectSize.height <= 0) break;
+        if (windowSize.width > maxSize.width || windowSize.height > maxSize.height) break;
+        if (windowSize.width < minSize.width || windowSize.height < minSize.height) continue;
+
+        Mat scaledImage(scaledImageSize, CV_8U, imageBuffer.data);
+        resize(grayImage, scaledImage, scaledImageSize, 0, 0, INTER_LINEAR);
+
+        int yStep = factor > 2. ? 1 : 2;
+
+        detectSingleScale(scaledImage, processingRectSize, yStep, factor, objects);
+    }
+
+    groupRectangles(objects, minNeighbors, GROUP_EPS);
+
+    if ((flags & CASCADE_FIND_BIGGEST_OBJECT) && objects.size() > 1) {
+        auto biggest = max_element(objects.begin(), objects.end(),
+                                   [](const Rect& a, const Rect& b) {return a.area() < b.area();});
+        objects.assign(1, *biggest);
+    }
+}
+
+void SimdCascade::detectSingleScale(const Mat& scaledImage,
+                                    Size processingRectSize,
+                                    int yStep, double factor,
+                                    vector<Rect>& candidates)
+{
+    int rn = scaledImage.rows + 1, cn = scaledImage.cols + 1;
+
+    Mat sumMat(rn, cn, CV_32S, sumBuffer.data);
+    if (featureType == HAAR_FEATURES) {
+        Mat sqsumMat(rn, cn, CV_64F, sqsumBuffer.data);
+        integral(scaledImage, sumMat, sqsumMat);
+        sqsum = (const double*) sqsumMat.data;
+    }
+    else {
+        integral(scaledImage, sumMat);
+    }
+    sum = (const int*) sumMat.data;
+
+    evaluateWindows(cn, processingRectSize, yStep, factor, candidates);
+}
+
+void SimdCascade::evaluateWindows(int cn, Size processingRectSize,
+                                  int yStep, double factor,
+                                  vector<Rect>& candidates)
+{
+    compile(cn);
+
+    // all the windows of this scale
+    int windowsPerRow = (processingRectSize.width + yStep - 1) / yStep;
+
+    windows.clear();
+    for (int y = 0; y < processingRectSize.height; y += yStep)
+        for (int x = 0; x < processingRectSize.width; x += yStep)
+            windows.push_back(y * cn + x);
+
+    if (featureType == HAAR_FEATURES) {
+        norms.resize(windows.size());
+        const int* n = normCorners;
+        for (size_t w = 0; w < windows.size(); w++) {
+            int o = windows[w];
+            int valsum = sum[o + n[0]] - sum[o + n[1]] - sum[o + n[2]] + sum[o + n[3]];
+            double valsqsum = sqsum[o + n[0]] - sqsum[o + n[1]] - sqsum[o + n[2]] + sqsum[o + n[3]];
+
+            double nf = (double) normArea * valsqsum - (double) valsum * valsum;
+            nf = nf > 0. ? sqrt(nf) : 1.;
+            norms[w] = 1. / nf;
+        }
+    }
+
+    pass.resize(windows.size());
+
+    // First stage on every window. Like OpenCV, skip the next window of the
+    // row when a window is rejected by the first stage (this only costs a few
+    // wasted evaluations here, but must be replicated to get the same
+    // detections).
+    runStage(stages[0], windows.size());
+
+    size_t count = 0;
+    for (size_t row = 0; row < windows.size(); row += windowsPerRow) {
+        for (int i = 0; i < windowsPerRow; i++) {
+            size_t w = row + i;
+            if (!pass[w]) {i++; continue;}
+
+            windows[count] = windows[w];
+            if (featureType == HAAR_FEATURES) norms[count] = norms[w];
+            count++;
+        }
+    }
+
+    // next stages, on the survivors only
+    for (size_t s = 1; s < stages.size() && count > 0; s++) {
+        runStage(stages[s], count);
+
+        size_t kept = 0;
+        for (size_t w = 0; w < count; w++) {
+            if (!pass[w]) continue;
+            windows[kept] = windows[w];
+            if (featureType == HAAR_FEATURES) norms[kept] = norms[w];
+            kept++;
+        }
+        count = kept;
+    }
+
+    Size windowSize(cvRound(origWinSize.width * factor), cvRound(origWinSize.height * factor));
+    for (size_t w = 0; w < count; w++) {
+        int x = windows[w] % cn, y = windows[w] / cn;
+        candidates.push_back(Rect(cvRound(x * factor), cvRound(y * factor),
+                                  windowSize.width, windowSize.height));
+    }
+}
+
+void SimdCascade::runStage(const Stage& stage, size_t count)
+{
+    switch (simd) {
+#ifdef CASCADE_X86_SIMD
+    case AVX2:
+        if (featureType == HAAR_FEATURES) haarStageAvx2(stage, count);
+        else lbpStageAvx2(stage, count);
+        return;
+    case SSE2:
+        if (featureType == HAAR_FEATURES) haarStageSse2(stage, count);
+        else lbpStageSse2(stage, count);
+        return;
+#endif
+    default:
+        if (featureType == HAAR_FEATURES) haarStageScalar(stage, 0, count);
+        else lbpStageScalar(stage, 0, count);
+        return;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  Stage evaluation
+//
+//  All the code paths perform the same floating point operations as OpenCV,
+//  in the same order: the Haar features are computed in float, normalized
+//  and summed in double. Build with -ffp-contract=off, so that the compiler
+//  does not fuse them.
+
+static inline int rectSum(const int* sum, int offset, const int* c)
+{
+    return sum[offset + c[0]] - sum[offset + c[1]] - sum[offset + c[2]] + sum[offset + c[3]];
+}
+
+void SimdCascade::haarStageScalar(const Stage& stage, size_t begin, size_t end)
+{
+    const HaarNode* nodes = &haarNodes[stage.first];
+
+    for (size_t w = begin; w < end; w++) {
+        int offset = windows[w];
+        double stageSum = 0.;
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const HaarNode& node = nodes[t];
+
+            float feature = node.weights[0] * rectSum(sum, offset, node.corners)
+                            + node.weights[1] * rectSum(sum, offset, node.corners + 4);
+            if (node.nrects == 3) feature += node.weights[2] * rectSum(sum, offset, node.corners + 8);
+
+            double value = feature * norms[w];
+            stageSum += value < node.threshold ? node.left : node.right;
+        }
+
+        pass[w] = !(stageSum < stage.threshold);
+    }
+}
+
+static inline int lbpCode(const int* sum, int offset, const int* c)
+{
+    int p[16];
+    for (int i = 0; i < 16; i++) p[i] = sum[offset + c[i]];
+
+    auto block = [&p](int row, int col) {
+        int i = row * 4 + col;
+        return p[i] - p[i + 1] - p[i + 4] + p[i + 5];
+    };
+
+    // clockwise, starting from the top left block
+    int center = block(1, 1);
+    return (block(0, 0) >= center ? 128 : 0)
+         | (block(0, 1) >= center ? 64 : 0)
+         | (block(0, 2) >= center ? 32 : 0)
+         | (block(1, 2) >= center ? 16 : 0)
+         | (block(2, 2) >= center ? 8 : 0)
+         | (block(2, 1) >= center ? 4 : 0)
+         | (block(2, 0) >= center ? 2 : 0)
+         | (block(1, 0) >= center ? 1 : 0);
+}
+
+void SimdCascade::lbpStageScalar(const Stage& stage, size_t begin, size_t end)
+{
+    const LbpNode* nodes = &lbpNodes[stage.first];
+
+    for (size_t w = begin; w < end; w++) {
+        int offset = windows[w];
+        double stageSum = 0.;
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const LbpNode& node = nodes[t];
+            int c = lbpCode(sum, offset, node.corners);
+            stageSum += (node.subset[c >> 5] & (1 << (c & 31))) ? node.left : node.right;
+        }
+
+        pass[w] = !(stageSum < stage.threshold);
+    }
+}
+
+#ifdef CASCADE_X86_SIMD
+
+/////////////////////////////////////////////////////////////////////////////
+//  SSE2: 4 windows at a time. No gather: the integral image is read with
+//  scalar loads, everything else is vectorized.
+
+static inline __m128i loadCornerSse2(const int* sum, const int* offsets, int corner)
+{
+    return _mm_setr_epi32(sum[offsets[0] + corner], sum[offsets[1] + corner],
+                          sum[offsets[2] + corner], sum[offsets[3] + corner]);
+}
+
+static inline __m128 rectSumSse2(const int* sum, const int* offsets, const int* c)
+{
+    __m128i s = _mm_sub_epi32(loadCornerSse2(sum, offsets, c[0]), loadCornerSse2(sum, offsets, c[1]));
+    s = _mm_sub_epi32(s, loadCornerSse2(sum, offsets, c[2]));
+    s = _mm_add_epi32(s, loadCornerSse2(sum, offsets, c[3]));
+    return _mm_cvtepi32_ps(s);
+}
+
+static inline __m128d selectSse2(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+void SimdCascade::haarStageSse2(const Stage& stage, size_t count)
+{
+    const HaarNode* nodes = &haarNodes[stage.first];
+    const __m128d stageThreshold = _mm_set1_pd(stage.threshold);
+
+    size_t w = 0;
+    for (; w + 4 <= count; w += 4) {
+        const int* offsets = &windows[w];
+        __m128d normLo = _mm_loadu_pd(&norms[w]), normHi = _mm_loadu_pd(&norms[w + 2]);
+        __m128d sumLo = _mm_setzero_pd(), sumHi = _mm_setzero_pd();
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const HaarNode& node = nodes[t];
+
+            __m128 feature = _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(node.weights[0]), rectSumSse2(sum, offsets, node.corners)),
+                    _mm_mul_ps(_mm_set1_ps(node.weights[1]), rectSumSse2(sum, offsets, node.corners + 4)));
+            if (node.nrects == 3) {
+                feature = _mm_add_ps(feature,
+                    _mm_mul_ps(_mm_set1_ps(node.weights[2]), rectSumSse2(sum, offsets, node.corners + 8)));
+            }
+
+            __m128d valueLo = _mm_mul_pd(_mm_cvtps_pd(feature), normLo);
+            __m128d valueHi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(feature, feature)), normHi);
+
+            __m128d threshold = _mm_set1_pd(node.threshold);
+            __m128d left = _mm_set1_pd(node.left), right = _mm_set1_pd(node.right);
+
+            sumLo = _mm_add_pd(sumLo, selectSse2(_mm_cmplt_pd(valueLo, threshold), left, right));
+            sumHi = _mm_add_pd(sumHi, selectSse2(_mm_cmplt_pd(valueHi, threshold), left, right));
+        }
+
+        int rejected = _mm_movemask_pd(_mm_cmplt_pd(sumLo, stageThreshold))
+                     | _mm_movemask_pd(_mm_cmplt_pd(sumHi, stageThreshold)) << 2;
+        for (int i = 0; i < 4; i++) pass[w + i] = !(rejected & (1 << i));
+    }
+
+    haarStageScalar(stage, w, count);
+}
+
+void SimdCascade::lbpStageSse2(const Stage& stage, size_t count)
+{
+    const LbpNode* nodes = &lbpNodes[stage.first];
+    const __m128d stageThreshold = _mm_set1_pd(stage.threshold);
+
+    alignas(16) int codes[4];
+    alignas(16) double leaves[4];
+
+    size_t w = 0;
+    for (; w + 4 <= count; w += 4) {
+        const int* offsets = &windows[w];
+        __m128d sumLo = _mm_setzero_pd(), sumHi = _mm_setzero_pd();
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const LbpNode& node = nodes[t];
+
+            __m128i p[16];
+            for (int i = 0; i < 16; i++) p[i] = loadCornerSse2(sum, offsets, node.corners[i]);
+
+            auto block = [&p](int row, int col) {
+                int i = row * 4 + col;
+                return _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(p[i], p[i + 1]), p[i + 4]), p[i + 5]);
+            };
+            __m128i center = block(1, 1);
+            // (block >= center) ? bit : 0
+            auto bit = [&center](__m128i b, int value) {
+                return _mm_andnot_si128(_mm_cmpgt_epi32(center, b), _mm_set1_epi32(value));
+            };
+
+            __m128i code = _mm_or_si128(_mm_or_si128(_mm_or_si128(bit(block(0, 0), 128), bit(block(0, 1), 64)),
+                                                     _mm_or_si128(bit(block(0, 2), 32), bit(block(1, 2), 16))),
+                                        _mm_or_si128(_mm_or_si128(bit(block(2, 2), 8), bit(block(2, 1), 4)),
+                                                     _mm_or_si128(bit(block(2, 0), 2), bit(block(1, 0), 1))));
+            _mm_store_si128((__m128i*) codes, code);
+
+            for (int i = 0; i < 4; i++) {
+                int c = codes[i];
+                leaves[i] = (node.subset[c >> 5] & (1 << (c & 31))) ? node.left : node.right;
+            }
+            sumLo = _mm_add_pd(sumLo, _mm_load_pd(leaves));
+            sumHi = _mm_add_pd(sumHi, _mm_load_pd(leaves + 2));
+        }
+
+        int rejected = _mm_movemask_pd(_mm_cmplt_pd(sumLo, stageThreshold))
+                     | _mm_movemask_pd(_mm_cmplt_pd(sumHi, stageThreshold)) << 2;
+        for (int i = 0; i < 4; i++) pass[w + i] = !(rejected & (1 << i));
+    }
+
+    lbpStageScalar(stage, w, count);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  AVX2: 8 windows at a time, the integral image is read with gathers.
+
+CASCADE_AVX2
+static inline __m256i loadCornerAvx2(const int* sum, __m256i offsets, int corner)
+{
+    return _mm256_i32gather_epi32(sum + corner, offsets, 4);
+}
+
+CASCADE_AVX2
+static inline __m256 rectSumAvx2(const int* sum, __m256i offsets, const int* c)
+{
+    __m256i s = _mm256_sub_epi32(loadCornerAvx2(sum, offsets, c[0]), loadCornerAvx2(sum, offsets, c[1]));
+    s = _mm256_sub_epi32(s, loadCornerAvx2(sum, offsets, c[2]));
+    s = _mm256_add_epi32(s, loadCornerAvx2(sum, offsets, c[3]));
+    return _mm256_cvtepi32_ps(s);
+}
+
+CASCADE_AVX2
+static inline __m256i blockAvx2(const __m256i* p, int row, int col)
+{
+    int i = row * 4 + col;
+    return _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(p[i], p[i + 1]), p[i + 4]), p[i + 5]);
+}
+
+// (block >= center) ? value : 0
+CASCADE_AVX2
+static inline __m256i lbpBitAvx2(const __m256i* p, int row, int col, __m256i center, int value)
+{
+    return _mm256_andnot_si256(_mm256_cmpgt_epi32(center, blockAvx2(p, row, col)), _mm256_set1_epi32(value));
+}
+
+CASCADE_AVX2
+static inline __m256i lbpCodeAvx2(const __m256i* p)
+{
+    __m256i center = blockAvx2(p, 1, 1);
+
+    return _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(lbpBitAvx2(p, 0, 0, center, 128), lbpBitAvx2(p, 0, 1, center, 64)),
+                                           _mm256_or_si256(lbpBitAvx2(p, 0, 2, center, 32), lbpBitAvx2(p, 1, 2, center, 16))),
+                           _mm256_or_si256(_mm256_or_si256(lbpBitAvx2(p, 2, 2, center, 8), lbpBitAvx2(p, 2, 1, center, 4)),
+                                           _mm256_or_si256(lbpBitAvx2(p, 2, 0, center, 2), lbpBitAvx2(p, 1, 0, center, 1))));
+}
+
+CASCADE_AVX2
+static inline int rejectedAvx2(__m256d sumLo, __m256d sumHi, __m256d threshold)
+{
+    return _mm256_movemask_pd(_mm256_cmp_pd(sumLo, threshold, _CMP_LT_OQ))
+         | _mm256_movemask_pd(_mm256_cmp_pd(sumHi, threshold, _CMP_LT_OQ)) << 4;
+}
+
+CASCADE_AVX2
+void SimdCascade::haarStageAvx2(const Stage& stage, size_t count)
+{
+    const HaarNode* nodes = &haarNodes[stage.first];
+    const __m256d stageThreshold = _mm256_set1_pd(stage.threshold);
+
+    size_t w = 0;
+    for (; w + 8 <= count; w += 8) {
+        __m256i offsets = _mm256_loadu_si256((const __m256i*) &windows[w]);
+        __m256d normLo = _mm256_loadu_pd(&norms[w]), normHi = _mm256_loadu_pd(&norms[w + 4]);
+        __m256d sumLo = _mm256_setzero_pd(), sumHi = _mm256_setzero_pd();
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const HaarNode& node = nodes[t];
+
+            __m256 feature = _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(node.weights[0]), rectSumAvx2(sum, offsets, node.corners)),
+                    _mm256_mul_ps(_mm256_set1_ps(node.weights[1]), rectSumAvx2(sum, offsets, node.corners + 4)));
+            if (node.nrects == 3) {
+                feature = _mm256_add_ps(feature,
+                    _mm256_mul_ps(_mm256_set1_ps(node.weights[2]), rectSumAvx2(sum, offsets, node.corners + 8)));
+            }
+
+            __m256d valueLo = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(feature)), normLo);
+            __m256d valueHi = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(feature, 1)), normHi);
+
+            __m256d threshold = _mm256_set1_pd(node.threshold);
+            __m256d left = _mm256_set1_pd(node.left), right = _mm256_set1_pd(node.right);
+
+            sumLo = _mm256_add_pd(sumLo, _mm256_blendv_pd(right, left, _mm256_cmp_pd(valueLo, threshold, _CMP_LT_OQ)));
+            sumHi = _mm256_add_pd(sumHi, _mm256_blendv_pd(right, left, _mm256_cmp_pd(valueHi, threshold, _CMP_LT_OQ)));
+        }
+
+        int rejected = rejectedAvx2(sumLo, sumHi, stageThreshold);
+        for (int i = 0; i < 8; i++) pass[w + i] = !(rejected & (1 << i));
+    }
+
+    haarStageScalar(stage, w, count);
+}
+
+CASCADE_AVX2
+void SimdCascade::lbpStageAvx2(const Stage& stage, size_t count)
+{
+    const LbpNode* nodes = &lbpNodes[stage.first];
+    const __m256d stageThreshold = _mm256_set1_pd(stage.threshold);
+    const __m256i one = _mm256_set1_epi32(1), low5 = _mm256_set1_epi32(31);
+
+    size_t w = 0;
+    for (; w + 8 <= count; w += 8) {
+        __m256i offsets = _mm256_loadu_si256((const __m256i*) &windows[w]);
+        __m256d sumLo = _mm256_setzero_pd(), sumHi = _mm256_setzero_pd();
+
+        for (int t = 0; t < stage.ntrees; t++) {
+            const LbpNode& node = nodes[t];
+
+            __m256i p[16];
+            for (int i = 0; i < 16; i++) p[i] = loadCornerAvx2(sum, offsets, node.corners[i]);
+
+            __m256i code = lbpCodeAvx2(p);
+
+            // subset[code >> 5] & (1 << (code & 31))
+            __m256i words = _mm256_i32gather_epi32(node.subset, _mm256_srli_epi32(code, 5), 4);
+            __m256i bits = _mm256_sllv_epi32(one, _mm256_and_si256(code, low5));
+            __m256i toRight = _mm256_cmpeq_epi32(_mm256_and_si256(words, bits), _mm256_setzero_si256());
+
+            __m256d toRightLo = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(toRight)));
+            __m256d toRightHi = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(toRight, 1)));
+
+            __m256d left = _mm256_set1_pd(node.left), right = _mm256_set1_pd(node.right);
+            sumLo = _mm256_add_pd(sumLo, _mm256_blendv_pd(left, right, toRightLo));
+            sumHi = _mm256_add_pd(sumHi, _mm256_blendv_pd(left, right, toRightHi));
+        }
+
+        int rejected = rejectedAvx2(sumLo, sumHi, stageThreshold);
+        for (int i = 0; i < 8; i++) pass[w + i] = !(rejected & (1 << i));
+    }
+
+    lbpStageScalar(stage, w, count);
+}
+
+#endif // CASCADE_X86_SIMD
@@ -0,0 +1,174 @@
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tracing.h"
+#include "logging.h"
+
+using namespace std;
+
+namespace {
+
+struct Event {
+    const char* name;
+    int64_t begin;
+    int64_t end;
+    long frame;
+    int track;
+};
+
+/** The spans of a thread. Only that thread writes to it: stopTracing() reads
+ * the 'count' first events.
+ */
+struct ThreadBuffer {
+    ThreadBuffer(unsigned int tid) :
+        tid(tid),
+        events(new Event[TRACE_EVENTS_PER_THREAD]),
+        session(0),
+        count(0) {}
+
+    unsigned int tid;
+    unique_ptr<Event[]> events;
+    // the session the events belong to
+    atomic<unsigned int> session;
+    atomic<size_t> count;
+};
+
+/** The buffers of all the threads that ever recorded a span. They are never
+ * freed: a thread may still be recording a span when the session stops, or
+ * when it exits.
+ */
+struct Registry {
+    Registry() : session(0), start(0), dropped(0) {}
+
+    mutex lock;
+    vector<unique_ptr<ThreadBuffer>> buffers;
+
+    atomic<unsigned int> session;
+    string path;
+    int64_t start;
+    atomic<size_t> dropped;
+};
+
+Registry& registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer* createBuffer()
+{
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.lock);
+    r.buffers.emplace_back(new ThreadBuffer(r.buffers.size() + 1));
+    return r.buffers.back().get();
+}
+
+}
+
+namespace tracing {
+
+atomic<bool> enabled(false);
+
+Context& context()
+{
+    static thread_local Context context{-1, -1};
+    return context;
+}
+
+void record(const char* name, int64_t begin, int64_t end, const Context& context)
+{
+    if (!threadBuffer) threadBuffer = createBuffer();
+    ThreadBuffer& buffer = *threadBuffer;
+
+    // the first span of this thread in a new session: forget the old ones
+    unsigned int session = registry().session.load(memory_order_acquire);
+    if (buffer.session.load(memory_order_relaxed) != session) {
+        buffer.count.store(0, memory_order_relaxed);
+        buffer.session.store(session, memory_order_release);
+    }
+
+    size_t n = buffer.count.load(memory_order_relaxed);
+    if (n == TRACE_EVENTS_PER_THREAD) {
+        registry().dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[n] = Event{name, begin, end, context.frame, context.track};
+    buffer.count.store(n + 1, memory_order_release);
+}
+
+} // namespace tracing
+
+void startTracing(const string& path)
+{
+    Registry& r = registry();
+    {
+        lock_guard<mutex> lock(r.lock);
+        r.path = path;
+        r.start = tracing::now();
+        r.dropped = 0;
+        r.session++;
+    }
+    tracing::enabled.store(true, memory_order_release);
+}
+
+bool stopTracing()
+{
+    if (!tracing::enabled.exchange(false)) return false;
+
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.lock);
+
+    FILE* file = fopen(r.path.c_str(), "w");
+    if (!file) {
+        FT_LOG_ERROR("Could not write the trace to " << r.path);
+        return false;
+    }
+
+    unsigned int session = r.session.load();
+    size_t spans = 0;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    for (const auto& buffer : r.buffers) {
+        if (buffer->session.load(memory_order_acquire) != session) continue;
+
+        size_t count = buffer->count.load(memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[i];
+
+            // complete events, in microseconds since the start of the session
+            fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"facetracking\", \"ph\": \"X\", "
+                          "\"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {",
+                    first ? "" : ",\n", event.name, buffer->tid,
+                    (event.begin - r.start) / 1000., (event.end - event.begin) / 1000.);
+            if (event.frame >= 0) fprintf(file, "\"frame\": %ld", event.frame);
+            if (event.track >= 0) {
+                fprintf(file, "%s\"track\": %d", event.frame >= 0 ? ", " : "", event.track);
+            }
+            fprintf(file, "}}");
+            first = false;
+        }
+        spans += count;
+    }
+    fprintf(file, "\n]}\n");
+
+    bool written = fclose(file) == 0;
+    if (!written) {
+        FT_LOG_ERROR("Could not write the trace to " << r.path);
+        return false;
+    }
+
+    FT_LOG_INFO("Wrote " << spans << " spans to " << r.path << " ("
+             << r.dropped.load() << " dropped)");
+    return true;
+}
+
+size_t droppedSpans()
+{
+    return registry().dropped.load();
+}
@@ -0,0 +1,108 @@
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "track_log.h"
+
+using namespace std;
+
+static const string UNKNOWN_NAME = "";
+
+TrackLogReader::TrackLogReader(const string& path) :
+    memory(nullptr),
+    size(0),
+    records(nullptr),
+    nbRecords(0),
+    nbFaces(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(TrackLogHeader)) {
+        close(fd);
+        return;
+    }
+    size = info.st_size;
+
+    memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        return;
+    }
+
+    const TrackLogHeader* header = static_cast<const TrackLogHeader*>(memory);
+    if (header->magic != TRACK_LOG_MAGIC
+        || header->version != TRACK_LOG_VERSION
+        || header->recordSize != sizeof(TrackLogRecord)) {
+        munmap(memory, size);
+        memory = nullptr;
+        return;
+    }
+
+    // an incomplete last record (the writer was interrupted) is ignored
+    records = reinterpret_cast<const TrackLogRecord*>(static_cast<const char*>(memory)
+                                                      + sizeof(TrackLogHeader));
+    nbRecords = (size - sizeof(TrackLogHeader)) / sizeof(TrackLogRecord);
+
+    for (size_t i = 0; i < nbRecords; i++) {
+        const TrackLogRecord& record = records[i];
+
+        if (record.kind == TRACK_LOG_NAME) {
+            if (record.name.index >= names.size()) names.resize(record.name.index + 1);
+            names[record.name.index].assign(record.name.name,
+                                            strnlen(record.name.name, TRACK_LOG_NAME_SIZE));
+        }
+        else if (record.kind == TRACK_LOG_FACE) {
+            trackRecords[record.track].push_back(i);
+            nbFaces++;
+        }
+    }
+}
+
+TrackLogReader::~TrackLogReader()
+{
+    if (memory) munmap(memory, size);
+}
+
+void TrackLogReader::frame(uint64_t n, vector<const TrackLogRecord*>& faces) const
+{
+    faces.clear();
+
+    // the records are sorted by frame (NAME records included)
+    const TrackLogRecord* first = lower_bound(begin(), end(), n,
+                                              [](const TrackLogRecord& record, uint64_t frame) {
+                                                  return record.frame < frame;});
+
+    for (const TrackLogRecord* record = first; record != end() && record->frame == n; ++record) {
+        if (record->kind == TRACK_LOG_FACE) faces.push_back(record);
+    }
+}
+
+void TrackLogReader::track(uint32_t id, vector<const TrackLogRecord*>& faces) const
+{
+    faces.clear();
+
+    auto found = trackRecords.find(id);
+    if (found == trackRecords.end()) return;
+
+    for (auto index : found->second) faces.push_back(&records[index]);
+}
+
+vector<uint32_t> TrackLogReader::tracks() const
+{
+    vector<uint32_t> ids;
+    for (const auto& track : trackRecords) ids.push_back(track.first);
+    return ids;
+}
+
+const string& TrackLogReader::name(const TrackLogRecord& face) const
+{
+    if (face.face.name >= names.size()) return UNKNOWN_NAME;
+    return names[face.face.name];
+}
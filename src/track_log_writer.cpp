@@ -0,0 +1,129 @@
+#include <cerrno>
+#include <cstring>
+
+#include "track_log_writer.h"
+#include "logging.h"
+
+using namespace cv;
+using namespace std;
+
+TrackLogWriter::TrackLogWriter(const string& path) :
+    path(path),
+    file(fopen(path.c_str(), "wb")),
+    lastFlush(chrono::steady_clock::now()),
+    queue(TRACK_LOG_QUEUE, BLOCK)
+{
+    if (!file) {
+        FT_LOG_ERROR("Could not open the track log " << path << ": " << strerror(errno));
+        return;
+    }
+
+    // the batches are written in one go
+    setvbuf(file, nullptr, _IOFBF, TRACK_LOG_BATCH * sizeof(TrackLogRecord));
+
+    TrackLogHeader header{TRACK_LOG_MAGIC, TRACK_LOG_VERSION, sizeof(TrackLogRecord), 0};
+    fwrite(&header, sizeof(header), 1, file);
+
+    batch.reserve(TRACK_LOG_BATCH);
+    writer = thread(&TrackLogWriter::run, this);
+}
+
+TrackLogWriter::~TrackLogWriter()
+{
+    if (!file) return;
+
+    flush();
+    queue.close();
+    writer.join();
+
+    if (fclose(file) != 0) {
+        FT_LOG_ERROR("Could not write the track log " << path << ": " << strerror(errno));
+    }
+}
+
+uint32_t TrackLogWriter::nameIndex(const string& name, uint64_t frame, int64_t timestamp,
+                                   int64_t stamp)
+{
+    auto known = names.find(name);
+    if (known != names.end()) return known->second;
+
+    uint32_t index = names.size();
+    names[name] = index;
+
+    TrackLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.frame = frame;
+    record.timestamp = timestamp;
+    record.stamp = stamp;
+    record.kind = TRACK_LOG_NAME;
+    record.name.index = index;
+    strncpy(record.name.name, name.c_str(), TRACK_LOG_NAME_SIZE - 1);
+    batch.push_back(record);
+
+    return index;
+}
+
+void TrackLogWriter::log(const TrackingSnapshot& snapshot, int64_t stamp)
+{
+    if (!file) return;
+
+    int64_t timestamp = chrono::duration_cast<chrono::nanoseconds>(
+                            snapshot.timestamp.time_since_epoch()).count();
+
+    for (const auto& track : snapshot.tracks) {
+        uint32_t name = nameIndex(track.name, snapshot.frame, timestamp, stamp);
+
+        TrackLogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.frame = snapshot.frame;
+        record.timestamp = timestamp;
+        record.stamp = stamp;
+        record.kind = TRACK_LOG_FACE;
+        record.track = track.id;
+
+        TrackLogFace& face = record.face;
+        face.name = name;
+        face.x = track.boundingbox.x;
+        face.y = track.boundingbox.y;
+        face.width = track.boundingbox.width;
+        face.height = track.boundingbox.height;
+        face.mode = track.mode;
+        face.identity = track.identity;
+        // the last row of the pose is always (0, 0, 0, 1)
+        for (int i = 0; i < 12; i++) face.pose[i] = track.pose.val[i];
+
+        batch.push_back(record);
+    }
+
+    if (batch.size() >= TRACK_LOG_BATCH
+        || snapshot.timestamp - lastFlush >= TRACK_LOG_FLUSH_INTERVAL) {
+        flush();
+        lastFlush = snapshot.timestamp;
+    }
+}
+
+void TrackLogWriter::flush()
+{
+    if (!file || batch.empty()) return;
+
+    // gets a batch already written in exchange
+    queue.push(batch);
+    batch.clear();
+}
+
+void TrackLogWriter::run()
+{
+    vector<TrackLogRecord> records;
+    bool failed = false;
+
+    while (queue.pop(records)) {
+        size_t written = fwrite(records.data(), sizeof(TrackLogRecord), records.size(), file);
+        // reported once (eg the disk is full)
+        if (written != records.size() && !failed) {
+            FT_LOG_ERROR("Could not write the track log " << path << ": " << strerror(errno));
+            failed = true;
+        }
+        // the readers see whole batches
+        fflush(file);
+    }
+}
@@ -0,0 +1,95 @@
+#include <cstdlib> // strtoull
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "track_log.h"
+
+using namespace std;
+
+// Queries a binary track log (see track_log.h), and converts it to CSV.
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s <log> info          summary of the log\n"
+                    "       %s <log> csv           all the faces, as CSV\n"
+                    "       %s <log> frame <n>     the faces of frame n, as CSV\n"
+                    "       %s <log> track <id>    the faces of a track, as CSV\n",
+            program, program, program, program);
+}
+
+static void printHeader()
+{
+    printf("frame,timestamp,stamp,id,name,mode,x,y,width,height,pose_x,pose_y,pose_z\n");
+}
+
+static void print(const TrackLogReader& log, const TrackLogRecord& record)
+{
+    const TrackLogFace& face = record.face;
+    const char* mode = face.mode < 4 ? TRACK_LOG_MODES[face.mode] : "?";
+
+    // the translation is the last column of the first 3 rows of the pose
+    printf("%llu,%lld,%lld,%u,%s,%s,%d,%d,%d,%d,%g,%g,%g\n",
+           (unsigned long long) record.frame, (long long) record.timestamp,
+           (long long) record.stamp, record.track, log.name(record).c_str(), mode,
+           face.x, face.y, face.width, face.height,
+           face.pose[3], face.pose[7], face.pose[11]);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TrackLogReader log(argv[1]);
+    if (!log.isOpen()) {
+        fprintf(stderr, "%s is not a track log (or can not be read)\n", argv[1]);
+        return 1;
+    }
+
+    string command = argv[2];
+    vector<const TrackLogRecord*> faces;
+
+    if (command == "info") {
+        size_t records = log.end() - log.begin();
+        printf("%zu records: %zu faces, %zu names\n", records, log.faces(), records - log.faces());
+        printf("%zu tracks\n", log.tracks().size());
+
+        // the first and last FACE records
+        const TrackLogRecord *first = nullptr, *last = nullptr;
+        for (const TrackLogRecord* record = log.begin(); record != log.end(); ++record) {
+            if (record->kind != TRACK_LOG_FACE) continue;
+            if (!first) first = record;
+            last = record;
+        }
+        if (first) {
+            printf("frames %llu to %llu, over %.1fs\n",
+                   (unsigned long long) first->frame, (unsigned long long) last->frame,
+                   (last->timestamp - first->timestamp) / 1e9);
+        }
+    }
+    else if (command == "csv") {
+        printHeader();
+        for (const TrackLogRecord* record = log.begin(); record != log.end(); ++record) {
+            if (record->kind == TRACK_LOG_FACE) print(log, *record);
+        }
+    }
+    else if (command == "frame" && argc > 3) {
+        log.frame(strtoull(argv[3], nullptr, 10), faces);
+        printHeader();
+        for (auto face : faces) print(log, *face);
+    }
+    else if (command == "track" && argc > 3) {
+        log.track(strtoul(argv[3], nullptr, 10), faces);
+        printHeader();
+        for (auto face : faces) print(log, *face);
+    }
+    else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <cerrno>
+
+// include log4cxx header files.
+#include "log4cxx/logger.h"
+#include "log4cxx/basicconfigurator.h"
+
+
+#include "facetracking.h"
+
+using namespace cv;
+using namespace std;
+using namespace log4cxx;
+
+LoggerPtr logger(Logger::getLogger("facetracking"));
+
+const static string test1 = "single_user_static_camera.avi";
+
+// Heap allocations are only counted on the tracking thread, while it is in
+// FaceTracking::track(): the recognition worker allocates on its own.
+static thread_local bool counting = false;
+static size_t allocations = 0;
+
+// The C allocator is interposed, rather than operator new: operator new ends
+// up in malloc() too, and so do cv::Mat buffers (cv::fastMalloc). The
+// __libc_* entry points are glibc's own.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size)
+{
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    if (counting) allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size)
+{
+    if (counting) allocations++;
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    if (counting) allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size)
+{
+    *p = memalign(alignment, size);
+    return *p ? 0 : ENOMEM;
+}
+
+}
+
+/** Replays the test video, and checks that the frames where no detector runs
+ * do not allocate, once the tracking is warmed up: neither objects, nor
+ * cv::Mat buffers (eg a face crop copied into a buffer too small for it).
+ */
+int main(int argc, char *argv[])
+{
+    // Set up a simple configuration that logs on the console.
+    BasicConfigurator::configure();
+
+    cv::VideoCapture videoCapture(test1);
+    if (!videoCapture.isOpened())
+    {
+        LOG4CXX_ERROR(logger, "Unable to initialise video capture.");
+        return 1;
+    }
+
+    FaceTracking facetracking;
+
+    Mat cameraImage, inputImage;
+
+    unsigned int frames = 0, checkedFrames = 0, allocatingFrames = 0;
+    size_t total = 0;
+
+    while(videoCapture.read(cameraImage)) {
+
+        cvtColor(cameraImage, inputImage, cv::COLOR_BGR2GRAY);
+
+        allocations = 0;
+        counting = true;
+        facetracking.track(inputImage);
+        counting = false;
+        frames++;
+
+        // let the frame size, the tracks and the queues settle first
+        if (frames <= 2 * FRAMES_BETWEEN_DETECTION || facetracking.detectorRan()) continue;
+
+        checkedFrames++;
+        if (allocations > 0) {
+            allocatingFrames++;
+            total += allocations;
+        }
+    }
+
+    videoCapture.release();
+
+    LOG4CXX_INFO(logger, checkedFrames << " frames without detection checked, "
+                         << allocatingFrames << " of them allocated ("
+                         << total << " allocations)");
+
+    return (checkedFrames > 0 && allocatingFrames == 0) ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+
+#include "batch.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Stitches the tracks of two synthetic chunks: the faces present on both
+// sides of the boundary must keep their ids and names, the new ones must get
+// new ids, and the names given by the recognizer of a chunk must be mapped to
+// the global names.
+//
+// Then tracks the test video in chunks, with videos that seek to the previous
+// keyframe, lose their position, or can not seek at all: the faces must be
+// the same as when seeking exactly (or as tracking the video sequentially).
+// And with containers that misestimate the nb of frames: all the frames must
+// be tracked, and no more.
+
+static const unsigned long BOUNDARY = 100;
+static const unsigned long OVERLAP = 20;
+static const unsigned long END = 200;
+
+const static string test1 = "single_user_static_camera.avi";
+
+// chunks of the test video: small enough to get a few of them
+static const unsigned int CHUNK_FRAMES = 100;
+static const unsigned int OVERLAP_FRAMES = 10;
+// frames between two keyframes of the simulated codec
+static const unsigned long KEYFRAME_INTERVAL = 30;
+// past that frame, the simulated codec does not know where it is
+static const unsigned long LOST_AFTER = 150;
+
+// a face moving to the right, and a static one
+static Rect moving(unsigned long frame) {return Rect(10 + frame, 50, 60, 60);}
+static Rect still(unsigned long frame) {return Rect(400, 100, 80, 80);}
+
+static Face face(unsigned int id, const string& name, const Rect& box)
+{
+    return Face(id, name, box, Matx44d::eye());
+}
+
+/** Simulates the seeking of various codecs.
+ */
+class SimulatedSeeking : public BatchTracking {
+
+public:
+    enum Codec {
+        KEYFRAMES,  // lands on the previous keyframe
+        LOST,       // does not know where it lands, past LOST_AFTER
+        UNSEEKABLE  // does not move
+    };
+
+    SimulatedSeeking(const BatchParameters& params, Codec codec) :
+        BatchTracking(params), codec(codec), seeks(0) {}
+
+    Codec codec;
+    // nb of seeks past the first frame
+    mutable atomic<int> seeks;
+
+protected:
+    long seek(VideoCapture& capture, unsigned long frame) const {
+        if (frame > 0) seeks++;
+
+        switch (codec) {
+        case KEYFRAMES:
+            return BatchTracking::seek(capture, frame - frame % KEYFRAME_INTERVAL);
+        case LOST:
+            BatchTracking::seek(capture, frame);
+            return frame < LOST_AFTER ? (long) frame : -1;
+        case UNSEEKABLE:
+            break;
+        }
+        return 0;
+    }
+};
+
+/** Simulates a container that misestimates the nb of frames.
+ */
+class WrongFrameCount : public BatchTracking {
+
+public:
+    WrongFrameCount(const BatchParameters& params, double error) :
+        BatchTracking(params), error(error) {}
+
+    double error;
+
+protected:
+    unsigned long frameCount(VideoCapture& capture) const {
+        return (unsigned long) (BatchTracking::frameCount(capture) * error);
+    }
+};
+
+static bool sameFaces(const vector<Face>& a, const vector<Face>& b, bool compareIds)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].boundingbox() != b[i].boundingbox()) return false;
+        if (compareIds && a[i].id() != b[i].id()) return false;
+    }
+    return true;
+}
+
+/** Returns the nb of frames where 'faces' differ from 'expected'.
+ */
+static int mismatches(const vector<vector<Face>>& faces, const vector<vector<Face>>& expected,
+                      bool compareIds)
+{
+    if (faces.size() != expected.size()) return max(faces.size(), expected.size());
+
+    int frames = 0;
+    for (size_t f = 0; f < faces.size(); f++) {
+        if (!sameFaces(faces[f], expected[f], compareIds)) frames++;
+    }
+    return frames;
+}
+
+static void testSeeking()
+{
+    BatchParameters params;
+    params.chunkFrames = CHUNK_FRAMES;
+    params.overlapFrames = OVERLAP_FRAMES;
+    // without training, the recognizer never identifies anyone: the results
+    // do not depend on when its answers come back
+    params.tracking.trainingBudget = 0;
+
+    // the reference: a sequential run...
+    vector<vector<Face>> sequential;
+    {
+        VideoCapture videoCapture(test1);
+        FaceTracking tracking(params.tracking);
+        Mat cameraImage, gray;
+        while (videoCapture.read(cameraImage)) {
+            cvtColor(cameraImage, gray, cv::COLOR_BGR2GRAY);
+            sequential.push_back(tracking.track(gray));
+        }
+    }
+    check(sequential.size() > 2 * CHUNK_FRAMES, "could not read <" + test1 + ">, or too short");
+
+    // ...and chunks seeked exactly
+    vector<vector<Face>> exact;
+    check(BatchTracking(params).track(test1, exact), "could not track <" + test1 + ">");
+    check(exact.size() == sequential.size(), "wrong nb of frames when seeking exactly");
+
+    vector<vector<Face>> faces;
+
+    SimulatedSeeking keyframes(params, SimulatedSeeking::KEYFRAMES);
+    check(keyframes.track(test1, faces), "could not track with keyframes");
+    int wrong = mismatches(faces, exact, true);
+    cout << "keyframes: " << wrong << " frame(s) differ from exact seeking" << endl;
+    check(wrong == 0, "seeking to keyframes changes the faces");
+    check(keyframes.seeks > 1, "seeking to keyframes was not tracked in chunks");
+
+    SimulatedSeeking lost(params, SimulatedSeeking::LOST);
+    check(lost.track(test1, faces), "could not track when lost");
+    wrong = mismatches(faces, exact, true);
+    cout << "lost: " << wrong << " frame(s) differ from exact seeking" << endl;
+    check(wrong == 0, "losing the position changes the faces");
+
+    // only the probe: the video is tracked as one chunk
+    SimulatedSeeking unseekable(params, SimulatedSeeking::UNSEEKABLE);
+    check(unseekable.track(test1, faces), "could not track without seeking");
+    check(unseekable.seeks == 1, "an unseekable video was tracked in chunks");
+    wrong = mismatches(faces, sequential, false);
+    cout << "unseekable: " << wrong << " frame(s) differ from sequential tracking" << endl;
+    check(wrong == 0, "an unseekable video is not tracked sequentially");
+
+    // too many frames announced: the chunks are the same up to the end of
+    // the video, and no empty frame is added after it
+    WrongFrameCount overestimated(params, 1.5);
+    check(overestimated.track(test1, faces), "could not track with an overestimated length");
+    check(faces.size() == exact.size(), "expected " + to_string(exact.size()) + " frames, got "
+                                        + to_string(faces.size()) + " when the length is overestimated");
+    check(mismatches(faces, exact, true) == 0, "overestimating the length changes the faces");
+
+    // too few: the last chunk goes on to the end of the video
+    WrongFrameCount underestimated(params, 0.6);
+    check(underestimated.track(test1, faces), "could not track with an underestimated length");
+    check(faces.size() == exact.size(), "expected " + to_string(exact.size()) + " frames, got "
+                                        + to_string(faces.size()) + " when the length is underestimated");
+}
+
+static void testStitching()
+{
+    vector<ChunkResult> chunks(2);
+
+    ChunkResult& first = chunks[0];
+    first.first = 0;
+    first.begin = 0;
+    first.end = BOUNDARY;
+    for (unsigned long f = first.first; f < first.end; f++) {
+        first.faces.push_back({face(1, provisionalName(1), moving(f)),
+                               face(2, provisionalName(2), still(f))});
+    }
+
+    // the second chunk numbers the same faces the other way round, and only
+    // reports them once confirmed, a few frames into the overlap. A new face
+    // shows up at frame 150, and another at 160, which its recognizer knows
+    // as the moving face.
+    ChunkResult& second = chunks[1];
+    second.first = BOUNDARY - OVERLAP;
+    second.begin = BOUNDARY;
+    second.end = END;
+    for (unsigned long f = second.first; f < second.end; f++) {
+        vector<Face> faces;
+        if (f >= second.first + 3) {
+            faces.push_back(face(1, provisionalName(1), still(f)));
+            faces.push_back(face(2, provisionalName(2), moving(f)));
+        }
+        if (f >= 150) faces.push_back(face(3, provisionalName(3), Rect(250, 300, 50, 50)));
+        if (f >= 160) faces.push_back(face(4, provisionalName(2), Rect(20, 300, 50, 50)));
+        second.faces.push_back(faces);
+    }
+
+    BatchTracking batch;
+    vector<vector<Face>> faces;
+    size_t continued = batch.stitch(chunks, faces);
+
+    check(continued == 2, "expected 2 tracks continued across the boundary, got " + to_string(continued));
+    check(faces.size() == END, "expected " + to_string(END) + " frames, got " + to_string(faces.size()));
+    if (faces.size() != END) return;
+
+    for (unsigned long f = 0; f < END; f++) {
+        size_t expected = f >= 160 ? 4 : (f >= 150 ? 3 : 2);
+        check(faces[f].size() == expected, "wrong nb of faces in frame " + to_string(f));
+
+        for (const auto& face : faces[f]) {
+            if (face.boundingbox() == moving(f)) {
+                check(face.id() == 1 && face.name() == "human1", "moving face renamed at frame " + to_string(f));
+            }
+            else if (face.boundingbox() == still(f)) {
+                check(face.id() == 2 && face.name() == "human2", "static face renamed at frame " + to_string(f));
+            }
+            else if (face.boundingbox().x == 250) {
+                check(face.id() == 3 && face.name() == "human3", "new face not given a new id");
+            }
+            else {
+                // recognized as the moving face by the second chunk
+                check(face.id() == 4 && face.name() == "human1", "recognized face not given its global name");
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    testStitching();
+    testSeeking();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include <opencv2/core/core.hpp>
+
+#include "association.h"
+
+using namespace cv;
+using namespace std;
+
+// Synthetic crowd: faces packed in a frame, moving a bit between two
+// detections. A few faces are missed by the detector, and a few new ones
+// appear.
+
+static const int FRAMES = 200;
+static const int FACE_SIZE = 40;
+
+// former behaviour: first track with a non-zero overlap wins
+static int greedy(const vector<Rect>& tracks, const Rect& detection)
+{
+    for (size_t t = 0; t < tracks.size(); t++) {
+        if (Associator::iou(tracks[t], detection) > 0.f) return t;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    mt19937 rng(1);
+    normal_distribution<float> normal;
+    uniform_real_distribution<float> unit;
+
+    const vector<int> sizes = {10, 50, 100, 200, 400};
+
+    Associator associator;
+
+    cout << "Detection-to-track association, " << FACE_SIZE << "px faces" << endl;
+    cout << setw(8) << "people"
+         << setw(14) << "greedy (us)" << setw(10) << "correct"
+         << setw(14) << "optimal (us)" << setw(10) << "correct" << endl;
+
+    for (auto people : sizes) {
+
+        // the faces are 1.5 face apart on average
+        int side = 1.5 * FACE_SIZE * sqrt((float) people) + FACE_SIZE;
+
+        double greedyTime = 0., optimalTime = 0.;
+        int greedyCorrect = 0, optimalCorrect = 0, total = 0;
+
+        for (int f = 0; f < FRAMES; f++) {
+
+            vector<Rect> tracks, detections;
+            vector<int> truth;
+
+            for (int p = 0; p < people; p++) {
+                Rect track(unit(rng) * side, unit(rng) * side,
+                           FACE_SIZE * (0.8f + 0.4f * unit(rng)), 0);
+                track.height = track.width;
+                tracks.push_back(track);
+
+                if (unit(rng) < 0.05f) continue; // missed by the detector
+
+                // the detection is where the face moved to, give or take
+                Rect detection = track;
+                detection.x += 0.15f * track.width * normal(rng);
+                detection.y += 0.15f * track.height * normal(rng);
+                detection.width = detection.height = track.width * (1.f + 0.05f * normal(rng));
+                detections.push_back(detection);
+                truth.push_back(p);
+            }
+
+            // newcomers
+            for (int p = 0; p < people / 20; p++) {
+                detections.push_back(Rect(unit(rng) * side, unit(rng) * side, FACE_SIZE, FACE_SIZE));
+                truth.push_back(-1);
+            }
+
+            auto start = chrono::steady_clock::now();
+            vector<int> greedyAssignment;
+            for (const auto& d : detections) greedyAssignment.push_back(greedy(tracks, d));
+            greedyTime += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+            start = chrono::steady_clock::now();
+            const auto& assignment = associator.associate(tracks, detections);
+            optimalTime += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+            // newcomers may legitimately land on an existing face: only
+            // score the actual tracks
+            for (size_t d = 0; d < detections.size(); d++) {
+                if (truth[d] < 0) continue;
+                total++;
+                if (greedyAssignment[d] == truth[d]) greedyCorrect++;
+                if (assignment[d] == truth[d]) optimalCorrect++;
+            }
+        }
+
+        cout << setw(8) << people << fixed << setprecision(1)
+             << setw(14) << greedyTime / FRAMES << setw(10) << setprecision(3) << (double) greedyCorrect / total
+             << setprecision(1)
+             << setw(14) << optimalTime / FRAMES << setw(10) << setprecision(3) << (double) optimalCorrect / total
+             << setprecision(1) << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/objdetect/objdetect.hpp>
+#include <opencv2/core/core.hpp>
+#ifdef OPENCV3
+#include <opencv2/core/utility.hpp> // getTickCount
+#endif
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "simd_cascade.h"
+
+using namespace cv;
+using namespace std;
+
+// Time per frame of OpenCV's CascadeClassifier and of SimdCascade (with each
+// code path the CPU supports), on the frames of a video shrunk to several
+// widths, like FaceDetector::detect does.
+//
+// Our Haar models are in OpenCV's old format: OpenCV runs them with its
+// legacy evaluator, as FaceDetector does with the default cascade engine.
+//
+// Usage: benchmark_cascade [video]
+
+static const string default_video = "single_user_static_camera.avi";
+static const string model_path(INSTALL_PREFIX "/share/facetracking/");
+
+template<typename Cascade>
+static double timePerFrame(Cascade& cascade, const vector<Mat>& frames, size_t& detections)
+{
+    vector<Rect> objects;
+    detections = 0;
+
+    int64 start = getTickCount();
+    for (const auto& frame : frames) {
+        cascade.detectMultiScale(frame, objects, 1.1, 2, 0, Size(30, 30));
+        detections += objects.size();
+    }
+    return ((double)getTickCount() - start) / getTickFrequency() * 1000. / frames.size();
+}
+
+int main(int argc, char *argv[])
+{
+    string video = argc > 1 ? argv[1] : default_video;
+
+    vector<Mat> frames;
+    VideoCapture videoCapture(video);
+    Mat cameraImage;
+    while (videoCapture.read(cameraImage)) {
+        Mat gray;
+        cvtColor(cameraImage, gray, cv::COLOR_BGR2GRAY);
+        frames.push_back(gray);
+    }
+
+    if (frames.empty()) {
+        cerr << "Could not read any frame from <" << video << ">" << endl;
+        return 1;
+    }
+
+    const vector<string> models = {"haarcascade_frontalface_default.xml",
+                                   "lbpcascade_frontalface.xml",
+                                   "haarcascade_eye.xml"};
+    const vector<int> widths = {120, 160, 200, 320, 480, 640};
+
+    cout << "Time per frame (ms) over " << frames.size() << " frames of " << video << endl;
+
+    for (const auto& model : models) {
+
+        CascadeClassifier opencv(model_path + model);
+        SimdCascade simd(model_path + model);
+        if (opencv.empty() || simd.empty()) {
+            cout << endl << model << ": not available" << endl;
+            continue;
+        }
+
+        cout << endl << model << endl;
+        cout << setw(8) << "width" << setw(12) << "opencv";
+        for (int set = SCALAR; set <= bestInstructionSet(); set++) {
+            cout << setw(12) << instructionSetName((InstructionSet) set);
+        }
+        cout << setw(12) << "speedup" << endl;
+
+        for (auto width : widths) {
+
+            vector<Mat> scaled;
+            for (const auto& frame : frames) {
+                Mat img;
+                resize(frame, img, Size(width, cvRound(frame.rows * width / (double) frame.cols)));
+                equalizeHist(img, img);
+                scaled.push_back(img);
+            }
+
+            size_t detections;
+            double reference = timePerFrame(opencv, scaled, detections);
+            cout << setw(8) << width << fixed << setprecision(2) << setw(12) << reference;
+
+            double best = reference;
+            for (int set = SCALAR; set <= bestInstructionSet(); set++) {
+                simd.setInstructionSet((InstructionSet) set);
+                best = timePerFrame(simd, scaled, detections);
+                cout << setw(12) << best;
+            }
+            cout << setw(11) << setprecision(1) << reference / best << "x" << endl;
+        }
+    }
+
+    return 0;
+}
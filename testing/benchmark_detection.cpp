@@ -0,0 +1,63 @@
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/core.hpp>
+#ifdef OPENCV3
+#include <opencv2/core/utility.hpp> // getTickCount
+#endif
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "detection.h"
+
+using namespace cv;
+using namespace std;
+
+// Runs the face detector of each backend on every frame of a video, and
+// reports the time per frame and the ratio of frames with at least one face
+// (with both eyes found).
+//
+// Usage: benchmark_detection [video] [scaled width]
+
+static const string default_video = "single_user_static_camera.avi";
+
+int main(int argc, char *argv[])
+{
+    string video = argc > 1 ? argv[1] : default_video;
+    int scaledWidth = argc > 2 ? atoi(argv[2]) : 200;
+
+    vector<Mat> frames;
+    VideoCapture videoCapture(video);
+    Mat cameraImage;
+    while (videoCapture.read(cameraImage)) {
+        Mat gray;
+        cvtColor(cameraImage, gray, cv::COLOR_BGR2GRAY);
+        frames.push_back(gray);
+    }
+
+    if (frames.empty()) {
+        cerr << "Could not read any frame from <" << video << ">" << endl;
+        return 1;
+    }
+
+    cout << "Face detection on " << frames.size() << " frames of " << video
+         << " (scaled to " << scaledWidth << "px wide)" << endl;
+    cout << setw(10) << "detector" << setw(14) << "time (ms)" << setw(12) << "detected" << endl;
+
+    for (auto type : {HAAR, LBP}) {
+        FaceDetector detector(type);
+
+        int detected = 0;
+        int64 start = getTickCount();
+        for (const auto& frame : frames) {
+            if (!detector.detect(frame, scaledWidth).empty()) detected++;
+        }
+        double elapsed = ((double)getTickCount() - start) / getTickFrequency() * 1000. / frames.size();
+
+        cout << setw(10) << detectorName(type)
+             << setw(14) << fixed << setprecision(2) << elapsed
+             << setw(12) << setprecision(3) << (double) detected / frames.size() << endl;
+    }
+
+    return 0;
+}
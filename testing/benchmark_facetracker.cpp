@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+
+#include "face_tracker.h"
+
+using namespace cv;
+using namespace std;
+
+// Per-frame bookkeeping of the face tracker, once the optical flow returned:
+// drop the features that were not found, update the centroid, prune the
+// features too far from it. The optical flow itself is not timed.
+
+static const int ROUNDS = 1000000;
+
+// former behaviour: vectors, distances in double precision
+static vector<Point2f> former(const vector<Point2f>& next, const vector<unsigned char>& status,
+                              Point2f& centroid, double variance)
+{
+    vector<Point2f> found;
+    found.reserve(NB_FEATURES);
+    for (size_t i = 0; i < next.size(); i++) {
+        if (status[i] == 1) found.push_back(next[i]);
+    }
+
+    if (!found.empty()) {
+        auto sum = found[0];
+        for (size_t i = 1; i < found.size(); i++) sum += found[i];
+        centroid = sum * (1.f / found.size());
+    }
+
+    vector<Point2f> pruned;
+    for (auto p : found) {
+        if (pow(norm(p - centroid), 2) < 3 * variance) pruned.push_back(p);
+    }
+    return pruned;
+}
+
+template<size_t N>
+static size_t bookkeeping(const Point2f* next, const unsigned char* status, size_t count,
+                          Point2f* points, Point2f& centroid, float variance)
+{
+    size_t found = FaceTracker<N>::compact(next, status, points, count);
+    if (found > 0) centroid = FaceTracker<N>::mean(points, found);
+    return FaceTracker<N>::prune(points, found, centroid, 3 * variance);
+}
+
+int main(int argc, char *argv[])
+{
+    mt19937 rng(1);
+    normal_distribution<float> normal(0.f, 10.f);
+    uniform_real_distribution<float> unit;
+
+    // a few sets of features, some of them lost by the optical flow
+    const int SETS = 64;
+    vector<vector<Point2f>> nexts(SETS);
+    vector<vector<unsigned char>> statuses(SETS);
+    for (int s = 0; s < SETS; s++) {
+        for (int i = 0; i < NB_FEATURES; i++) {
+            nexts[s].push_back(Point2f(100.f + normal(rng), 100.f + normal(rng)));
+            statuses[s].push_back(unit(rng) < 0.9f ? 1 : 0);
+        }
+    }
+    const float variance = 2 * 10.f * 10.f;
+
+    size_t kept = 0; // so that nothing is optimized away
+    Point2f centroid;
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        kept += former(nexts[r % SETS], statuses[r % SETS], centroid, variance).size();
+    }
+    double formerTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    Point2f points[NB_FEATURES];
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        kept += bookkeeping<DYNAMIC_FEATURES>(nexts[r % SETS].data(), statuses[r % SETS].data(),
+                                              NB_FEATURES, points, centroid, variance);
+    }
+    double dynamicTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        kept += bookkeeping<NB_FEATURES>(nexts[r % SETS].data(), statuses[r % SETS].data(),
+                                         NB_FEATURES, points, centroid, variance);
+    }
+    double fixedTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    cout << "Face tracker bookkeeping, " << (int) NB_FEATURES << " features ("
+         << kept << " kept over all rounds)" << endl;
+    cout << setw(24) << "" << setw(12) << "ns/frame" << setw(16) << "tracker bytes" << endl;
+    cout << fixed << setprecision(1);
+    cout << setw(24) << "former (vectors)" << setw(12) << formerTime << setw(16) << "-" << endl;
+    cout << setw(24) << "FaceTracker<DYNAMIC>" << setw(12) << dynamicTime
+         << setw(16) << sizeof(FaceTracker<DYNAMIC_FEATURES>) << endl;
+    cout << setw(24) << "FaceTracker<NB_FEATURES>" << setw(12) << fixedTime
+         << setw(16) << sizeof(FaceTracker<NB_FEATURES>) << endl;
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#include "gallery.h"
+#include "recognition.h" // MAX_TRAINING_IMAGES, NB_EIGENFACES
+
+using namespace std;
+
+// Synthetic gallery, mimicking projections on the eigenfaces: the variance
+// decreases along the principal components, and each identity is a cluster of
+// MAX_TRAINING_IMAGES noisy samples.
+//
+// The reference is a linear scan in double precision: the recall of the
+// (int8) index includes the error due to the quantization.
+
+static const int QUERIES = 200;
+
+struct Gallery {
+    vector<double> centers;
+    vector<double> samples;
+    vector<int> labels;
+};
+
+static double sigma(int component) {return 1000. / sqrt(component + 1.);}
+
+static Gallery makeGallery(int identities, mt19937& rng)
+{
+    normal_distribution<double> normal;
+    Gallery g;
+
+    for (int id = 0; id < identities; id++) {
+        for (int k = 0; k < NB_EIGENFACES; k++) g.centers.push_back(sigma(k) * normal(rng));
+
+        for (int s = 0; s < MAX_TRAINING_IMAGES; s++) {
+            for (int k = 0; k < NB_EIGENFACES; k++) {
+                g.samples.push_back(g.centers[id * NB_EIGENFACES + k] + 0.1 * sigma(k) * normal(rng));
+            }
+            g.labels.push_back(id);
+        }
+    }
+    return g;
+}
+
+static int linearScan(const Gallery& g, const double* query)
+{
+    int label = -1;
+    double best = numeric_limits<double>::max();
+    for (size_t i = 0; i < g.labels.size(); i++) {
+        double sum = 0.;
+        for (int k = 0; k < NB_EIGENFACES; k++) {
+            double d = g.samples[i * NB_EIGENFACES + k] - query[k];
+            sum += d * d;
+        }
+        if (sum < best) {best = sum; label = g.labels[i];}
+    }
+    return label;
+}
+
+int main(int argc, char *argv[])
+{
+    mt19937 rng(1);
+    normal_distribution<double> normal;
+    uniform_real_distribution<double> unit;
+
+    const vector<int> sizes = {10, 100, 1000, 10000, 100000};
+    const vector<size_t> checks = {0, 2000, 500, 100};
+
+    cout << "Gallery search, " << NB_EIGENFACES << " components, " << MAX_TRAINING_IMAGES << " samples per identity" << endl;
+    cout << setw(10) << "identities" << setw(14) << "linear (us)";
+    for (auto c : checks) cout << setw(14) << ("vp/" + (c ? to_string(c) : string("exact")) + " (us)") << setw(8) << "recall";
+    cout << endl;
+
+    for (auto identities : sizes) {
+
+        auto gallery = makeGallery(identities, rng);
+
+        vector<float> samples(gallery.samples.begin(), gallery.samples.end());
+        GalleryIndex index(NB_EIGENFACES);
+        for (size_t i = 0; i < gallery.labels.size(); i++) index.add(&samples[i * NB_EIGENFACES], gallery.labels[i]);
+        index.rebuild();
+
+        // queries: new (noisy) pictures of known people
+        vector<double> queries;
+        for (int q = 0; q < QUERIES; q++) {
+            int id = unit(rng) * identities;
+            for (int k = 0; k < NB_EIGENFACES; k++) {
+                queries.push_back(gallery.centers[id * NB_EIGENFACES + k] + 0.1 * sigma(k) * normal(rng));
+            }
+        }
+        vector<float> queries32(queries.begin(), queries.end());
+
+        vector<int> truth;
+        auto start = chrono::steady_clock::now();
+        for (int q = 0; q < QUERIES; q++) truth.push_back(linearScan(gallery, &queries[q * NB_EIGENFACES]));
+        double linear = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / QUERIES;
+
+        cout << setw(10) << identities << setw(14) << fixed << setprecision(1) << linear;
+
+        for (auto c : checks) {
+            int found = 0;
+            start = chrono::steady_clock::now();
+            for (int q = 0; q < QUERIES; q++) {
+                int label; double distance;
+                index.nearest(&queries32[q * NB_EIGENFACES], label, distance, c);
+                if (label == truth[q]) found++;
+            }
+            double elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / QUERIES;
+            cout << setw(14) << elapsed << setw(8) << setprecision(3) << (double) found / QUERIES << setprecision(1);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "shm_publisher.h"
+#include "shm_ring.h"
+
+using namespace cv;
+using namespace std;
+
+// Latency between two local processes through the shared memory ring: the
+// parent publishes frames of a few faces at a steady rate, the child busy
+// polls a ShmRingReader, and measures how long after its publication each
+// frame was read.
+
+static const int FRAMES = 20000;
+static const int FACES = 4;
+static const int PERIOD_US = 100;
+static const char RING[] = "/facetracking_benchmark";
+
+static int reader(int ready)
+{
+    ShmRingReader ring(RING);
+    if (!ring.isOpen()) {
+        cerr << "Could not open the ring" << endl;
+        return 1;
+    }
+
+    // tell the publisher it can start
+    char c = 1;
+    if (write(ready, &c, 1) != 1) return 1;
+
+    vector<int64_t> latencies;
+    latencies.reserve(FRAMES);
+
+    ShmFrame frame;
+    int overruns = 0;
+    uint64_t last = 0;
+    while (last < FRAMES) {
+        switch (ring.next(frame)) {
+        case ShmRingReader::NO_FRAME:
+            continue;
+        case ShmRingReader::OVERRUN:
+            overruns++;
+            // fall through
+        case ShmRingReader::FRAME:
+            latencies.push_back(shmTimestamp() - frame.timestamp);
+            last = frame.frame;
+            break;
+        }
+    }
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[min(latencies.size() - 1, (size_t) (p * latencies.size()))] / 1000.;
+    };
+
+    cout << "Shared memory ring, " << FRAMES << " frames of " << FACES << " faces, one every "
+         << PERIOD_US << "us (" << sizeof(ShmFrame) << " bytes per frame)" << endl;
+    cout << fixed << setprecision(2);
+    cout << setw(24) << "latency median (us)" << setw(12) << percentile(0.5) << endl;
+    cout << setw(24) << "latency p99 (us)" << setw(12) << percentile(0.99) << endl;
+    cout << setw(24) << "latency max (us)" << setw(12) << latencies.back() / 1000. << endl;
+    cout << setw(24) << "frames read" << setw(12) << latencies.size() << endl;
+    cout << setw(24) << "overruns" << setw(12) << overruns
+         << " (" << ring.missed() << " frames missed)" << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    ShmPublisher publisher(RING);
+    if (!publisher.isOpen()) return 1;
+
+    vector<Face> faces;
+    for (int i = 0; i < FACES; i++) {
+        faces.push_back(Face(i + 1, "human" + to_string(i + 1),
+                             Rect(100 * i, 50, 80, 80), Matx44d::eye()));
+    }
+
+    int pipefd[2];
+    if (pipe(pipefd) < 0) return 1;
+
+    pid_t child = fork();
+    if (child == 0) {
+        close(pipefd[0]);
+        // _exit: the child must not run the destructor of the publisher
+        _exit(reader(pipefd[1]));
+    }
+    close(pipefd[1]);
+
+    char c;
+    if (read(pipefd[0], &c, 1) != 1) {
+        waitpid(child, nullptr, 0);
+        return 1;
+    }
+
+    auto next = chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        next += chrono::microseconds(PERIOD_US);
+        this_thread::sleep_until(next);
+        publisher.publish(faces);
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,20 @@
+#ifndef TESTING_CHECKS_H
+#define TESTING_CHECKS_H
+
+#include <iostream>
+#include <string>
+
+// The checks shared by the tests: a failed check is reported, and the test
+// goes on. main() then returns 'failures == 0 ? 0 : 1'.
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+#endif // TESTING_CHECKS_H
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "latest_publisher.h"
+
+using namespace std;
+
+// Hammers a LatestPublisher with one writer and several readers, some of them
+// holding on to older versions: the readers must only ever see complete
+// versions, in order, and a version held by a reader must never change.
+
+static const unsigned long VERSIONS = 1000000;
+static const int READERS = 4;
+
+struct Version {
+    unsigned long first = 0;
+    vector<unsigned long> values;
+    unsigned long last = 0;
+};
+
+static bool consistent(const Version& v)
+{
+    if (v.first != v.last || v.values.size() != v.first % 16) return false;
+    for (auto value : v.values) {
+        if (value != v.first) return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    LatestPublisher<Version, 8> publisher;
+    atomic<bool> done(false);
+    atomic<long> failures(0), reads(0);
+
+    vector<thread> readers;
+    for (int r = 0; r < READERS; r++) {
+        readers.emplace_back([&publisher, &done, &failures, &reads, r]() {
+            unsigned long previous = 0;
+            vector<LatestPublisher<Version, 8>::Handle> held;
+
+            while (!done) {
+                auto version = publisher.latest();
+                if (!version) continue;
+                reads++;
+
+                if (!consistent(*version) || version->first < previous) failures++;
+                previous = version->first;
+
+                // the versions held for a while must not be recycled
+                for (const auto& old : held) {
+                    if (!consistent(*old)) failures++;
+                }
+                held.push_back(version);
+                if (held.size() > (size_t) r) held.erase(held.begin());
+            }
+        });
+    }
+
+    unsigned long published = 0;
+    for (unsigned long n = 1; n <= VERSIONS; n++) {
+        Version* version = publisher.beginWrite();
+        if (!version) continue;
+
+        version->first = n;
+        version->values.assign(n % 16, n);
+        version->last = n;
+        publisher.publish();
+        published++;
+    }
+
+    done = true;
+    for (auto& reader : readers) reader.join();
+
+    cout << published << " versions published (" << publisher.dropped() << " dropped), "
+         << reads << " reads, " << failures << " inconsistent" << endl;
+
+    return failures == 0 ? 0 : 1;
+}
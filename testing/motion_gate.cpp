@@ -0,0 +1,143 @@
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <vector>
+
+#include "facetracking.h"
+#include "motion_gate.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Feeds MotionGate synthetic frames: a static scene, then a bright blob
+// jumping in and moving across it. Nothing must be scanned while nothing
+// moves, the blob must be covered by a region, and the areas around the
+// tracks must be scanned whether they moved or not.
+
+static const Size FRAME_SIZE(640, 480);
+static const int BLOB_SIZE = 80;
+
+/** A smooth gradient (the static scene), with the blob at 'blob' (if not
+ * empty).
+ */
+static Mat frame(const Rect& blob = Rect())
+{
+    Mat image(FRAME_SIZE, CV_8U);
+    for (int y = 0; y < image.rows; y++) {
+        for (int x = 0; x < image.cols; x++) image.at<uchar>(y, x) = 40 + (x + y) / 20;
+    }
+    if (blob.area() > 0) image(blob).setTo(Scalar(255));
+    return image;
+}
+
+static bool covers(const Rect& region, const Rect& area)
+{
+    return (region & area) == area;
+}
+
+static bool anyCovers(const vector<Rect>& regions, const Rect& area)
+{
+    for (const auto& region : regions) {
+        if (covers(region, area)) return true;
+    }
+    return false;
+}
+
+static void testMotion()
+{
+    MotionGate gate;
+    Size minSize = FaceDetector::minFaceSize(FRAME_SIZE.width);
+    Rect whole(Point(), FRAME_SIZE);
+
+    // the first frame changed everywhere
+    gate.update(frame());
+    check(anyCovers(gate.regions(minSize), whole), "the first frame is not scanned entirely");
+
+    // then nothing moves
+    for (int i = 0; i < 5; i++) {
+        gate.update(frame());
+        check(gate.changedBlocks() == 0, "a block of a static scene changed");
+        check(gate.regions(minSize).empty(), "a static scene has regions to scan");
+    }
+
+    // the blob jumps in...
+    Rect blob(400, 240, BLOB_SIZE, BLOB_SIZE);
+    gate.update(frame(blob));
+    const auto& regions = gate.regions(minSize);
+    check(anyCovers(regions, blob), "the blob that appeared is not covered");
+    check(!anyCovers(regions, whole), "the whole frame is scanned for a blob");
+
+    // ...the changes were consumed...
+    check(gate.regions(minSize).empty(), "the changes were not cleared");
+
+    // ...then moves across the scene: the regions accumulate until the next
+    // detection
+    for (int i = 0; i < 4; i++) {
+        blob.x -= BLOB_SIZE / 2;
+        gate.update(frame(blob));
+    }
+    check(anyCovers(gate.regions(minSize), blob), "the moving blob is not covered");
+
+    // the blob leaves: the regions are large enough for the detector, and
+    // inside the frame
+    gate.update(frame());
+    for (const auto& region : gate.regions(minSize)) {
+        check(region.width >= minSize.width && region.height >= minSize.height, "region too small");
+        check(covers(whole, region), "region out of the frame");
+    }
+}
+
+static void testTracks()
+{
+    MotionGate gate;
+    vector<DetectionRegion> regions;
+    vector<Rect> tracks = {Rect(100, 80, 90, 90), Rect(300, 300, 60, 60)};
+    int width = FRAME_SIZE.width;
+
+    gate.update(frame());
+    gate.regions(Size());
+
+    // nothing moves: only the tracks are scanned...
+    gate.update(frame());
+    FaceTracking::gatedRegions(gate, tracks, width, ScaleWindow(), regions);
+    check(regions.size() == tracks.size(), "a static scene with tracks should only scan the tracks");
+
+    for (const auto& track : tracks) {
+        bool found = false;
+        for (const auto& region : regions) {
+            if (!covers(region.area, track)) continue;
+            found = true;
+            // ...for faces about as large as the tracked ones
+            check(region.window.minFace < track.width && region.window.maxFace > track.width,
+                  "the faces around a track are not scanned at its size");
+        }
+        check(found, "the area around a static track is not scanned");
+    }
+
+    // no track either: nothing to scan at all
+    vector<DetectionRegion> none;
+    gate.update(frame());
+    FaceTracking::gatedRegions(gate, vector<Rect>(), width, ScaleWindow(), none);
+    check(none.empty(), "regions to scan without motion nor tracks");
+
+    // something moves elsewhere: the tracks are still scanned
+    Rect blob(500, 50, BLOB_SIZE, BLOB_SIZE);
+    gate.update(frame(blob));
+    FaceTracking::gatedRegions(gate, tracks, width, ScaleWindow(), regions);
+    check(regions.size() > tracks.size(), "the moving blob is not scanned");
+
+    for (const auto& track : tracks) {
+        bool found = false;
+        for (const auto& region : regions) found = found || covers(region.area, track);
+        check(found, "the area around a track is not scanned when something else moves");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    testMotion();
+    testTracks();
+
+    return failures == 0 ? 0 : 1;
+}
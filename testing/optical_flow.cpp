@@ -0,0 +1,193 @@
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/video.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "optical_flow.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Checks that OpticalFlow is a drop-in replacement for OpenCV's pyramidal
+// Lucas-Kanade: the pyramids (images and derivatives, borders included) must
+// be the same as cv::buildOpticalFlowPyramid's, and the points tracked the
+// same as cv::calcOpticalFlowPyrLK's, on frames of the test video and on
+// synthetic frames, with points near and past the borders.
+
+const static string test1 = "single_user_static_camera.avi";
+
+// float sums may be accumulated in another order: the iterations can then
+// stop one step apart, and a step below LK_EPSILON is not taken
+static const float MAX_POINT_ERROR = 2 * LK_EPSILON;
+// mean absolute difference of the patches, in gray levels
+static const float MAX_ERR_ERROR = 0.1f;
+
+/** The whole buffer of a pyramid level, border included.
+ */
+static Mat withBorder(Mat level)
+{
+    return level.adjustROI(LK_WINDOW, LK_WINDOW, LK_WINDOW, LK_WINDOW);
+}
+
+static void comparePyramids(const Mat& image, const string& name)
+{
+    ImagePyramid pyramid;
+    pyramid.build(image);
+
+    vector<Mat> reference;
+    int maxLevel = buildOpticalFlowPyramid(image, reference, Size(LK_WINDOW, LK_WINDOW), LK_LEVELS,
+                                           true, BORDER_REFLECT_101, BORDER_CONSTANT, false);
+
+    check(pyramid.levels() == maxLevel + 1, name + ": " + to_string(pyramid.levels())
+                                            + " pyramid levels instead of " + to_string(maxLevel + 1));
+
+    for (int level = 0; level < min(pyramid.levels(), maxLevel + 1); level++) {
+        const Mat& expectedImage = reference[2 * level];
+        const Mat& expectedDerivs = reference[2 * level + 1];
+
+        string where = name + ", level " + to_string(level);
+        check(pyramid.image(level).size() == expectedImage.size(), where + ": wrong size");
+        if (pyramid.image(level).size() != expectedImage.size()) continue;
+
+        check(norm(withBorder(pyramid.image(level)), withBorder(expectedImage), NORM_INF) == 0,
+              where + ": images differ");
+        check(norm(withBorder(pyramid.derivatives(level)), withBorder(expectedDerivs), NORM_INF) == 0,
+              where + ": derivatives differ");
+    }
+}
+
+/** Points to track: corners, a grid, and points on, near and past the
+ * borders (which must be lost in both).
+ */
+static vector<Point2f> pointsToTrack(const Mat& image)
+{
+    vector<Point2f> points;
+    goodFeaturesToTrack(image, points, 100, 0.01, 5);
+
+    for (int y = 0; y < image.rows; y += 7) {
+        for (int x = 0; x < image.cols; x += 7) points.push_back(Point2f(x + 0.3f, y + 0.6f));
+    }
+
+    float right = image.cols - 1, bottom = image.rows - 1;
+    for (float d : {0.f, 1.5f, 4.f, 9.f}) {
+        points.push_back(Point2f(d, d));
+        points.push_back(Point2f(right - d, d));
+        points.push_back(Point2f(d, bottom - d));
+        points.push_back(Point2f(right - d, bottom - d));
+        points.push_back(Point2f(-d, image.rows / 2.f));
+        points.push_back(Point2f(image.cols / 2.f, bottom + d));
+    }
+    points.push_back(Point2f(-3.f * LK_WINDOW, 0.f));
+    points.push_back(Point2f(right + 3.f * LK_WINDOW, bottom));
+
+    return points;
+}
+
+static void compareTracking(const Mat& prev, const Mat& next, const string& name)
+{
+    comparePyramids(prev, name);
+
+    OpticalFlow flow;
+    flow.push(prev);
+    flow.push(next);
+    check(flow.hasPrevious(), name + ": no previous frame");
+
+    vector<Point2f> prevPts = pointsToTrack(prev);
+    size_t count = prevPts.size();
+
+    vector<Point2f> nextPts(count);
+    vector<unsigned char> status(count);
+    vector<float> err(count);
+    flow.track(prevPts.data(), nextPts.data(), status.data(), err.data(), count);
+
+    vector<Point2f> expectedPts;
+    vector<unsigned char> expectedStatus;
+    vector<float> expectedErr;
+    calcOpticalFlowPyrLK(prev, next, prevPts, expectedPts, expectedStatus, expectedErr,
+                         Size(LK_WINDOW, LK_WINDOW), LK_LEVELS,
+                         TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, LK_MAX_ITERATIONS, LK_EPSILON));
+
+    int tracked = 0, statusMismatches = 0, pointMismatches = 0;
+    float worst = 0.f;
+
+    for (size_t i = 0; i < count; i++) {
+        if (status[i] != expectedStatus[i]) {
+            statusMismatches++;
+            continue;
+        }
+        if (!status[i]) continue;
+
+        tracked++;
+        Point2f d = nextPts[i] - expectedPts[i];
+        float error = max(abs(d.x), abs(d.y));
+        worst = max(worst, error);
+        if (error > MAX_POINT_ERROR || abs(err[i] - expectedErr[i]) > MAX_ERR_ERROR) pointMismatches++;
+    }
+
+    cout << name << ": " << tracked << "/" << count << " points tracked, max error " << worst << "px, "
+         << statusMismatches << " status and " << pointMismatches << " point mismatch(es)" << endl;
+
+    check(statusMismatches == 0, name + ": status differ");
+    check(pointMismatches == 0, name + ": tracked points differ");
+}
+
+/** Smooth random texture, so that the points can be tracked.
+ */
+static Mat texture(Size size, RNG& rng)
+{
+    Mat noise(size, CV_8U);
+    rng.fill(noise, RNG::UNIFORM, Scalar(0), Scalar(256));
+    GaussianBlur(noise, noise, Size(5, 5), 1.5);
+    return noise;
+}
+
+static Mat translated(const Mat& image, float dx, float dy)
+{
+    Mat moved;
+    Mat transform = (Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
+    warpAffine(image, moved, transform, image.size(), INTER_LINEAR, BORDER_REFLECT_101);
+    return moved;
+}
+
+int main(int argc, char *argv[])
+{
+    // real frames: consecutive frames of the test video
+    VideoCapture videoCapture(test1);
+    Mat cameraImage, gray, previous;
+    int pairs = 0;
+    for (int i = 0; videoCapture.read(cameraImage); i++) {
+        cvtColor(cameraImage, gray, cv::COLOR_BGR2GRAY);
+        if (i % 20 == 1) {
+            compareTracking(previous, gray, "frame " + to_string(i));
+            pairs++;
+        }
+        gray.copyTo(previous);
+    }
+    if (pairs == 0) {
+        cerr << "Could not read <" << test1 << ">" << endl;
+        return 1;
+    }
+
+    // synthetic frames: sub-pixel and large motions, odd sizes (the last
+    // levels are rounded up), and images too small for all the levels
+    RNG rng(1);
+    Mat image = texture(Size(321, 241), rng);
+    compareTracking(image, translated(image, 0.4f, -0.3f), "texture, small motion");
+    compareTracking(image, translated(image, 7.3f, 5.8f), "texture, large motion");
+
+    image = texture(Size(161, 97), rng);
+    compareTracking(image, translated(image, -2.5f, 1.2f), "odd size");
+
+    image = texture(Size(45, 33), rng);
+    compareTracking(image, translated(image, 1.f, 1.f), "small image");
+
+    // no texture: nothing can be tracked
+    image = Mat(120, 160, CV_8U, Scalar(128));
+    compareTracking(image, image, "flat image");
+
+    return failures == 0 ? 0 : 1;
+}
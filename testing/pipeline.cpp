@@ -0,0 +1,129 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include "pipeline.h"
+#include "checks.h"
+
+using namespace std;
+
+// Runs a pipeline of stages of known durations: the stages must run
+// concurrently, a BLOCK pipeline must deliver every item in order, and the
+// dropping policies must deliver the most recent items. The throughput is
+// only reported: timings depend on the load of the machine.
+
+static const int ITEMS = 200;
+static const chrono::milliseconds FAST(1), SLOW(3);
+
+struct Item {
+    int number = 0;
+    vector<int> payload;
+};
+
+// nb of stages currently processing an item, and the most seen at once
+static atomic<int> busyStages(0), maxBusyStages(0);
+
+/** Sleeps, as a stage processing an item.
+ */
+static bool sleepFor(chrono::milliseconds duration)
+{
+    int busy = ++busyStages;
+    int seen = maxBusyStages;
+    while (busy > seen && !maxBusyStages.compare_exchange_weak(seen, busy)) {}
+
+    this_thread::sleep_for(duration);
+
+    busyStages--;
+    return true;
+}
+
+/** Runs source (FAST) -> work (SLOW) -> sink (FAST), with the given policy in
+ * front of the slow stage. Returns the numbers of the items that made it
+ * through.
+ */
+static vector<int> run(QueuePolicy policy, double& seconds, vector<StageStats>& stats)
+{
+    Pipeline<Item> pipeline;
+    vector<int> received;
+    received.reserve(ITEMS);
+
+    int next = 0;
+    pipeline.addSource("source", [&next](Item& item) {
+        if (next == ITEMS) return false;
+        sleepFor(FAST);
+        item.number = next++;
+        item.payload.assign(16, item.number);
+        return true;
+    });
+
+    StageOptions options;
+    options.policy = policy;
+    pipeline.addStage("work", [](Item& item) {return sleepFor(SLOW);}, options);
+
+    options.policy = BLOCK;
+    pipeline.addStage("sink", [&received](Item& item) {
+        received.push_back(item.number);
+        for (auto value : item.payload) check(value == item.number, "item corrupted");
+        return sleepFor(FAST);
+    }, options);
+
+    maxBusyStages = 0;
+    auto begin = chrono::steady_clock::now();
+    pipeline.start();
+    pipeline.wait();
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    pipeline.stats(stats);
+    return received;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds;
+    vector<StageStats> stats;
+
+    // BLOCK: everything goes through, in order, at the pace of the slowest
+    // stage
+    auto received = run(BLOCK, seconds, stats);
+    check(received.size() == ITEMS, "BLOCK lost items");
+    for (size_t i = 0; i < received.size(); i++) {
+        check(received[i] == (int) i, "BLOCK reordered items");
+    }
+
+    double sequential = ITEMS * (2 * FAST + SLOW).count() / 1000.;
+    double slowest = ITEMS * SLOW.count() / 1000.;
+    cout << "BLOCK: " << ITEMS << " items in " << seconds << "s (sequential: "
+         << sequential << "s, slowest stage alone: " << slowest << "s)" << endl;
+    // the stages sleep: they overlap even on a single, loaded core
+    cout << "  up to " << maxBusyStages << " stages busy at once" << endl;
+    check(maxBusyStages >= 2, "BLOCK never ran two stages at once");
+
+    for (const auto& stage : stats) {
+        cout << "  " << stage.name << ": " << stage.processed << " items, "
+             << stage.meanTime << "ms on average, queue "
+             << stage.input.depth << "/" << stage.input.capacity
+             << " (" << stage.input.dropped << " dropped)" << endl;
+    }
+    check(stats[1].input.dropped == 0, "BLOCK dropped items");
+
+    // the dropping policies: the source is not slowed down, the slow stage
+    // drops items, but always gets the recent ones
+    for (auto policy : {DROP_OLDEST, KEEP_LATEST}) {
+        string name = policy == DROP_OLDEST ? "DROP_OLDEST" : "KEEP_LATEST";
+
+        received = run(policy, seconds, stats);
+        cout << name << ": " << received.size() << " items out of " << ITEMS
+             << " in " << seconds << "s, " << stats[1].input.dropped << " dropped" << endl;
+
+        check(received.size() + stats[1].input.dropped == ITEMS, name + " lost track of items");
+        check(stats[1].input.dropped > 0, name + " did not drop anything");
+        check(!received.empty() && received.back() == ITEMS - 1, name + " did not deliver the last item");
+        for (size_t i = 1; i < received.size(); i++) {
+            check(received[i] > received[i - 1], name + " reordered items");
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
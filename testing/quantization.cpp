@@ -0,0 +1,178 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/contrib/contrib.hpp> // subspaceProject
+
+#include "quantization.h"
+#include "gallery.h"
+#include "recognition.h" // FACE_WIDTH, NB_EIGENFACES, MAX_TRAINING_IMAGES
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Accuracy of the reduced precision recognition path, against the double
+// precision one (OpenCV's projection, and a linear scan of the gallery in
+// double), for each code path supported by the CPU.
+
+static const int FACES = 20;
+static const int IDENTITIES = 1000;
+static const int QUERIES = 500;
+
+// max error of the float32 projection, relative to the norm of the projection
+static const double MAX_PROJECTION_ERROR = 1e-4;
+// max error of the int8 distances, relative to the norm of the query
+static const double MAX_DISTANCE_ERROR = 0.02;
+// min share of the queries getting the same answer as the double precision
+// search
+static const double MIN_AGREEMENT = 0.99;
+
+static void testKernels(InstructionSet set, mt19937& rng)
+{
+    uniform_int_distribution<int> code(-127, 127);
+    normal_distribution<float> normal;
+
+    // odd sizes exercise the tails of the vectorized loops
+    for (size_t size : {0, 1, 7, 15, 16, 17, 33, 50, 101, 40000}) {
+        vector<int8_t> a(size), b(size);
+        vector<float> x(size), y(size);
+        for (size_t i = 0; i < size; i++) {
+            a[i] = code(rng); b[i] = code(rng);
+            x[i] = normal(rng); y[i] = normal(rng);
+        }
+
+        check(dotProduct(a.data(), b.data(), size, set) == dotProduct(a.data(), b.data(), size, SCALAR),
+              "int8 dot product of size " + to_string(size));
+
+        double exact = 0., magnitude = 0.;
+        for (size_t i = 0; i < size; i++) {
+            exact += (double) x[i] * y[i];
+            magnitude += fabs((double) x[i] * y[i]);
+        }
+        double error = fabs(dotProduct(x.data(), y.data(), size, set) - exact);
+        check(error <= 1e-5 * magnitude + 1e-6, "float dot product of size " + to_string(size));
+    }
+}
+
+static void testProjection(InstructionSet set, mt19937& rng)
+{
+    const int pixels = FACE_WIDTH * FACE_WIDTH;
+
+    // an orthonormal basis is not needed to compare the projections
+    Mat eigenvectors(pixels, NB_EIGENFACES, CV_64F);
+    randn(eigenvectors, Scalar(0.), Scalar(1. / FACE_WIDTH));
+    Mat mean(1, pixels, CV_64F);
+    randu(mean, Scalar(0.), Scalar(255.));
+
+    FaceProjector projector;
+    projector.setBasis(eigenvectors, mean);
+    projector.setInstructionSet(set);
+    check(projector.dimension() == NB_EIGENFACES, "projector dimension");
+
+    vector<float> projection(NB_EIGENFACES);
+    double worst = 0.;
+
+    for (int f = 0; f < FACES; f++) {
+        Mat face(FACE_WIDTH, FACE_WIDTH, CV_8U);
+        randu(face, Scalar(0), Scalar(256));
+
+        Mat reference = subspaceProject(eigenvectors, mean, face.reshape(1, 1));
+        projector.project(face, projection.data());
+
+        double error = 0.;
+        for (int k = 0; k < NB_EIGENFACES; k++) {
+            double d = projection[k] - reference.at<double>(0, k);
+            error += d * d;
+        }
+        worst = max(worst, sqrt(error) / norm(reference));
+    }
+
+    cout << "  projection: max relative error " << worst << endl;
+    check(worst < MAX_PROJECTION_ERROR, "float32 projection too far from the double one");
+}
+
+static double sigma(int component) {return 1000. / sqrt(component + 1.);}
+
+static void testGallery(InstructionSet set, mt19937& rng)
+{
+    normal_distribution<double> normal;
+    uniform_int_distribution<int> identity(0, IDENTITIES - 1);
+
+    // as in benchmark_gallery: clusters of noisy projections, with a variance
+    // decreasing along the components
+    vector<double> centers, samples;
+    vector<int> labels;
+    for (int id = 0; id < IDENTITIES; id++) {
+        for (int k = 0; k < NB_EIGENFACES; k++) centers.push_back(sigma(k) * normal(rng));
+        for (int s = 0; s < MAX_TRAINING_IMAGES; s++) {
+            for (int k = 0; k < NB_EIGENFACES; k++) {
+                samples.push_back(centers[id * NB_EIGENFACES + k] + 0.1 * sigma(k) * normal(rng));
+            }
+            labels.push_back(id);
+        }
+    }
+
+    GalleryIndex index(NB_EIGENFACES);
+    index.setInstructionSet(set);
+    vector<float> sample32(samples.begin(), samples.end());
+    for (size_t i = 0; i < labels.size(); i++) index.add(&sample32[i * NB_EIGENFACES], labels[i]);
+    index.rebuild();
+
+    int agree = 0;
+    double worst = 0.;
+    vector<double> query(NB_EIGENFACES);
+    vector<float> query32(NB_EIGENFACES);
+
+    for (int q = 0; q < QUERIES; q++) {
+        int id = identity(rng);
+        double queryNorm = 0.;
+        for (int k = 0; k < NB_EIGENFACES; k++) {
+            query[k] = centers[id * NB_EIGENFACES + k] + 0.1 * sigma(k) * normal(rng);
+            query32[k] = query[k];
+            queryNorm += query[k] * query[k];
+        }
+
+        // the double precision path: linear scan
+        int expected = -1;
+        double best = numeric_limits<double>::max();
+        for (size_t i = 0; i < labels.size(); i++) {
+            double sum = 0.;
+            for (int k = 0; k < NB_EIGENFACES; k++) {
+                double d = samples[i * NB_EIGENFACES + k] - query[k];
+                sum += d * d;
+            }
+            if (sum < best) {best = sum; expected = labels[i];}
+        }
+
+        int label;
+        double distance;
+        index.nearest(query32.data(), label, distance);
+
+        if (label == expected) agree++;
+        worst = max(worst, fabs(distance - sqrt(best)) / sqrt(queryNorm));
+    }
+
+    double agreement = (double) agree / QUERIES;
+    cout << "  gallery: " << agreement * 100 << "% same answers, max distance error "
+         << worst * 100 << "% of the query norm" << endl;
+    check(agreement >= MIN_AGREEMENT, "int8 gallery disagrees with the double precision search");
+    check(worst < MAX_DISTANCE_ERROR, "int8 distances too far from the double precision ones");
+}
+
+int main(int argc, char *argv[])
+{
+    for (int set = SCALAR; set <= bestInstructionSet(); set++) {
+        cout << instructionSetName((InstructionSet) set) << ":" << endl;
+
+        mt19937 rng(1);
+        testKernels((InstructionSet) set, rng);
+        testProjection((InstructionSet) set, rng);
+        testGallery((InstructionSet) set, rng);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
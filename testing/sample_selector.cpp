@@ -0,0 +1,159 @@
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+
+#include "sample_selector.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Feeds SampleSelector synthetic faces: the same crop over and over, then
+// crops differing by scale, head position or appearance. Checks which ones are
+// selected, and that only the samples the recognizer acquired are counted
+// and remembered.
+
+static const int FACE_SIZE = 80;
+
+/** Smooth random texture: two of them have nothing in common.
+ */
+static Mat face(RNG& rng)
+{
+    Mat noise(FACE_SIZE, FACE_SIZE, CV_8U);
+    rng.fill(noise, RNG::UNIFORM, Scalar(0), Scalar(256));
+    GaussianBlur(noise, noise, Size(9, 9), 3);
+    return noise;
+}
+
+static Matx44d headAt(double x, double y, double z)
+{
+    Matx44d pose = Matx44d::eye();
+    pose(0, 3) = x;
+    pose(1, 3) = y;
+    pose(2, 3) = z;
+    return pose;
+}
+
+/** Submits 'crop' if it is useful, and returns whether it was.
+ */
+static bool submit(SampleSelector& selector, const Mat& crop, const Matx44d& pose,
+                   unsigned long frame)
+{
+    if (!selector.isUseful(crop, pose, frame)) return false;
+    selector.submitted();
+    return true;
+}
+
+static void testCriteria()
+{
+    RNG rng(1);
+    SampleSelector selector;
+    Mat crop = face(rng);
+    Matx44d pose = headAt(0., 0., 1.);
+    unsigned long frame = 0;
+
+    check(!selector.isUseful(Mat(4, 4, CV_8U, Scalar(0)), pose, frame), "a tiny crop was selected");
+
+    check(submit(selector, crop, pose, frame), "the first sample was not selected");
+    check(selector.pending() == 1 && selector.accepted() == 0, "the first sample is not pending");
+
+    // the same crop: too soon, then similar to the pending sample
+    check(!selector.isUseful(crop, pose, frame + 1), "a sample was selected right after another");
+    frame += SAMPLE_MIN_INTERVAL;
+    check(!selector.isUseful(crop, pose, frame), "the pending sample was selected again");
+
+    selector.learned(0);
+    check(selector.pending() == 0 && selector.accepted() == 1, "the learned sample was not counted");
+    check(!selector.isUseful(crop, pose, frame), "the learned sample was selected again");
+
+    // a learned frame that was never submitted changes nothing
+    selector.learned(12345);
+    check(selector.accepted() == 1, "an unknown sample was counted");
+
+    // lighting alone does not make a sample different...
+    Mat brighter;
+    crop.convertTo(brighter, -1, 0.8, 30);
+    check(!selector.isUseful(brighter, pose, frame), "a lighting change was selected");
+
+    // ...nor a small head motion...
+    check(!selector.isUseful(crop, headAt(0.01, 0., 1.), frame), "a small motion was selected");
+
+    // ...but scale, position and appearance do
+    Mat larger;
+    resize(crop, larger, Size(), 1.2, 1.2);
+    check(selector.isUseful(larger, pose, frame), "a scale change was not selected");
+    check(selector.isUseful(crop, headAt(0.1, 0., 1.), frame), "a head motion was not selected");
+    check(selector.isUseful(face(rng), pose, frame), "a new appearance was not selected");
+
+    // the pose is unknown (the eyes were not found): only the rest matters
+    check(!selector.isUseful(crop, Matx44d::zeros(), frame), "an unknown pose made a sample different");
+
+    // after a while, any sample will do
+    check(selector.isUseful(crop, pose, SAMPLE_MAX_INTERVAL), "no sample selected after a long interval");
+}
+
+static void testRejection()
+{
+    RNG rng(2);
+    SampleSelector selector;
+    Mat crop = face(rng);
+    Matx44d pose = headAt(0., 0., 1.);
+
+    check(submit(selector, crop, pose, 0), "the first sample was not selected");
+
+    // the recognizer could not use it (eg the eyes were not found): it is
+    // neither counted, nor does it prevent trying a similar crop again
+    selector.rejected(0);
+    check(selector.pending() == 0 && selector.accepted() == 0, "the rejected sample was counted");
+    check(!selector.isUseful(crop, pose, 1), "a sample was selected right after a rejected one");
+    check(submit(selector, crop, pose, SAMPLE_MIN_INTERVAL), "a rejected sample blocks similar ones");
+
+    selector.learned(SAMPLE_MIN_INTERVAL);
+    check(selector.accepted() == 1, "the second attempt was not counted");
+}
+
+static void testBudget()
+{
+    RNG rng(3);
+    SampleSelector selector;
+    Matx44d pose = headAt(0., 0., 1.);
+    unsigned long frame = 0;
+
+    // the recognizer lags behind: at most MAX_PENDING_SAMPLES are waiting
+    for (int i = 0; i < MAX_PENDING_SAMPLES; i++, frame += SAMPLE_MIN_INTERVAL) {
+        check(submit(selector, face(rng), pose, frame), "a new face was not selected");
+    }
+    check(selector.pending() == (unsigned int) MAX_PENDING_SAMPLES, "wrong nb of pending samples");
+    check(!selector.isUseful(face(rng), pose, frame + SAMPLE_MAX_INTERVAL),
+          "a sample was selected while too many were pending");
+
+    // one comes back: room for another
+    selector.learned(0);
+    check(submit(selector, face(rng), pose, frame), "no sample selected once the recognizer caught up");
+
+    // only the last MAX_SELECTED_SAMPLES learned samples are remembered
+    SampleSelector forgetful;
+    frame = 0;
+    Mat first = face(rng);
+    check(submit(forgetful, first, pose, frame), "the first sample was not selected");
+    forgetful.learned(frame);
+    for (int i = 0; i < MAX_SELECTED_SAMPLES; i++) {
+        frame += SAMPLE_MIN_INTERVAL;
+        check(submit(forgetful, face(rng), pose, frame), "a new face was not selected");
+        forgetful.learned(frame);
+    }
+    check(forgetful.accepted() == (unsigned int) MAX_SELECTED_SAMPLES + 1, "wrong nb of learned samples");
+    check(forgetful.isUseful(first, pose, frame + SAMPLE_MIN_INTERVAL), "the oldest sample was not forgotten");
+
+    forgetful.clear();
+    check(forgetful.accepted() == 0 && forgetful.pending() == 0, "clear() did not forget the samples");
+}
+
+int main(int argc, char *argv[])
+{
+    testCriteria();
+    testRejection();
+    testBudget();
+
+    return failures == 0 ? 0 : 1;
+}
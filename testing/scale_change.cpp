@@ -0,0 +1,190 @@
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "face_tracker.h"
+#include "human.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Checks FaceTracker::scaleChange() on synthetic clouds of features, scaled
+// around their centroid and moved: the estimate must ignore a few outliers
+// and the lost features, be bounded, and fall back to 1 when there is no
+// pair of features to compare.
+//
+// Then tracks a synthetic face that comes closer and moves away again: the
+// bounding box of the Human must follow its size, and its features must not
+// be pruned as they spread out.
+
+static const int FEATURES = 40;
+static const float TOLERANCE = 1e-4f;
+
+static const Size FRAME_SIZE(320, 240);
+static const int FACE_SIZE = 80;
+// the face grows by that much per frame, for that many frames (about x1.6),
+// then shrinks back
+static const float APPROACH_SPEED = 1.02f;
+static const int APPROACH_FRAMES = 25;
+// error on the size of the bounding box, relative to the size of the face
+static const float BOX_TOLERANCE = 0.1f;
+
+struct Cloud {
+    vector<Point2f> previous, next;
+    vector<unsigned char> found;
+};
+
+/** FEATURES points spread over a face, all found, moved by 'scale' around
+ * their center and translated.
+ */
+static Cloud scaledCloud(float scale)
+{
+    Cloud cloud;
+    Point2f center(160.f, 120.f), motion(3.f, -2.f);
+
+    for (int i = 0; i < FEATURES; i++) {
+        // a spiral: the pairwise distances are all different
+        float angle = i * 2.4f, radius = 10.f + i;
+        Point2f point = center + Point2f(radius * cos(angle), radius * sin(angle));
+
+        cloud.previous.push_back(point);
+        cloud.next.push_back(center + motion + (point - center) * scale);
+        cloud.found.push_back(1);
+    }
+    return cloud;
+}
+
+static float scaleChange(const Cloud& cloud)
+{
+    size_t count = cloud.previous.size();
+    vector<float> ratios(count > 1 ? count * (count - 1) / 2 : 1);
+    return FaceTracker<>::scaleChange(cloud.previous.data(), cloud.next.data(),
+                                      cloud.found.data(), count, ratios.data());
+}
+
+static void checkScale(const Cloud& cloud, float expected, const string& what)
+{
+    float scale = scaleChange(cloud);
+    check(!std::isnan(scale) && abs(scale - expected) < TOLERANCE,
+          what + ": got " + to_string(scale) + " instead of " + to_string(expected));
+}
+
+/** The face, scaled by 'scale' around the center of the frame, on a flat
+ * background. 'face' is set to where it is.
+ */
+static Mat faceFrame(const Mat& texture, float scale, Rect& face)
+{
+    Size size(cvRound(texture.cols * scale), cvRound(texture.rows * scale));
+    face = Rect((FRAME_SIZE.width - size.width) / 2, (FRAME_SIZE.height - size.height) / 2,
+                size.width, size.height);
+
+    Mat frame(FRAME_SIZE, CV_8U, Scalar(128));
+    Mat area = frame(face);
+    resize(texture, area, size, 0, 0, INTER_LINEAR);
+    return frame;
+}
+
+static void testHuman()
+{
+    // smooth random texture: plenty of features to track
+    RNG rng(1);
+    Mat texture(FACE_SIZE, FACE_SIZE, CV_8U);
+    rng.fill(texture, RNG::UNIFORM, Scalar(0), Scalar(256));
+    GaussianBlur(texture, texture, Size(7, 7), 2);
+
+    OpticalFlow flow;
+    Rect face;
+    flow.push(faceFrame(texture, 1.f, face));
+    Human human(1, "human1", flow, face);
+
+    // the face comes closer, then moves away
+    float scale = 1.f, largest = 0.f;
+    int worstFrame = -1;
+    float worst = 0.f;
+    for (int i = 0; i < 2 * APPROACH_FRAMES; i++) {
+        scale *= i < APPROACH_FRAMES ? APPROACH_SPEED : 1.f / APPROACH_SPEED;
+        flow.push(faceFrame(texture, scale, face));
+        human.update(flow);
+
+        if (human.mode() == LOST || human.mode() == EXPIRED) {
+            check(false, "the features were lost at frame " + to_string(i) + ", scale " + to_string(scale));
+            return;
+        }
+
+        Rect box = human.boundingBox();
+        float error = max(abs(box.width - face.width), abs(box.height - face.height)) / (float) face.width;
+        if (error > worst) {
+            worst = error;
+            worstFrame = i;
+        }
+        largest = max(largest, box.width / (float) FACE_SIZE);
+    }
+
+    cout << "Human: box up to x" << largest << " the initial size, worst size error "
+         << 100 * worst << "% (frame " << worstFrame << ")" << endl;
+
+    check(largest > 1.5f, "the box did not grow as the face came closer");
+    check(worst < BOX_TOLERANCE, "the box does not follow the size of the face");
+    check(abs(human.boundingBox().width - FACE_SIZE) < BOX_TOLERANCE * FACE_SIZE,
+          "the box did not shrink back as the face moved away");
+}
+
+int main(int argc, char *argv[])
+{
+    // the face approaches, then retreats
+    checkScale(scaledCloud(1.1f), 1.1f, "scaled by 1.1");
+    checkScale(scaledCloud(0.95f), 0.95f, "scaled by 0.95");
+    checkScale(scaledCloud(1.f), 1.f, "translated only");
+
+    // an outlier (a feature that slid off the face) and a lost feature, that
+    // went nowhere near the others, do not change the median
+    Cloud cloud = scaledCloud(1.1f);
+    cloud.next[3] += Point2f(80.f, 50.f);
+    cloud.next[7] = Point2f(-1000.f, -1000.f);
+    cloud.found[7] = 0;
+    checkScale(cloud, 1.1f, "scaled by 1.1, with an outlier and a lost feature");
+
+    // at most MAX_SCALE_CHANGE per frame
+    checkScale(scaledCloud(2.f), MAX_SCALE_CHANGE, "scaled by 2");
+    checkScale(scaledCloud(0.2f), 1.f / MAX_SCALE_CHANGE, "scaled by 0.2");
+
+    // fewer than 2 features found: no pair to compare
+    cloud = scaledCloud(1.1f);
+    for (auto& found : cloud.found) found = 0;
+    checkScale(cloud, 1.f, "no feature found");
+    cloud.found[5] = 1;
+    checkScale(cloud, 1.f, "a single feature found");
+
+    Cloud single;
+    single.previous.push_back(Point2f(10.f, 10.f));
+    single.next.push_back(Point2f(12.f, 11.f));
+    single.found.push_back(1);
+    checkScale(single, 1.f, "a single feature");
+
+    checkScale(Cloud(), 1.f, "no feature");
+
+    // coincident features: their pairs tell nothing about the scale...
+    cloud = scaledCloud(1.1f);
+    for (auto& point : cloud.previous) point = Point2f(50.f, 50.f);
+    checkScale(cloud, 1.f, "coincident features");
+
+    // ...and do not disturb the estimate among the others
+    cloud = scaledCloud(1.1f);
+    for (int i = 0; i < 5; i++) {
+        cloud.previous[i] = cloud.previous[0] + Point2f(0.1f * i, 0.f);
+        cloud.next[i] = cloud.next[0] + Point2f(3.f * i, 0.f);
+    }
+    checkScale(cloud, 1.1f, "scaled by 1.1, with coincident features");
+
+    // features collapsing onto one point: bounded, not 0 (nor NaN)
+    cloud = scaledCloud(1.f);
+    for (auto& point : cloud.next) point = Point2f(50.f, 50.f);
+    checkScale(cloud, 1.f / MAX_SCALE_CHANGE, "collapsed features");
+
+    testHuman();
+
+    return failures == 0 ? 0 : 1;
+}
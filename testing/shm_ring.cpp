@@ -0,0 +1,230 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "shm_publisher.h"
+#include "shm_ring.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Publishes synthetic frames in a shared memory ring, and reads them back:
+// frames must be read in order, a lapped reader must report an overrun and
+// count the frames it missed, and a frame being overwritten while it is read
+// must never be returned. When the publisher restarts (cleanly or not), the
+// readers must follow it to its new ring.
+
+static const char RING[] = "/facetracking_test";
+// frames published while a reader reads them concurrently
+static const uint64_t CONCURRENT_FRAMES = 200000;
+
+/** The faces of frame n: everything in them derives from n, so that a frame
+ * mixing two of them is detected.
+ */
+static void makeFaces(uint64_t n, vector<Face>& faces)
+{
+    faces.clear();
+    Matx44d pose = Matx44d::eye();
+    pose(0, 3) = n;
+    for (uint64_t i = 0; i < 1 + n % SHM_MAX_FACES; i++) {
+        faces.push_back(Face(n + i, "human" + to_string(n),
+                             Rect(n % 1000, i, n % 100, n % 10), pose));
+    }
+}
+
+static bool consistent(const ShmFrame& frame)
+{
+    uint64_t n = frame.frame;
+    if (frame.nbFaces != 1 + n % SHM_MAX_FACES) return false;
+
+    string name = "human" + to_string(n);
+    for (uint32_t i = 0; i < frame.nbFaces; i++) {
+        const ShmFace& face = frame.faces[i];
+        if (face.id != (uint32_t) (n + i) || name != face.name
+            || face.x != (int32_t) (n % 1000) || face.y != (int32_t) i
+            || face.width != (int32_t) (n % 100) || face.height != (int32_t) (n % 10)
+            || face.pose[3] != (double) n) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void publish(ShmPublisher& publisher, uint64_t frames)
+{
+    vector<Face> faces;
+    for (uint64_t i = 0; i < frames; i++) {
+        makeFaces(publisher.published() + 1, faces);
+        publisher.publish(faces);
+    }
+}
+
+static void testSequential()
+{
+    ShmPublisher publisher(RING);
+    check(publisher.isOpen(), "could not create the ring");
+    if (!publisher.isOpen()) return;
+
+    // the frames published before the reader was opened are not read
+    publish(publisher, 5);
+
+    ShmRingReader reader(RING);
+    check(reader.isOpen(), "could not open the ring");
+    if (!reader.isOpen()) return;
+
+    ShmFrame frame;
+    check(reader.next(frame) == ShmRingReader::NO_FRAME, "a frame was read before any was published");
+
+    // almost a full lap behind: nothing is lost yet
+    publish(publisher, SHM_RING_SLOTS - 1);
+    for (uint64_t n = 6; n < 5 + SHM_RING_SLOTS; n++) {
+        ShmRingReader::Status status = reader.next(frame);
+        check(status == ShmRingReader::FRAME && frame.frame == n,
+              "frame " + to_string(n) + " was not read in order");
+        check(consistent(frame), "frame " + to_string(n) + " is corrupted");
+    }
+    check(reader.next(frame) == ShmRingReader::NO_FRAME, "a frame was read twice");
+    check(reader.missed() == 0, "frames missed without overrun");
+
+    // lapped: the reader jumps to the most recent frame...
+    publish(publisher, SHM_RING_SLOTS + 10);
+    check(reader.next(frame) == ShmRingReader::OVERRUN, "lapped reader did not report an overrun");
+    check(frame.frame == publisher.published() && consistent(frame),
+          "lapped reader did not read the most recent frame");
+    check(reader.missed() == SHM_RING_SLOTS + 9,
+          "expected " + to_string(SHM_RING_SLOTS + 9) + " missed frames, got " + to_string(reader.missed()));
+
+    // ...and goes on from there
+    publish(publisher, 1);
+    check(reader.next(frame) == ShmRingReader::FRAME && frame.frame == publisher.published(),
+          "the frame after an overrun was not read");
+
+    check(reader.latest(frame) && frame.frame == publisher.published() && consistent(frame),
+          "the latest frame was not read");
+
+    // the slot of the next frame is being overwritten (as if the publisher
+    // lapped the reader while it read): the frame must not be returned
+    int fd = shm_open(RING, O_RDWR, 0);
+    void* memory = fd < 0 ? MAP_FAILED
+                          : mmap(nullptr, sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fd >= 0) close(fd);
+    check(memory != MAP_FAILED, "could not map the ring");
+    if (memory == MAP_FAILED) return;
+    ShmRing* ring = static_cast<ShmRing*>(memory);
+
+    publish(publisher, 2);
+    uint64_t n = publisher.published() - 1, missed = reader.missed();
+    ShmSlot& slot = ring->slot[n % SHM_RING_SLOTS];
+    slot.sequence.store(2 * (n + SHM_RING_SLOTS) + 1);
+    slot.frame.nbFaces = 0;
+
+    check(reader.next(frame) == ShmRingReader::OVERRUN && frame.frame == n + 1 && consistent(frame),
+          "a frame being overwritten was returned");
+    check(reader.missed() == missed + 1, "the frame being overwritten was not counted as missed");
+
+    munmap(memory, sizeof(ShmRing));
+}
+
+static void testConcurrent()
+{
+    ShmPublisher publisher(RING);
+    ShmRingReader reader(RING);
+    check(publisher.isOpen() && reader.isOpen(), "could not open the ring");
+    if (!publisher.isOpen() || !reader.isOpen()) return;
+
+    atomic<bool> done(false);
+    thread writer([&publisher, &done]() {
+        publish(publisher, CONCURRENT_FRAMES);
+        done = true;
+    });
+
+    // the publisher never waits: the reader is lapped now and then, and
+    // frames are overwritten while it copies them
+    ShmFrame frame;
+    uint64_t last = 0, read = 0, overruns = 0, torn = 0, outOfOrder = 0;
+    while (last < CONCURRENT_FRAMES) {
+        // nothing new after the publisher was done: all read
+        bool finished = done;
+        ShmRingReader::Status status = reader.next(frame);
+        if (status == ShmRingReader::NO_FRAME) {
+            if (finished) break;
+            continue;
+        }
+
+        read++;
+        if (status == ShmRingReader::OVERRUN) overruns++;
+        if (!consistent(frame)) torn++;
+        if (frame.frame <= last) outOfOrder++;
+        last = frame.frame;
+    }
+    writer.join();
+
+    cout << read << " frames read concurrently, " << overruns << " overrun(s), "
+         << reader.missed() << " frames missed" << endl;
+
+    check(torn == 0, to_string(torn) + " torn frame(s) returned");
+    check(outOfOrder == 0, to_string(outOfOrder) + " frame(s) read out of order");
+    check(last == CONCURRENT_FRAMES, "the last frame was not read");
+    check(read + reader.missed() == CONCURRENT_FRAMES, "frames neither read nor counted as missed");
+}
+
+static void testRestart()
+{
+    ShmFrame frame;
+    unique_ptr<ShmRingReader> reader;
+
+    {
+        ShmPublisher publisher(RING);
+        reader.reset(new ShmRingReader(RING));
+        check(reader->isOpen(), "could not open the ring");
+        if (!reader->isOpen()) return;
+
+        publish(publisher, 3);
+        check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 1, "frame 1 was not read");
+    }
+
+    // the publisher stopped: its last frames are still read...
+    check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 2, "frame 2 was not read");
+    check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 3, "frame 3 was not read");
+    check(reader->next(frame) == ShmRingReader::NO_FRAME && !reader->isOpen(),
+          "the ring of a stopped publisher is still open");
+
+    // ...then the reader moves to the ring of the next publisher
+    ShmPublisher restarted(RING);
+    publish(restarted, 2);
+    check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 1 && consistent(frame),
+          "the first frame of a restarted publisher was not read");
+    check(reader->restarts() == 1, "the restart was not counted");
+
+    // another publisher takes over, as if 'restarted' had crashed: its ring
+    // is retired, and the reader moves on as well
+    {
+        ShmPublisher takeover(RING);
+        publish(takeover, 1);
+        check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 2,
+              "the last frame of a replaced publisher was not read");
+        check(reader->next(frame) == ShmRingReader::FRAME && frame.frame == 1 && reader->restarts() == 2,
+              "the reader did not follow the publisher that took over");
+        check(reader->missed() == 0, "frames missed across the restarts");
+    }
+    reader.reset();
+}
+
+int main(int argc, char *argv[])
+{
+    testSequential();
+    testConcurrent();
+    testRestart();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/objdetect/objdetect.hpp>
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <algorithm>
+#include <tuple>
+
+#include "simd_cascade.h"
+
+using namespace cv;
+using namespace std;
+
+// Checks that SimdCascade finds exactly the same windows as OpenCV's
+// CascadeClassifier, with every code path the CPU supports, on the frames of
+// the test video at several resolutions.
+
+const static string test1 = "single_user_static_camera.avi";
+const static string model_path(INSTALL_PREFIX "/share/facetracking/");
+
+static bool sameRects(vector<Rect> a, vector<Rect> b)
+{
+    auto order = [](const Rect& r, const Rect& s) {
+        return make_tuple(r.x, r.y, r.width, r.height) < make_tuple(s.x, s.y, s.width, s.height);
+    };
+    sort(a.begin(), a.end(), order);
+    sort(b.begin(), b.end(), order);
+    return a == b;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef OPENCV3
+    // OpenCV 3 rewrote its cascade evaluator: SimdCascade replicates 2.4's.
+    cout << "SimdCascade is bit-exact with OpenCV 2.4 only. Skipping." << endl;
+    return 0;
+#else
+    // test images: some frames of the test video, plus noise
+    vector<Mat> images;
+
+    VideoCapture videoCapture(test1);
+    Mat cameraImage;
+    for (int i = 0; videoCapture.read(cameraImage); i++) {
+        if (i % 25 != 0) continue;
+
+        Mat gray;
+        cvtColor(cameraImage, gray, cv::COLOR_BGR2GRAY);
+        equalizeHist(gray, gray);
+
+        for (int width : {160, 200, 320}) {
+            Mat scaled;
+            resize(gray, scaled, Size(width, cvRound(gray.rows * width / (double) gray.cols)));
+            images.push_back(scaled);
+        }
+    }
+    if (images.empty()) {
+        cerr << "Could not read <" << test1 << ">" << endl;
+        return 1;
+    }
+
+    Mat noise(240, 320, CV_8U);
+    randu(noise, Scalar(0), Scalar(256));
+    images.push_back(noise);
+
+    // OpenCV only uses the evaluator we replicate for new-format cascades
+    vector<pair<string, string>> models; // (name, new-format cascade)
+    for (auto name : {"haarcascade_frontalface_default.xml", "haarcascade_eye.xml"}) {
+        string converted = string("converted_") + name;
+        if (!CascadeClassifier::convert(model_path + name, converted)) {
+            cerr << "Could not convert <" << name << ">" << endl;
+            return 1;
+        }
+        models.push_back(make_pair(string(name), converted));
+    }
+    if (CascadeClassifier(model_path + "lbpcascade_frontalface.xml").empty()) {
+        cout << "LBP cascade not installed: skipping it." << endl;
+    }
+    else {
+        models.push_back(make_pair(string("lbpcascade_frontalface.xml"),
+                                   model_path + "lbpcascade_frontalface.xml"));
+    }
+
+    int failures = 0;
+
+    for (const auto& model : models) {
+
+        CascadeClassifier reference(model.second);
+        SimdCascade cascade(model.second);
+        if (reference.empty() || cascade.empty()) {
+            cerr << "Could not load <" << model.first << ">" << endl;
+            return 1;
+        }
+
+        for (int set = SCALAR; set <= bestInstructionSet(); set++) {
+            cascade.setInstructionSet((InstructionSet) set);
+
+            int rawWindows = 0, mismatches = 0;
+
+            for (const auto& image : images) {
+                // no grouping: every single window must match...
+                vector<Rect> expected, found;
+                reference.detectMultiScale(image, expected, 1.1, 0, 0, Size(20, 20));
+                cascade.detectMultiScale(image, found, 1.1, 0, 0, Size(20, 20));
+                rawWindows += expected.size();
+                if (!sameRects(expected, found)) mismatches++;
+
+                // ...and the grouped ones too
+                reference.detectMultiScale(image, expected, 1.1, 3, 0, Size(20, 20));
+                cascade.detectMultiScale(image, found, 1.1, 3, 0, Size(20, 20));
+                if (!sameRects(expected, found)) mismatches++;
+            }
+
+            cout << model.first << " (" << instructionSetName((InstructionSet) set) << "): "
+                 << rawWindows << " windows on " << images.size() << " images, "
+                 << mismatches << " mismatch(es)" << endl;
+
+            failures += mismatches;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+#endif
+}
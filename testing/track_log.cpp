@@ -0,0 +1,126 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio> // remove
+
+#include "track_log_writer.h"
+#include "track_log.h"
+#include "checks.h"
+
+using namespace cv;
+using namespace std;
+
+// Logs synthetic tracks, and reads them back: the faces of a frame and of a
+// track must be found, with their names and the stamps of their images, and
+// a log cut in the middle of a record must still be readable.
+
+static const char LOG_PATH[] = "track_log_test.ftl";
+static const unsigned long FRAMES = 5000;
+// the stamp of the first image (in ns), as a camera driver would set it
+static const int64_t FIRST_STAMP = 1700000000000000000;
+
+static int64_t stamp(unsigned long frame)
+{
+    return FIRST_STAMP + 33333333 * (int64_t) frame;
+}
+
+/** Track 1 all along, track 2 on even frames only, renamed halfway.
+ */
+static void makeSnapshot(unsigned long frame, TrackingSnapshot& snapshot)
+{
+    snapshot.frame = frame;
+    snapshot.timestamp = chrono::steady_clock::time_point(chrono::milliseconds(33 * frame));
+    snapshot.tracks.resize(frame % 2 == 0 ? 2 : 1);
+
+    TrackSnapshot& first = snapshot.tracks[0];
+    first.id = 1;
+    first.name = "human1";
+    first.mode = TRACKING;
+    first.identity = CONFIRMED;
+    first.boundingbox = Rect(frame % 600, 10, 50, 50);
+    first.pose = Matx44d::eye();
+    first.pose(0, 3) = frame;
+
+    if (snapshot.tracks.size() > 1) {
+        TrackSnapshot& second = snapshot.tracks[1];
+        second.id = 2;
+        second.name = frame < FRAMES / 2 ? "human2" : "alice";
+        second.mode = frame % 10 == 0 ? LOST : TRACKING;
+        second.identity = PROVISIONAL;
+        second.boundingbox = Rect(300, 200, 80, 80);
+        second.pose = Matx44d::eye();
+    }
+}
+
+static void checkLog(unsigned long frames)
+{
+    TrackLogReader log(LOG_PATH);
+    check(log.isOpen(), "could not open the log");
+    if (!log.isOpen()) return;
+
+    size_t expected = frames + (frames + 1) / 2;
+    check(log.faces() == expected, "expected " + to_string(expected) + " faces, got " + to_string(log.faces()));
+
+    vector<const TrackLogRecord*> faces;
+    log.frame(1234, faces);
+    check(faces.size() == 2, "frame 1234 should have 2 faces");
+    for (auto face : faces) {
+        check(face->frame == 1234, "wrong frame");
+        check(face->stamp == stamp(1234), "wrong image stamp");
+        if (face->track == 1) {
+            check(face->face.x == 1234 % 600 && face->face.pose[3] == 1234.f, "wrong bounding box or pose");
+            check(log.name(*face) == "human1", "wrong name for track 1");
+        }
+        else {
+            check(face->track == 2 && log.name(*face) == "human2", "wrong name for track 2");
+            check(face->face.mode == TRACKING && face->face.identity == PROVISIONAL, "wrong mode");
+        }
+    }
+
+    log.frame(frames + 10, faces);
+    check(faces.empty(), "faces found after the end of the log");
+
+    log.track(2, faces);
+    check(faces.size() == (frames + 1) / 2, "wrong nb of faces for track 2");
+    for (size_t i = 1; i < faces.size(); i++) {
+        check(faces[i]->frame > faces[i - 1]->frame, "track 2 not in frame order");
+    }
+    if (!faces.empty() && frames > FRAMES / 2) {
+        check(log.name(*faces.back()) == "alice", "track 2 was not renamed");
+        check(TRACK_LOG_MODES[faces[5]->face.mode] == string("lost"), "frame 10 of track 2 should be LOST");
+    }
+
+    check(log.tracks() == vector<uint32_t>({1, 2}), "wrong tracks");
+}
+
+int main(int argc, char *argv[])
+{
+    {
+        TrackLogWriter writer(LOG_PATH);
+        check(writer.isOpen(), "could not create the log");
+
+        TrackingSnapshot snapshot;
+        for (unsigned long frame = 0; frame < FRAMES; frame++) {
+            makeSnapshot(frame, snapshot);
+            writer.log(snapshot, stamp(frame));
+        }
+    }
+    checkLog(FRAMES);
+
+    // the tracker died while writing the last record
+    {
+        ifstream in(LOG_PATH, ios::binary);
+        string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        content.resize(content.size() - sizeof(TrackLogRecord) / 2);
+        ofstream out(LOG_PATH, ios::binary | ios::trunc);
+        out << content;
+    }
+    TrackLogReader truncated(LOG_PATH);
+    check(truncated.isOpen() && truncated.faces() == FRAMES + (FRAMES + 1) / 2 - 1,
+          "the complete records of a truncated log should be readable");
+
+    remove(LOG_PATH);
+
+    return failures == 0 ? 0 : 1;
+}
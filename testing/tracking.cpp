@@ -4,6 +4,8 @@
 #include <opencv2/core/utility.hpp> // getTickCount
 #endif
 #include <iostream>
+#include <thread>
+#include <memory>
 
 // include log4cxx header files.
 #include "log4cxx/logger.h"
@@ -11,6 +13,7 @@
 
 
 #include "facetracking.h"
+#include "overlay.h"
 
 using namespace cv;
 using namespace std;
@@ -20,51 +23,91 @@ LoggerPtr logger(Logger::getLogger("facetracking"));
 
 const static string test1 = "single_user_static_camera.avi";
 
-int main(int argc, char *argv[])
+/** Replays the test video with the given detector backend (and possibly
+ * motion gating), and reports the time per frame, the ratio of frames where a
+ * face is reported, on how many of them the head pose was updated, and how
+ * many frames ran a detector.
+ */
+bool replay(DetectorType detector, bool motionGating, int wait, OverlayRenderer* renderer)
 {
-
-    int wait = 0; //time in millisecond to wait between frame. Default to no wait (-> nothing will be displayed).
-
-    if (argc > 1) {
-        wait = atoi(argv[1]);
-    }
-    // Set up a simple configuration that logs on the console.
-    BasicConfigurator::configure();
-    
-    LOG4CXX_INFO(logger, "Compiled with OpenCV version " << CV_VERSION);
-
     cv::VideoCapture videoCapture(test1);
     if (!videoCapture.isOpened())
     {
         LOG4CXX_ERROR(logger, "Unable to initialise video capture.");
-        return 1;
+        return false;
     }
 
-    namedWindow("faces"); 
-
-    FaceTracking facetracking;
+    TrackingParameters params;
+    params.detector = detector;
+    params.motionGating = motionGating;
+    FaceTracking facetracking(params);
 
     Mat cameraImage, inputImage;
 
+    int frames = 0, framesWithFace = 0, poseUpdates = 0, detections = 0;
+    Matx44d lastPose;
+    double totalTime = 0.;
 
     while(videoCapture.read(cameraImage)) {
 
-        auto debugImage = cameraImage.clone();
-
         cvtColor(cameraImage, inputImage, cv::COLOR_BGR2GRAY);
 
         int64 tStartCount = cv::getTickCount();
 
-        auto humans = facetracking.track(inputImage, debugImage);
+        const auto& humans = facetracking.track(inputImage);
+
+        totalTime += ((double)cv::getTickCount() - tStartCount)/cv::getTickFrequency() * 1000.;
+        frames++;
+        if (facetracking.detectorRan()) detections++;
+        if (!humans.empty()) {
+            framesWithFace++;
+            auto pose = humans[0].pose();
+            // only the translation is estimated
+            if (pose(0,3) != lastPose(0,3) || pose(1,3) != lastPose(1,3) || pose(2,3) != lastPose(2,3)) {
+                poseUpdates++;
+            }
+            lastPose = pose;
+        }
+
+        if (renderer) {
+            renderer->publish(cameraImage, facetracking);
+            this_thread::sleep_for(chrono::milliseconds(wait));
+        }
+    }
+
+    videoCapture.release();
+
+    LOG4CXX_INFO(logger, detectorName(detector) << " detector"
+                         << (motionGating ? " (motion gated): " : ": ")
+                         << totalTime / max(frames, 1) << "ms per frame, "
+                         << "face reported on " << framesWithFace << "/" << frames << " frames, "
+                         << "pose updated on " << poseUpdates << " of them, "
+                         << "detector ran on " << detections << " frames");
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
 
-        //cout << "Time to detect faces: " << ((double)cv::getTickCount() - tStartCount)/cv::getTickFrequency() * 1000. << "ms" << std::endl;
-        //cout << humans.size() << " face(s) detected." << endl;
+    int wait = 0; //time in millisecond to wait between frame. Default to no wait (-> nothing will be displayed).
 
-        imshow("faces", debugImage);
-        if (wait > 0) waitKey(wait);
+    if (argc > 1) {
+        wait = atoi(argv[1]);
     }
+    // Set up a simple configuration that logs on the console.
+    BasicConfigurator::configure();
 
-    cv::destroyWindow("faces");
-    videoCapture.release();
+    LOG4CXX_INFO(logger, "Compiled with OpenCV version " << CV_VERSION);
+
+    unique_ptr<OverlayRenderer> renderer;
+    if (wait > 0) renderer.reset(new OverlayRenderer("faces"));
+
+    bool success = true;
+    for (auto detector : {HAAR, LBP}) {
+        success &= replay(detector, false, wait, renderer.get());
+    }
+    success &= replay(HAAR, true, wait, renderer.get());
 
+    return success ? 0 : 1;
 }